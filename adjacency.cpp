@@ -0,0 +1,89 @@
+#include "adjacency.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "parallel.h"
+
+static const int adjacencyChunk = 16384;
+
+void VertexFaceAdjacency::Build(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount)
+{
+	int nf = static_cast<int>(faces.size());
+	int nv = static_cast<int>(vertexCount);
+
+	// Pass 1: faces per vertex
+	std::unique_ptr<std::atomic<unsigned int>[]> counts(new std::atomic<unsigned int>[vertexCount]);
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			counts[i].store(0, std::memory_order_relaxed);
+	}, adjacencyChunk);
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			counts[faces[i][0]].fetch_add(1, std::memory_order_relaxed);
+			counts[faces[i][1]].fetch_add(1, std::memory_order_relaxed);
+			counts[faces[i][2]].fetch_add(1, std::memory_order_relaxed);
+		}
+	}, adjacencyChunk);
+
+	// Exclusive prefix sum; counts becomes the write cursor of each vertex
+	offsets.resize(vertexCount + 1);
+	unsigned int sum = 0;
+	for (int i = 0; i < nv; i++)
+	{
+		offsets[i] = sum;
+		sum += counts[i].load(std::memory_order_relaxed);
+		counts[i].store(offsets[i], std::memory_order_relaxed);
+	}
+	offsets[vertexCount] = sum;
+
+	// Pass 2: scatter face indices; threads claim slots in any order
+	faceIndices.resize(sum);
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				faceIndices[counts[faces[i][j]].fetch_add(1, std::memory_order_relaxed)] = i;
+		}
+	}, adjacencyChunk);
+
+	// A single scatter range visits faces in order. Otherwise restore increasing face order within
+	// each vertex, so the result does not depend on the thread count.
+	if (GetWorkerThreadCount() <= 1 || nf <= adjacencyChunk)
+		return;
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			std::sort(faceIndices.begin() + offsets[i], faceIndices.begin() + offsets[i + 1]);
+	}, adjacencyChunk);
+}
+bool VertexFaceAdjacency::Assign(std::vector<unsigned int> offsets, std::vector<unsigned int> faceIndices,
+	std::size_t faceCount)
+{
+	this->offsets.clear();
+	this->faceIndices.clear();
+
+	if (offsets.empty() || offsets.front() != 0 || offsets.back() != faceIndices.size())
+		return false;
+	for (std::size_t i = 1; i < offsets.size(); i++)
+	{
+		if (offsets[i] < offsets[i - 1])
+			return false;
+	}
+	for (auto face : faceIndices)
+	{
+		if (face >= faceCount)
+			return false;
+	}
+
+	this->offsets = std::move(offsets);
+	this->faceIndices = std::move(faceIndices);
+	return true;
+}
+std::size_t VertexFaceAdjacency::GetMemoryUsage() const
+{
+	return (offsets.capacity() + faceIndices.capacity()) * sizeof(unsigned int);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Read only view of a contiguous range of indices
+class IndexSpan
+{
+public:
+	IndexSpan() : first(nullptr), last(nullptr) {}
+	IndexSpan(const unsigned int* first, const unsigned int* last) : first(first), last(last) {}
+
+	const unsigned int* begin() const { return first; }
+	const unsigned int* end() const { return last; }
+	std::size_t size() const { return static_cast<std::size_t>(last - first); }
+	bool empty() const { return first == last; }
+	unsigned int operator[](std::size_t i) const { return first[i]; }
+private:
+	const unsigned int* first;
+	const unsigned int* last;
+};
+
+// Faces around each vertex in compressed sparse row form: the faces of vertex v are
+// faceIndices[offsets[v], offsets[v + 1]), in increasing face order.
+// A degenerate face that uses a vertex twice is listed twice.
+class VertexFaceAdjacency
+{
+public:
+	VertexFaceAdjacency() = default;
+
+	// Count faces per vertex, prefix sum the counts, then scatter the face indices.
+	// The count and scatter passes run on the ParallelFor workers.
+	void Build(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount);
+	// Take arrays that are already in CSR form (offsets has vertexCount + 1 entries).
+	// Returns false, leaving the adjacency empty, if they are inconsistent or reference faces >= faceCount.
+	bool Assign(std::vector<unsigned int> offsets, std::vector<unsigned int> faceIndices, std::size_t faceCount);
+
+	std::size_t GetVertexCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+	IndexSpan operator[](std::size_t vertex) const
+	{
+		return IndexSpan(faceIndices.data() + offsets[vertex], faceIndices.data() + offsets[vertex + 1]);
+	}
+	unsigned int GetFaceCount(std::size_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+
+	const std::vector<unsigned int>& GetOffsets() const { return offsets; }
+	const std::vector<unsigned int>& GetFaceIndices() const { return faceIndices; }
+	std::size_t GetMemoryUsage() const;
+private:
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> faceIndices;
+};
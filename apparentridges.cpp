@@ -0,0 +1,187 @@
+#include "apparentridges.h"
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+#include "timer.h"
+
+static bool apparentRidgesEnabled = false;
+static ApparentRidgeOptions apparentRidgeOptions;
+
+void SetApparentRidgesEnabled(bool enabled)
+{
+	apparentRidgesEnabled = enabled;
+}
+bool AreApparentRidgesEnabled()
+{
+	return apparentRidgesEnabled;
+}
+void SetApparentRidgeOptions(const ApparentRidgeOptions& options)
+{
+	apparentRidgeOptions = options;
+}
+const ApparentRidgeOptions& GetApparentRidgeOptions()
+{
+	return apparentRidgeOptions;
+}
+
+// q1 and t1 of one vertex. In the (pdir1, pdir2) basis S = diag(k1, k2), and with w the unit projection of the view
+// direction onto the tangent plane, P^-1 = I + (sec(theta) - 1) w w^T. t1 is the eigenvector of Q^T Q for its
+// largest eigenvalue, q1^2.
+static void ComputeViewDependentCurvature(float k1, float k2, float u, float v, float ndotv, float& q1, glm::vec2& t1)
+{
+	float u2 = 1.0f, uv = 0.0f, v2 = 0.0f;
+	float sin2Theta = u * u + v * v;
+	if (sin2Theta > 1e-12f)
+	{
+		u2 = u * u / sin2Theta;
+		uv = u * v / sin2Theta;
+		v2 = v * v / sin2Theta;
+	}
+	float secThetaMinus1 = 1.0f / std::max(std::fabs(ndotv), 1e-4f) - 1.0f;
+
+	float q11 = k1 * (1.0f + secThetaMinus1 * u2);
+	float q12 = k1 * (secThetaMinus1 * uv);
+	float q21 = k2 * (secThetaMinus1 * uv);
+	float q22 = k2 * (1.0f + secThetaMinus1 * v2);
+
+	float a = q11 * q11 + q21 * q21;
+	float b = q11 * q12 + q21 * q22;
+	float c = q12 * q12 + q22 * q22;
+	float halfDifference = 0.5f * (a - c);
+	float lambda = 0.5f * (a + c) + std::sqrt(halfDifference * halfDifference + b * b);
+	q1 = std::sqrt(std::max(lambda, 0.0f));
+
+	// Both rows of (Q^T Q - lambda I) are orthogonal to t1; the longer one is the stable choice
+	glm::vec2 e1(b, lambda - a), e2(lambda - c, b);
+	glm::vec2 direction = glm::dot(e1, e1) >= glm::dot(e2, e2) ? e1 : e2;
+	float length = glm::length(direction);
+	t1 = length > 1e-20f ? direction / length : glm::vec2(1.0f, 0.0f);
+}
+
+void ApparentRidgeStage::Build(const MeshGeometry& geometry)
+{
+	featureSize = ComputeFeatureSize(geometry);
+	valid = false;
+}
+void ApparentRidgeStage::Invalidate()
+{
+	valid = false;
+}
+void ApparentRidgeStage::Update(MeshGeometry& geometry, const std::vector<std::array<unsigned int, 3>>& faces,
+	const VertexFaceAdjacency& adjacentFaces, const glm::vec3& eye, float viewTolerance,
+	ApparentRidgeVertex* output, ApparentRidgeStatistics* statistics)
+{
+	Timer updateTimer;
+	std::size_t vertexCount = geometry.GetVertexCount();
+	writtenBegin = writtenEnd = 0;
+	if (statistics)
+		*statistics = ApparentRidgeStatistics();
+	if (!IsBuilt() || adjacentFaces.GetVertexCount() != vertexCount)
+		return;
+
+	if (geometry.q1.size() != vertexCount || viewDirections.size() != vertexCount)
+	{
+		geometry.q1.assign(vertexCount, 0.0f);
+		geometry.t1.assign(vertexCount, glm::vec2(1.0f, 0.0f));
+		geometry.dt1q1.assign(vertexCount, 0.0f);
+		viewDirections.assign(vertexCount, glm::vec3(0.0f, 0.0f, 0.0f));
+		ndotv.assign(vertexCount, 0.0f);
+		valid = false;
+	}
+	updated.resize(vertexCount);
+	written.resize(vertexCount);
+
+	int nv = static_cast<int>(vertexCount);
+	float cosTolerance = std::cos(viewTolerance);
+	bool recomputeAll = !valid;
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			glm::vec3 viewDir = eye - geometry.positions[i];
+			float distance = glm::length(viewDir);
+			if (distance > 0.0f)
+				viewDir /= distance;
+			if (!recomputeAll && glm::dot(viewDir, viewDirections[i]) >= cosTolerance)
+			{
+				updated[i] = 0;
+				continue;
+			}
+			updated[i] = 1;
+			viewDirections[i] = viewDir;
+			ndotv[i] = glm::dot(viewDir, geometry.normals[i]);
+			ComputeViewDependentCurvature(geometry.curv1[i], geometry.curv2[i], glm::dot(viewDir, geometry.pdir1[i]),
+				glm::dot(viewDir, geometry.pdir2[i]), ndotv[i], geometry.q1[i], geometry.t1[i]);
+		}
+	}, 4096);
+
+	// dt1q1 reads q1 of the one ring, so it changes wherever a neighbour was recomputed
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			bool recompute = updated[i] != 0;
+			for (auto f = adjacentFaces[i].begin(); !recompute && f != adjacentFaces[i].end(); ++f)
+				recompute = updated[faces[*f][0]] || updated[faces[*f][1]] || updated[faces[*f][2]];
+			written[i] = recompute ? 1 : 0;
+			if (!recompute)
+				continue;
+
+			// Follow t1 (on the surface) across each face to the opposite edge and difference q1 there; the two
+			// faces it crosses give a forward and a backward estimate
+			const glm::vec3& p0 = geometry.positions[i];
+			glm::vec3 worldT1 = geometry.t1[i].x * geometry.pdir1[i] + geometry.t1[i].y * geometry.pdir2[i];
+			glm::vec3 worldT2 = glm::cross(geometry.normals[i], worldT1);
+			float p0DotT2 = glm::dot(p0, worldT2);
+			float sum = 0.0f;
+			int estimates = 0;
+			for (auto f : adjacentFaces[i])
+			{
+				const auto& face = faces[f];
+				int corner = face[0] == static_cast<unsigned int>(i) ? 0 : (face[1] == static_cast<unsigned int>(i) ? 1 : 2);
+				unsigned int i1 = face[(corner + 1) % 3], i2 = face[(corner + 2) % 3];
+				float d1 = glm::dot(geometry.positions[i1], worldT2), d2 = glm::dot(geometry.positions[i2], worldT2);
+				if (d1 == d2)
+					continue;
+				float w1 = (d2 - p0DotT2) / (d2 - d1);
+				if (w1 < 0.0f || w1 >= 1.0f)
+					continue;
+				float w2 = 1.0f - w1;
+				glm::vec3 p = w1 * geometry.positions[i1] + w2 * geometry.positions[i2];
+				float projectedDistance = glm::dot(p - p0, worldT1) * std::fabs(ndotv[i]);
+				if (projectedDistance == 0.0f)
+					continue;
+				sum += (w1 * geometry.q1[i1] + w2 * geometry.q1[i2] - geometry.q1[i]) / projectedDistance;
+				if (++estimates == 2)
+					break;
+			}
+			geometry.dt1q1[i] = estimates > 0 ? sum / estimates : 0.0f;
+			if (output)
+				output[i] = { geometry.q1[i], geometry.t1[i], geometry.dt1q1[i] };
+		}
+	}, 4096);
+	valid = true;
+
+	std::size_t updatedVertices = 0, updatedDerivatives = 0;
+	for (std::size_t i = 0; i < vertexCount; i++)
+	{
+		updatedVertices += updated[i];
+		if (!written[i])
+			continue;
+		if (updatedDerivatives++ == 0)
+			writtenBegin = i;
+		writtenEnd = i + 1;
+	}
+	if (statistics)
+	{
+		statistics->updatedVertices = updatedVertices;
+		statistics->updatedDerivatives = updatedDerivatives;
+		statistics->streamedBytes = output ? updatedDerivatives * sizeof(ApparentRidgeVertex) : 0;
+		statistics->milliseconds = updateTimer.ElapsedMilliseconds();
+	}
+}
+std::size_t ApparentRidgeStage::GetMemoryUsage() const
+{
+	return viewDirections.capacity() * sizeof(glm::vec3) + ndotv.capacity() * sizeof(float) +
+		updated.capacity() + written.capacity();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "adjacency.h"
+#include "meshgeometry.h"
+
+// Apparent ridges are computed and drawn when enabled (before the meshes are loaded)
+void SetApparentRidgesEnabled(bool enabled);
+bool AreApparentRidgesEnabled();
+
+struct ApparentRidgeOptions
+{
+	// A vertex is recomputed once its view direction has turned by more than this many radians
+	float viewTolerance = 0.005f;
+	// Minimum q1 for a ridge to be drawn and the range it fades in over, in units of 1 / featureSize
+	// (so 1 is the median principal curvature)
+	float threshold = 1.0f;
+	float fade = 1.0f;
+};
+void SetApparentRidgeOptions(const ApparentRidgeOptions& options);
+const ApparentRidgeOptions& GetApparentRidgeOptions();
+
+// One vertex of the view dependent stream, at attribute locations ATTRIBUTE_Q1, ATTRIBUTE_T1 and ATTRIBUTE_DT1Q1
+struct ApparentRidgeVertex
+{
+	float q1;
+	glm::vec2 t1;
+	float dt1q1;
+};
+
+struct ApparentRidgeStatistics
+{
+	std::size_t updatedVertices; // q1 and t1 recomputed
+	std::size_t updatedDerivatives; // dt1q1 recomputed (the updated vertices and their neighbours)
+	std::size_t streamedBytes;
+	double milliseconds;
+};
+
+// Fills the view dependent curvature of Judd et al. 2007 into MeshGeometry::q1, t1 and dt1q1.
+// q1 is the largest singular value of Q = S P^-1, the shape operator S composed with the inverse of the projection P
+// of the tangent plane onto the image plane, and t1 (in the pdir1, pdir2 basis) its direction. dt1q1, the derivative
+// of q1 along t1 on the image plane, is estimated from the points where the line along t1 leaves the vertex's faces.
+// Ridges lie where dt1q1 crosses zero with q1 at a maximum.
+class ApparentRidgeStage
+{
+public:
+	ApparentRidgeStage() = default;
+
+	// Measure the feature size (ComputeFeatureSize); needs the curvature to be computed
+	void Build(const MeshGeometry& geometry);
+	bool IsBuilt() const { return featureSize > 0.0f; }
+	float GetFeatureSize() const { return featureSize; }
+	// Recompute every vertex on the next Update, e.g. after the curvature changed
+	void Invalidate();
+
+	// Bring q1, t1 and dt1q1 up to date for eye (object space). Only the vertices whose view direction turned by more
+	// than viewTolerance are recomputed, and dt1q1 only around them; both passes run on the ParallelFor workers.
+	// Every vertex that changed is also written to output[i], so a mapped GPU buffer only receives the changes.
+	void Update(MeshGeometry& geometry, const std::vector<std::array<unsigned int, 3>>& faces,
+		const VertexFaceAdjacency& adjacentFaces, const glm::vec3& eye, float viewTolerance,
+		ApparentRidgeVertex* output, ApparentRidgeStatistics* statistics = nullptr);
+	// Vertex range [begin, end) written to output by the last Update; empty if nothing changed
+	std::size_t GetWrittenBegin() const { return writtenBegin; }
+	std::size_t GetWrittenEnd() const { return writtenEnd; }
+
+	std::size_t GetMemoryUsage() const;
+private:
+	float featureSize = 0.0f;
+	bool valid = false;
+	AlignedVector<glm::vec3> viewDirections; // per vertex, of its last recompute
+	AlignedVector<float> ndotv; // likewise
+	std::vector<unsigned char> updated; // per Update: q1 and t1 recomputed
+	std::vector<unsigned char> written; // per Update: written to output
+	std::size_t writtenBegin = 0;
+	std::size_t writtenEnd = 0;
+};
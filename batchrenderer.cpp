@@ -0,0 +1,230 @@
+#include "batchrenderer.h"
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include "framebufferreadback.h"
+#include "headless.h"
+#include "imageencoder.h"
+#include "materialpool.h"
+#include "offscreentarget.h"
+#include "parallel.h"
+#include "renderer.h"
+#include "textureloader.h"
+#include "threadpool.h"
+#include "timer.h"
+
+static const float defaultOrbitDistance = 3.0f; // same as the initial camera of Renderer
+
+bool ReadBatchManifest(const std::string& path, std::vector<BatchJob>& jobs)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "ERROR::BATCH::MANIFEST_NOT_FOUND: " << path << '\n';
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		std::string::size_type comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream input(line);
+		std::string directive;
+		if (!(input >> directive))
+			continue;
+
+		bool valid = true;
+		if (directive == "model")
+		{
+			BatchJob job;
+			valid = static_cast<bool>(input >> job.modelPath >> job.outputPrefix);
+			if (valid)
+				jobs.push_back(std::move(job));
+		}
+		else if (directive == "view" && !jobs.empty())
+		{
+			BatchView view;
+			view.target = glm::vec3(0.0f, 0.0f, 0.0f);
+			valid = static_cast<bool>(input >> view.eye.x >> view.eye.y >> view.eye.z);
+			if (valid && input >> view.target.x)
+				valid = static_cast<bool>(input >> view.target.y >> view.target.z);
+			if (valid)
+				jobs.back().views.push_back(view);
+		}
+		else if (directive == "orbit" && !jobs.empty())
+		{
+			int count = 0;
+			float elevation = 0.0f, distance = 0.0f;
+			valid = static_cast<bool>(input >> count) && count > 0;
+			if (valid && input >> elevation)
+				input >> distance;
+			if (distance <= 0.0f) // not given
+				distance = defaultOrbitDistance;
+
+			float pitch = glm::radians(elevation);
+			for (int i = 0; valid && i < count; i++)
+			{
+				float angle = 2.0f * 3.14159265f * i / count;
+				BatchView view;
+				view.target = glm::vec3(0.0f, 0.0f, 0.0f);
+				view.eye = distance * glm::vec3(std::cos(pitch) * std::sin(angle), std::sin(pitch),
+					std::cos(pitch) * std::cos(angle));
+				jobs.back().views.push_back(view);
+			}
+		}
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			std::cerr << "ERROR::BATCH::MANIFEST_SYNTAX: " << path << ":" << lineNumber << ": " << line << '\n';
+			return false;
+		}
+	}
+	return true;
+}
+
+// Milliseconds spent in each stage over the whole batch
+struct BatchStatistics
+{
+	double load = 0.0; // import or mesh cache read, on the loader threads
+	double curvature = 0.0; // on the loader threads
+	double wait = 0.0; // render thread blocked on the loader
+	double upload = 0.0; // meshes and textures
+	double draw = 0.0; // submitting the frame
+	double readback = 0.0; // starting the copy into the pixel buffer ring, and handing finished ones to the encoders
+	double encode = 0.0; // waiting for the last copies and encoders after the last image
+	int images = 0;
+	int failures = 0;
+};
+
+static void LogBatchStatistics(const BatchStatistics& stats, std::size_t jobCount, double totalMilliseconds)
+{
+	double images = stats.images > 0 ? stats.images : 1;
+	std::cout << "Batch: " << jobCount << " models, " << stats.images << " images, " << stats.failures
+		<< " failures in " << totalMilliseconds << " ms (" << stats.images * 1000.0 / (totalMilliseconds + 1e-9)
+		<< " images/s)\n"
+		<< "  loader threads: load " << stats.load << " ms, curvature " << stats.curvature << " ms\n"
+		<< "  render thread: waiting for models " << stats.wait << " ms, upload " << stats.upload << " ms\n"
+		<< "  per image: draw " << stats.draw / images << " ms, readback " << stats.readback / images
+		<< " ms; then waiting for the encoders " << stats.encode << " ms\n";
+}
+
+int RunBatch(const BatchOptions& options)
+{
+	std::vector<BatchJob> jobs;
+	if (!ReadBatchManifest(options.manifestPath, jobs))
+		return 1;
+
+	HeadlessContext context;
+	if (!context.Initialize())
+		return 1;
+
+	BatchStatistics stats;
+	Timer totalTimer;
+	{
+		OffscreenTarget target;
+		if (!target.Create(options.width, options.height))
+			return 1;
+		Renderer renderer("");
+		Camera* camera = renderer.GetCamera();
+		float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+		// Bounded queue of models being loaded: at most queueDepth are in flight or waiting, so memory
+		// stays flat however long the manifest is. A model that failed to load comes back as nullptr.
+		ThreadPool loader(options.loaderThreads > 0 ? options.loaderThreads : 1);
+		std::deque<std::future<std::unique_ptr<Model>>> loading;
+		std::size_t nextJob = 0;
+		auto fillQueue = [&]()
+		{
+			std::size_t depth = options.queueDepth > 0 ? options.queueDepth : 1;
+			while (nextJob < jobs.size() && loading.size() < depth)
+			{
+				const BatchJob& job = jobs[nextJob++];
+				loading.push_back(loader.Submit([&job]()
+				{
+					std::unique_ptr<Model> model(new Model());
+					if (!model->LoadGeometry(job.modelPath))
+						model.reset();
+					return model;
+				}));
+			}
+		};
+
+		// Each view is copied into a ring of pixel pack buffers and compressed on the encoder threads, so
+		// neither the readback nor the PNG encoding stalls the next view
+		ImageEncoderPool encoder(GetWorkerThreadCount(), GetWorkerThreadCount() + 1);
+		FramebufferReadback readback(encoder);
+		Timer stageTimer;
+		fillQueue();
+		for (const auto& job : jobs)
+		{
+			stageTimer.Reset();
+			std::unique_ptr<Model> model = loading.front().get();
+			loading.pop_front();
+			fillQueue();
+			stats.wait += stageTimer.ElapsedMilliseconds();
+
+			if (!model)
+			{
+				std::cerr << "ERROR::BATCH::MODEL_NOT_LOADED: " << job.modelPath << '\n';
+				stats.failures += static_cast<int>(job.views.size());
+				continue;
+			}
+			stats.load += model->GetLoadMilliseconds();
+			stats.curvature += model->GetCurvatureMilliseconds();
+
+			// The previous model's GPU objects are released here, on the GL thread, and its materials with them
+			stageTimer.Reset();
+			model->CreateTextures();
+			renderer.SetModel(nullptr);
+			GetMaterialPool().Reset();
+			renderer.SetModel(model.release());
+			renderer.UploadModel();
+			GetTextureLoader().Finish();
+			glFinish();
+			stats.upload += stageTimer.ElapsedMilliseconds();
+
+			for (std::size_t i = 0; i < job.views.size(); i++)
+			{
+				camera->LookAt(job.views[i].eye, job.views[i].target);
+
+				stageTimer.Reset();
+				target.Bind();
+				glEnable(GL_DEPTH_TEST);
+				glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderer.Render(aspect);
+				stats.draw += stageTimer.ElapsedMilliseconds();
+
+				stageTimer.Reset();
+				char suffix[32];
+				std::snprintf(suffix, sizeof(suffix), "_%04d.png", static_cast<int>(i));
+				readback.Capture(job.outputPrefix + suffix);
+				readback.Update();
+				stats.readback += stageTimer.ElapsedMilliseconds();
+			}
+		}
+		stageTimer.Reset();
+		readback.Finish();
+		stats.encode += stageTimer.ElapsedMilliseconds();
+		// Failed images were reported by the encoders
+		stats.images += static_cast<int>(encoder.GetWrittenCount());
+		stats.failures += static_cast<int>(encoder.GetFailureCount());
+		renderer.SetModel(nullptr);
+		target.Unbind();
+	}
+	LogBatchStatistics(stats, jobs.size(), totalTimer.ElapsedMilliseconds());
+	context.Shutdown();
+	return stats.failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// One camera of a batch job
+struct BatchView
+{
+	glm::vec3 eye;
+	glm::vec3 target;
+};
+
+// A model and the views rendered of it; view i is written to "<outputPrefix>_<i>.png" (4 digits)
+struct BatchJob
+{
+	std::string modelPath;
+	std::string outputPrefix;
+	std::vector<BatchView> views;
+};
+
+// Manifest format, one directive per line ('#' starts a comment):
+//   model <model path> <output prefix>                  starts a job
+//   view <eye x y z> [<target x y z>]                   adds a view to the current job (target: origin)
+//   orbit <count> [<elevation degrees> [<distance>]]    adds count views on a circle around the origin
+// Returns false on a missing file or a malformed line
+bool ReadBatchManifest(const std::string& path, std::vector<BatchJob>& jobs);
+
+struct BatchOptions
+{
+	std::string manifestPath;
+	int width = 800;
+	int height = 600;
+	unsigned int loaderThreads = 1;
+	unsigned int queueDepth = 2; // models loaded ahead of the one being rendered
+};
+
+// Render every view of every job in a headless context and report per stage timings.
+// Models are imported (and their curvature computed) on loader threads while the previous model
+// is rendered; the context, shaders and render target are shared by all jobs.
+// Returns the process exit code.
+int RunBatch(const BatchOptions& options);
@@ -0,0 +1,340 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "parallel.h"
+#include "timer.h"
+
+static const int binCount = 16;
+static const unsigned int maxLeafItems = 4;
+// Nodes with fewer items are binned on the calling thread
+static const int parallelBinningItems = 16384;
+// Nodes with fewer items are the roots of subtrees built in parallel, one thread each
+static const unsigned int subtreeItems = 4096;
+
+static bool frustumCullingEnabled = false;
+
+void SetFrustumCullingEnabled(bool enabled)
+{
+	frustumCullingEnabled = enabled;
+}
+bool IsFrustumCullingEnabled()
+{
+	return frustumCullingEnabled;
+}
+
+float BoundingBox::GetSurfaceArea() const
+{
+	if (IsEmpty())
+		return 0.0f;
+	glm::vec3 size = max - min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Frustum::Frustum(const glm::mat4& clipFromObject)
+{
+	// Gribb and Hartmann: -w <= x, y, z <= w gives row 3 +- rows 0, 1, 2 (glm is column major)
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(clipFromObject[0][i], clipFromObject[1][i], clipFromObject[2][i], clipFromObject[3][i]);
+	for (int i = 0; i < 3; i++)
+	{
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (auto& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+		if (length > 0.0f)
+			plane = plane / length;
+	}
+}
+Frustum::Containment Frustum::Classify(const BoundingBox& box) const
+{
+	glm::vec3 center = box.GetCenter(), extent = 0.5f * (box.max - box.min);
+	Containment result = INSIDE;
+	for (const auto& plane : planes)
+	{
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (distance + radius < 0.0f)
+			return OUTSIDE;
+		if (distance - radius < 0.0f)
+			result = INTERSECTING;
+	}
+	return result;
+}
+
+namespace
+{
+	struct Bin
+	{
+		BoundingBox bounds;
+		unsigned int count = 0;
+	};
+	struct BinSet
+	{
+		BoundingBox bounds; // of the items
+		BoundingBox centroidBounds;
+		Bin bins[binCount];
+	};
+	struct BuildTask
+	{
+		unsigned int node;
+		unsigned int first;
+		unsigned int count;
+	};
+}
+
+static int GetBin(float centroid, float minimum, float scale)
+{
+	return std::min(binCount - 1, static_cast<int>((centroid - minimum) * scale));
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& items)
+{
+	itemBounds = items;
+	this->items.resize(items.size());
+	for (std::size_t i = 0; i < items.size(); i++)
+		this->items[i] = static_cast<unsigned int>(i);
+	nodes.clear();
+	if (items.empty())
+		return;
+	nodes.reserve(2 * items.size());
+	std::vector<glm::vec3> centroids(items.size());
+	for (std::size_t i = 0; i < items.size(); i++)
+		centroids[i] = items[i].GetCenter();
+
+	// Fill in task's node of output as a leaf, or split it and push the tasks of its two new children
+	auto split = [&](const BuildTask& task, std::vector<Node>& output, std::vector<BuildTask>& stack)
+	{
+		unsigned int* taskItems = this->items.data() + task.first;
+		bool parallel = task.count >= static_cast<unsigned int>(parallelBinningItems);
+
+		// Bounds and centroid bounds first, then the bins along the longest centroid axis
+		BinSet total;
+		std::mutex merge;
+		auto gatherBounds = [&](int begin, int end)
+		{
+			BinSet local;
+			for (int i = begin; i < end; i++)
+			{
+				local.bounds.Expand(itemBounds[taskItems[i]]);
+				local.centroidBounds.Expand(centroids[taskItems[i]]);
+			}
+			std::lock_guard<std::mutex> lock(merge);
+			total.bounds.Expand(local.bounds);
+			total.centroidBounds.Expand(local.centroidBounds);
+		};
+		if (parallel)
+			ParallelFor(static_cast<int>(task.count), gatherBounds, parallelBinningItems / 4);
+		else
+			gatherBounds(0, static_cast<int>(task.count));
+		output[task.node].bounds = total.bounds;
+		output[task.node].first = task.first;
+		output[task.node].count = task.count;
+		if (task.count <= maxLeafItems)
+			return;
+
+		glm::vec3 centroidSize = total.centroidBounds.max - total.centroidBounds.min;
+		int axis = centroidSize.x >= centroidSize.y && centroidSize.x >= centroidSize.z ? 0 : (centroidSize.y >= centroidSize.z ? 1 : 2);
+		if (centroidSize[axis] <= 0.0f)
+			return; // every centroid coincides, so no split separates them
+		float minimum = total.centroidBounds.min[axis];
+		float scale = binCount / centroidSize[axis];
+
+		auto fillBins = [&](int begin, int end)
+		{
+			Bin local[binCount];
+			for (int i = begin; i < end; i++)
+			{
+				Bin& bin = local[GetBin(centroids[taskItems[i]][axis], minimum, scale)];
+				bin.bounds.Expand(itemBounds[taskItems[i]]);
+				bin.count++;
+			}
+			std::lock_guard<std::mutex> lock(merge);
+			for (int b = 0; b < binCount; b++)
+			{
+				total.bins[b].bounds.Expand(local[b].bounds);
+				total.bins[b].count += local[b].count;
+			}
+		};
+		if (parallel)
+			ParallelFor(static_cast<int>(task.count), fillBins, parallelBinningItems / 4);
+		else
+			fillBins(0, static_cast<int>(task.count));
+
+		// SAH over the binCount - 1 split planes: sweep the left side forwards and the right side backwards
+		float rightAreas[binCount];
+		unsigned int rightCounts[binCount];
+		BoundingBox right;
+		unsigned int rightCount = 0;
+		for (int b = binCount - 1; b > 0; b--)
+		{
+			right.Expand(total.bins[b].bounds);
+			rightCount += total.bins[b].count;
+			rightAreas[b] = right.GetSurfaceArea();
+			rightCounts[b] = rightCount;
+		}
+		BoundingBox left;
+		unsigned int leftCount = 0;
+		float bestCost = 1e30f;
+		int bestSplit = -1;
+		for (int b = 1; b < binCount; b++)
+		{
+			left.Expand(total.bins[b - 1].bounds);
+			leftCount += total.bins[b - 1].count;
+			if (leftCount == 0 || rightCounts[b] == 0)
+				continue;
+			float cost = left.GetSurfaceArea() * leftCount + rightAreas[b] * rightCounts[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+		// A split costs one more box test; stop when testing every item of the node would be cheaper
+		float leafCost = total.bounds.GetSurfaceArea() * task.count;
+		if (bestSplit < 0 || (bestCost >= leafCost && task.count <= 4 * maxLeafItems))
+			return;
+
+		unsigned int* middle = std::partition(taskItems, taskItems + task.count, [&](unsigned int item)
+		{
+			return GetBin(centroids[item][axis], minimum, scale) < bestSplit;
+		});
+		unsigned int leftItems = static_cast<unsigned int>(middle - taskItems);
+
+		unsigned int children = static_cast<unsigned int>(output.size());
+		output.push_back(Node());
+		output.push_back(Node());
+		output[task.node].first = children;
+		output[task.node].count = 0;
+		stack.push_back(BuildTask{ children, task.first, leftItems });
+		stack.push_back(BuildTask{ children + 1, task.first + leftItems, task.count - leftItems });
+	};
+
+	// The top of the tree, where the nodes are large, is split here with parallel binning. Below subtreeItems
+	// the subtrees are independent: each is built into its own nodes on a worker and appended afterwards.
+	std::vector<BuildTask> stack, subtrees;
+	nodes.push_back(Node());
+	stack.push_back(BuildTask{ 0, 0, static_cast<unsigned int>(items.size()) });
+	while (!stack.empty())
+	{
+		BuildTask task = stack.back();
+		stack.pop_back();
+		if (task.count < subtreeItems)
+			subtrees.push_back(task);
+		else
+			split(task, nodes, stack);
+	}
+
+	std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+	ParallelFor(static_cast<int>(subtrees.size()), [&](int begin, int end)
+	{
+		std::vector<BuildTask> subtreeStack;
+		for (int s = begin; s < end; s++)
+		{
+			// The subtree's root is its node 0
+			std::vector<Node>& output = subtreeNodes[s];
+			output.push_back(Node());
+			subtreeStack.push_back(BuildTask{ 0, subtrees[s].first, subtrees[s].count });
+			while (!subtreeStack.empty())
+			{
+				BuildTask task = subtreeStack.back();
+				subtreeStack.pop_back();
+				split(task, output, subtreeStack);
+			}
+		}
+	}, 1);
+	for (std::size_t s = 0; s < subtrees.size(); s++)
+	{
+		// Local node i > 0 becomes node base + i - 1, and the root replaces the placeholder
+		unsigned int base = static_cast<unsigned int>(nodes.size());
+		for (auto& node : subtreeNodes[s])
+		{
+			if (node.count == 0)
+				node.first += base - 1;
+		}
+		nodes[subtrees[s].node] = subtreeNodes[s][0];
+		nodes.insert(nodes.end(), subtreeNodes[s].begin() + 1, subtreeNodes[s].end());
+	}
+}
+const BoundingBox& BoundingVolumeHierarchy::GetBounds() const
+{
+	static const BoundingBox empty;
+	return nodes.empty() ? empty : nodes[0].bounds;
+}
+void BoundingVolumeHierarchy::Cull(const Frustum& frustum, std::vector<unsigned char>& visible,
+	CullStatistics* statistics) const
+{
+	Timer cullTimer;
+	visible.assign(itemBounds.size(), 0);
+	std::size_t testedNodes = 0, visibleNodes = 0, visibleItems = 0;
+
+	unsigned int stack[64];
+	int depth = 0;
+	if (!nodes.empty())
+		stack[depth++] = 0;
+	while (depth > 0)
+	{
+		const Node& node = nodes[stack[--depth]];
+		testedNodes++;
+		Frustum::Containment containment = frustum.Classify(node.bounds);
+		if (containment == Frustum::OUTSIDE)
+			continue;
+		visibleNodes++;
+		if (containment == Frustum::INSIDE)
+		{
+			MarkSubtree(static_cast<unsigned int>(&node - nodes.data()), visible, visibleItems);
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				if (node.count == 1 || frustum.Classify(itemBounds[items[i]]) != Frustum::OUTSIDE)
+				{
+					visible[items[i]] = 1;
+					visibleItems++;
+				}
+			}
+		}
+		else if (depth + 2 <= 64)
+		{
+			stack[depth++] = node.first + 1;
+			stack[depth++] = node.first;
+		}
+		else
+			MarkSubtree(static_cast<unsigned int>(&node - nodes.data()), visible, visibleItems); // too deep to refine
+	}
+
+	if (statistics)
+	{
+		statistics->testedNodes = testedNodes;
+		statistics->visibleNodes = visibleNodes;
+		statistics->visibleItems = visibleItems;
+		statistics->itemCount = itemBounds.size();
+		statistics->milliseconds = cullTimer.ElapsedMilliseconds();
+	}
+}
+void BoundingVolumeHierarchy::MarkSubtree(unsigned int node, std::vector<unsigned char>& visible,
+	std::size_t& visibleItems) const
+{
+	// Every node's items are contiguous, its left child's before its right child's, so the subtree's items run
+	// from its leftmost leaf to its rightmost one: two walks down, without a stack
+	unsigned int leftmost = node, rightmost = node;
+	while (nodes[leftmost].count == 0)
+		leftmost = nodes[leftmost].first;
+	while (nodes[rightmost].count == 0)
+		rightmost = nodes[rightmost].first + 1;
+	unsigned int end = nodes[rightmost].first + nodes[rightmost].count;
+	for (unsigned int i = nodes[leftmost].first; i < end; i++)
+		visible[items[i]] = 1;
+	visibleItems += end - nodes[leftmost].first;
+}
+std::size_t BoundingVolumeHierarchy::GetMemoryUsage() const
+{
+	return nodes.capacity() * sizeof(Node) + items.capacity() * sizeof(unsigned int) +
+		itemBounds.capacity() * sizeof(BoundingBox);
+}
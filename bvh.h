@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Frustum culling of a model's meshes against a BVH; set before the model is drawn
+void SetFrustumCullingEnabled(bool enabled);
+bool IsFrustumCullingEnabled();
+
+struct BoundingBox
+{
+	glm::vec3 min = glm::vec3(1e30f);
+	glm::vec3 max = glm::vec3(-1e30f);
+
+	bool IsEmpty() const { return min.x > max.x; }
+	void Expand(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+	void Expand(const BoundingBox& box) { min = glm::min(min, box.min); max = glm::max(max, box.max); }
+	glm::vec3 GetCenter() const { return 0.5f * (min + max); }
+	float GetSurfaceArea() const;
+};
+
+// The six planes of the clip volume of a matrix (projection * view * model), so boxes are tested in the
+// space the matrix maps from. Planes point inwards.
+class Frustum
+{
+public:
+	enum Containment
+	{
+		OUTSIDE,
+		INTERSECTING,
+		INSIDE
+	};
+
+	explicit Frustum(const glm::mat4& clipFromObject);
+	Containment Classify(const BoundingBox& box) const;
+private:
+	glm::vec4 planes[6];
+};
+
+struct CullStatistics
+{
+	std::size_t testedNodes; // BVH nodes whose box was tested against the frustum
+	std::size_t visibleNodes; // of those, the ones not outside
+	std::size_t visibleItems;
+	std::size_t itemCount;
+	double milliseconds;
+};
+
+// Binned SAH bounding volume hierarchy over a set of boxes (items). The binning of large nodes, which is where
+// the build spends its time, runs on the ParallelFor workers.
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy() = default;
+
+	void Build(const std::vector<BoundingBox>& items);
+	bool IsBuilt() const { return !nodes.empty(); }
+	std::size_t GetItemCount() const { return itemBounds.size(); }
+	std::size_t GetNodeCount() const { return nodes.size(); }
+	const BoundingBox& GetBounds() const; // of every item
+
+	// visible[i] is set to 1 for the items that are not outside the frustum and to 0 for the rest. Subtrees
+	// entirely inside are accepted without testing their nodes.
+	void Cull(const Frustum& frustum, std::vector<unsigned char>& visible, CullStatistics* statistics = nullptr) const;
+
+	std::size_t GetMemoryUsage() const;
+private:
+	// A leaf holds items[first, first + count); an interior node has count 0 and its children at first, first + 1
+	struct Node
+	{
+		BoundingBox bounds;
+		unsigned int first;
+		unsigned int count;
+	};
+
+	std::vector<Node> nodes; // nodes[0] is the root
+	std::vector<unsigned int> items; // item indices in leaf order
+	std::vector<BoundingBox> itemBounds;
+
+	void MarkSubtree(unsigned int node, std::vector<unsigned char>& visible, std::size_t& visibleItems) const; // no allocation
+};
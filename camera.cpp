@@ -65,6 +65,14 @@ void Camera::ProcessMouseScroll(float yOffset)
 		zoom = 45.0f;
 	// UpdateCameraVectors();
 }
+void Camera::LookAt(const glm::vec3& eye, const glm::vec3& target)
+{
+	glm::vec3 direction = glm::normalize(target - eye);
+	position = eye;
+	yaw = glm::degrees(atan2(direction.z, direction.x));
+	pitch = glm::degrees(asin(direction.y));
+	UpdateCameraVectors();
+}
 void Camera::UpdateCameraVectors()
 {
 	glm::vec3 _front;
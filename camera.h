@@ -40,4 +40,6 @@ public:
 	void ProcessKeyboard(CameraMovement direction, float deltaTime);
 	void ProcessMouseMovement(float xOffset, float yOffset, GLboolean constraintPitch = false);
 	void ProcessMouseScroll (float yOffset);
+	// Place the camera at eye, facing target (yaw and pitch are recomputed)
+	void LookAt(const glm::vec3& eye, const glm::vec3& target);
 };
\ No newline at end of file
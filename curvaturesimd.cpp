@@ -0,0 +1,147 @@
+#include "curvaturesimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CURVATURE_SIMD_X86 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef CURVATURE_SIMD_X86
+#include "curvaturesimd_kernels.h"
+
+// 4 lanes of float in an SSE register
+struct FloatSSE
+{
+	static const int Width = 4;
+	__m128 v;
+
+	FloatSSE() : v(_mm_setzero_ps()) {}
+	FloatSSE(__m128 value) : v(value) {}
+	FloatSSE(float value) : v(_mm_set1_ps(value)) {}
+
+	static FloatSSE Gather(const float* base, const int* indices)
+	{
+		return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+	}
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+struct MaskSSE
+{
+	__m128 v;
+};
+
+static inline FloatSSE operator+(const FloatSSE& a, const FloatSSE& b) { return _mm_add_ps(a.v, b.v); }
+static inline FloatSSE operator-(const FloatSSE& a, const FloatSSE& b) { return _mm_sub_ps(a.v, b.v); }
+static inline FloatSSE operator*(const FloatSSE& a, const FloatSSE& b) { return _mm_mul_ps(a.v, b.v); }
+static inline FloatSSE operator/(const FloatSSE& a, const FloatSSE& b) { return _mm_div_ps(a.v, b.v); }
+static inline FloatSSE operator-(const FloatSSE& a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+static inline FloatSSE Sqrt(const FloatSSE& a) { return _mm_sqrt_ps(a.v); }
+static inline FloatSSE Abs(const FloatSSE& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+static inline MaskSSE CmpLE(const FloatSSE& a, const FloatSSE& b) { return { _mm_cmple_ps(a.v, b.v) }; }
+static inline MaskSSE CmpLT(const FloatSSE& a, const FloatSSE& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+static inline MaskSSE CmpGE(const FloatSSE& a, const FloatSSE& b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+static inline MaskSSE CmpNE(const FloatSSE& a, const FloatSSE& b) { return { _mm_cmpneq_ps(a.v, b.v) }; }
+static inline MaskSSE And(const MaskSSE& a, const MaskSSE& b) { return { _mm_and_ps(a.v, b.v) }; }
+static inline int MaskBits(const MaskSSE& mask) { return _mm_movemask_ps(mask.v); }
+static inline FloatSSE Select(const MaskSSE& mask, const FloatSSE& a, const FloatSSE& b)
+{
+	return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+// Implemented in curvaturesimd_avx2.cpp
+int FaceCurvatureKernelAVX2(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec3* cornerCurvatures, unsigned char* faceValid);
+int FaceDerivativeCurvatureKernelAVX2(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec4* cornerDerivatives, unsigned char* faceValid);
+int DiagonalizeKernelAVX2(int begin, int end, const glm::vec3* normals, const float* curv12,
+	glm::vec3* pdir1, glm::vec3* pdir2, float* curv1, float* curv2);
+
+static bool CpuSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return false;
+	// The OS must save the YMM registers on context switch
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+static SimdLevel DetectSimdLevel()
+{
+#ifdef CURVATURE_SIMD_X86
+	return CpuSupportsAVX2() ? SIMD_AVX2 : SIMD_SSE;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+static const SimdLevel supportedSimdLevel = DetectSimdLevel();
+static SimdLevel currentSimdLevel = supportedSimdLevel;
+
+SimdLevel GetSimdLevel()
+{
+	return currentSimdLevel;
+}
+void SetSimdLevel(SimdLevel level)
+{
+	currentSimdLevel = level < supportedSimdLevel ? level : supportedSimdLevel;
+}
+const char* GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE: return "SSE";
+	case SIMD_AVX2: return "AVX2";
+	default: return "scalar";
+	}
+}
+
+int ComputeFaceCurvaturesSimd(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec3* cornerCurvatures, unsigned char* faceValid)
+{
+#ifdef CURVATURE_SIMD_X86
+	if (currentSimdLevel == SIMD_AVX2)
+		begin = FaceCurvatureKernelAVX2(input, begin, end, cornerCurvatures, faceValid);
+	if (currentSimdLevel >= SIMD_SSE)
+		begin = FaceCurvatureKernel<FloatSSE>(input, begin, end, cornerCurvatures, faceValid);
+#endif
+	return begin;
+}
+int ComputeFaceDerivativeCurvaturesSimd(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec4* cornerDerivatives, unsigned char* faceValid)
+{
+#ifdef CURVATURE_SIMD_X86
+	if (currentSimdLevel == SIMD_AVX2)
+		begin = FaceDerivativeCurvatureKernelAVX2(input, begin, end, cornerDerivatives, faceValid);
+	if (currentSimdLevel >= SIMD_SSE)
+		begin = FaceDerivativeCurvatureKernel<FloatSSE>(input, begin, end, cornerDerivatives, faceValid);
+#endif
+	return begin;
+}
+int DiagonalizeCurvaturesSimd(int begin, int end, const glm::vec3* normals, const float* curv12,
+	glm::vec3* pdir1, glm::vec3* pdir2, float* curv1, float* curv2)
+{
+#ifdef CURVATURE_SIMD_X86
+	if (currentSimdLevel == SIMD_AVX2)
+		begin = DiagonalizeKernelAVX2(begin, end, normals, curv12, pdir1, pdir2, curv1, curv2);
+	if (currentSimdLevel >= SIMD_SSE)
+		begin = DiagonalizeKernel<FloatSSE>(begin, end, normals, curv12, pdir1, pdir2, curv1, curv2);
+#endif
+	return begin;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <glm/glm.hpp>
+
+// Instruction set used by the batched curvature kernels
+enum SimdLevel
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE = 1, // 4 faces per batch
+	SIMD_AVX2 = 2 // 8 faces per batch
+};
+
+// The best level supported by this CPU, unless lowered with SetSimdLevel
+SimdLevel GetSimdLevel();
+void SetSimdLevel(SimdLevel level); // clamped to what the CPU supports
+const char* GetSimdLevelName(SimdLevel level);
+
+// Per vertex / per face arrays read by the curvature kernels
+struct CurvatureKernelInput
+{
+	const std::array<unsigned int, 3>* faces;
+	const glm::vec3* cornerAreas; // per face
+	const glm::vec3* positions;
+	const glm::vec3* normals;
+	const glm::vec3* pdir1;
+	const glm::vec3* pdir2;
+	const float* curv1;
+	const float* curv2;
+	const float* pointAreas;
+};
+
+// The kernels below process whole batches of faces (or vertices) starting at begin, and return the
+// index of the first element they did not process. The caller finishes [returned, end) with the
+// scalar code. With SIMD_SCALAR they return begin.
+//
+// Every operation is evaluated in the same order as the scalar glm code, so results are
+// bit-identical as long as the compiler does not contract multiply-adds into FMA.
+
+// Least squares curvature tensor per face, projected into the frame of each corner's vertex.
+// Writes the point area weighted (curv1, curv12, curv2) for corner j of face i to cornerCurvatures[3 * i + j].
+int ComputeFaceCurvaturesSimd(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec3* cornerCurvatures, unsigned char* faceValid);
+// Least squares derivative of curvature per face, projected into the frame of each corner's vertex.
+// Writes the point area weighted dcurv for corner j of face i to cornerDerivatives[3 * i + j].
+int ComputeFaceDerivativeCurvaturesSimd(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec4* cornerDerivatives, unsigned char* faceValid);
+// diagonalize_curv for vertices [begin, end); pdir1/pdir2/curv1/curv2 are updated in place
+int DiagonalizeCurvaturesSimd(int begin, int end, const glm::vec3* normals, const float* curv12,
+	glm::vec3* pdir1, glm::vec3* pdir2, float* curv1, float* curv2);
@@ -0,0 +1,78 @@
+// AVX2 instantiation of the curvature kernels. Only called after CPUID reported AVX2 support.
+// MSVC accepts AVX2 intrinsics without /arch:AVX2; GCC and Clang need the target enabled for this file.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include "curvaturesimd.h"
+
+// Only the kernels below are compiled for AVX2; glm and the standard headers stay baseline
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "curvaturesimd_kernels.h"
+
+// 8 lanes of float in an AVX register
+struct FloatAVX
+{
+	static const int Width = 8;
+	__m256 v;
+
+	FloatAVX() : v(_mm256_setzero_ps()) {}
+	FloatAVX(__m256 value) : v(value) {}
+	FloatAVX(float value) : v(_mm256_set1_ps(value)) {}
+
+	static FloatAVX Gather(const float* base, const int* indices)
+	{
+		return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4);
+	}
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+struct MaskAVX
+{
+	__m256 v;
+};
+
+static inline FloatAVX operator+(const FloatAVX& a, const FloatAVX& b) { return _mm256_add_ps(a.v, b.v); }
+static inline FloatAVX operator-(const FloatAVX& a, const FloatAVX& b) { return _mm256_sub_ps(a.v, b.v); }
+static inline FloatAVX operator*(const FloatAVX& a, const FloatAVX& b) { return _mm256_mul_ps(a.v, b.v); }
+static inline FloatAVX operator/(const FloatAVX& a, const FloatAVX& b) { return _mm256_div_ps(a.v, b.v); }
+static inline FloatAVX operator-(const FloatAVX& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+static inline FloatAVX Sqrt(const FloatAVX& a) { return _mm256_sqrt_ps(a.v); }
+static inline FloatAVX Abs(const FloatAVX& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+static inline MaskAVX CmpLE(const FloatAVX& a, const FloatAVX& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+static inline MaskAVX CmpLT(const FloatAVX& a, const FloatAVX& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+static inline MaskAVX CmpGE(const FloatAVX& a, const FloatAVX& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+static inline MaskAVX CmpNE(const FloatAVX& a, const FloatAVX& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) }; }
+static inline MaskAVX And(const MaskAVX& a, const MaskAVX& b) { return { _mm256_and_ps(a.v, b.v) }; }
+static inline int MaskBits(const MaskAVX& mask) { return _mm256_movemask_ps(mask.v); }
+static inline FloatAVX Select(const MaskAVX& mask, const FloatAVX& a, const FloatAVX& b)
+{
+	return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+
+int FaceCurvatureKernelAVX2(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec3* cornerCurvatures, unsigned char* faceValid)
+{
+	return FaceCurvatureKernel<FloatAVX>(input, begin, end, cornerCurvatures, faceValid);
+}
+int FaceDerivativeCurvatureKernelAVX2(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec4* cornerDerivatives, unsigned char* faceValid)
+{
+	return FaceDerivativeCurvatureKernel<FloatAVX>(input, begin, end, cornerDerivatives, faceValid);
+}
+int DiagonalizeKernelAVX2(int begin, int end, const glm::vec3* normals, const float* curv12,
+	glm::vec3* pdir1, glm::vec3* pdir2, float* curv1, float* curv2)
+{
+	return DiagonalizeKernel<FloatAVX>(begin, end, normals, curv12, pdir1, pdir2, curv1, curv2);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
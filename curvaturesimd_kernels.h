@@ -0,0 +1,474 @@
+#pragma once
+// Batched curvature kernels, written once against a SIMD lane type F and instantiated by
+// curvaturesimd.cpp (SSE) and curvaturesimd_avx2.cpp (AVX2). Only include it from those files.
+//
+// F provides: F::Width, F(float), +, -, *, / and unary -, Sqrt, Abs, Select(mask, a, b),
+// CmpLE/CmpLT/CmpGE/CmpNE returning a mask, And(mask, mask), MaskBits(mask),
+// F::Gather(base, indices) with indices in floats, and Store(float*).
+//
+// Expressions are spelled exactly like the glm versions in mesh.cpp so that the floating point
+// operations happen in the same order.
+#include "curvaturesimd.h"
+
+template <class F>
+struct Vec3Lanes
+{
+	F x, y, z;
+};
+
+template <class F>
+struct Vec4Lanes
+{
+	F x, y, z, w;
+};
+
+template <class F>
+static inline Vec3Lanes<F> operator+(const Vec3Lanes<F>& a, const Vec3Lanes<F>& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+template <class F>
+static inline Vec3Lanes<F> operator-(const Vec3Lanes<F>& a, const Vec3Lanes<F>& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+template <class F>
+static inline Vec3Lanes<F> operator-(const Vec3Lanes<F>& a) { return { -a.x, -a.y, -a.z }; }
+template <class F>
+static inline Vec3Lanes<F> operator*(const F& s, const Vec3Lanes<F>& a) { return { s * a.x, s * a.y, s * a.z }; }
+template <class F>
+static inline Vec3Lanes<F> operator*(const Vec3Lanes<F>& a, const F& s) { return { a.x * s, a.y * s, a.z * s }; }
+
+// glm::dot adds the products as (x + y) + z
+template <class F>
+static inline F Dot(const Vec3Lanes<F>& a, const Vec3Lanes<F>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+template <class F>
+static inline Vec3Lanes<F> Cross(const Vec3Lanes<F>& a, const Vec3Lanes<F>& b)
+{
+	return { a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y };
+}
+// glm::normalize is v * inversesqrt(dot(v, v)) with inversesqrt(x) = 1 / sqrt(x)
+template <class F>
+static inline Vec3Lanes<F> Normalize(const Vec3Lanes<F>& a) { return a * (F(1.0f) / Sqrt(Dot(a, a))); }
+template <class F, class M>
+static inline Vec3Lanes<F> Select(const M& mask, const Vec3Lanes<F>& a, const Vec3Lanes<F>& b)
+{
+	return { Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z) };
+}
+
+// Load one vec3 per lane from an array of glm::vec3 / glm::vec4
+template <class F>
+static inline Vec3Lanes<F> GatherVec3(const glm::vec3* base, const int (&vertexIndices)[F::Width])
+{
+	alignas(32) int indices[F::Width];
+	const float* floats = &base[0].x;
+	Vec3Lanes<F> result;
+	for (int l = 0; l < F::Width; l++)
+		indices[l] = vertexIndices[l] * 3;
+	result.x = F::Gather(floats, indices);
+	for (int l = 0; l < F::Width; l++)
+		indices[l] += 1;
+	result.y = F::Gather(floats, indices);
+	for (int l = 0; l < F::Width; l++)
+		indices[l] += 1;
+	result.z = F::Gather(floats, indices);
+	return result;
+}
+template <class F>
+static inline F GatherFloat(const float* base, const int (&indices)[F::Width])
+{
+	return F::Gather(base, indices);
+}
+
+template <class F>
+static inline void rot_coord_sys_lanes(const Vec3Lanes<F>& old_u, const Vec3Lanes<F>& old_v,
+	const Vec3Lanes<F>& new_norm,
+	Vec3Lanes<F>& new_u, Vec3Lanes<F>& new_v)
+{
+	new_u = old_u;
+	new_v = old_v;
+	Vec3Lanes<F> old_norm = Cross(old_u, old_v);
+	F ndot = Dot(old_norm, new_norm);
+	auto opposite = CmpLE(ndot, F(-1.0f));
+
+	// Perpendicular to old_norm and in the plane of old_norm and new_norm
+	Vec3Lanes<F> perp_old = new_norm - ndot * old_norm;
+
+	// perp_old - perp_new, with normalization constants folded in
+	Vec3Lanes<F> dperp = F(1.0f) / (F(1.0f) + ndot) * (old_norm + new_norm);
+
+	new_u = new_u - dperp * Dot(new_u, perp_old);
+	new_v = new_v - dperp * Dot(new_v, perp_old);
+
+	new_u = Select(opposite, -old_u, new_u);
+	new_v = Select(opposite, -old_v, new_v);
+}
+
+template <class F>
+static inline void proj_curv_lanes(const Vec3Lanes<F>& old_u, const Vec3Lanes<F>& old_v,
+	const F& old_ku, const F& old_kuv, const F& old_kv,
+	const Vec3Lanes<F>& new_u, const Vec3Lanes<F>& new_v,
+	F& new_ku, F& new_kuv, F& new_kv)
+{
+	Vec3Lanes<F> r_new_u, r_new_v;
+	rot_coord_sys_lanes(new_u, new_v, Cross(old_u, old_v), r_new_u, r_new_v);
+
+	F u1 = Dot(r_new_u, old_u);
+	F v1 = Dot(r_new_u, old_v);
+	F u2 = Dot(r_new_v, old_u);
+	F v2 = Dot(r_new_v, old_v);
+
+	new_ku = old_ku * u1 * u1 + old_kuv * (F(2.0f) * u1 * v1) + old_kv * v1 * v1;
+	new_kuv = old_ku * u1 * u2 + old_kuv * (u1 * v2 + u2 * v1) + old_kv * v1 * v2;
+	new_kv = old_ku * u2 * u2 + old_kuv * (F(2.0f) * u2 * v2) + old_kv * v2 * v2;
+}
+
+template <class F>
+static inline void proj_dcurv_lanes(const Vec3Lanes<F>& old_u, const Vec3Lanes<F>& old_v,
+	const Vec4Lanes<F>& old_dcurv,
+	const Vec3Lanes<F>& new_u, const Vec3Lanes<F>& new_v,
+	Vec4Lanes<F>& new_dcurv)
+{
+	Vec3Lanes<F> r_new_u, r_new_v;
+	rot_coord_sys_lanes(new_u, new_v, Cross(old_u, old_v), r_new_u, r_new_v);
+
+	F u1 = Dot(r_new_u, old_u);
+	F v1 = Dot(r_new_u, old_v);
+	F u2 = Dot(r_new_v, old_u);
+	F v2 = Dot(r_new_v, old_v);
+	F three(3.0f), two(2.0f);
+
+	new_dcurv.x = old_dcurv.x * u1 * u1 * u1 +
+		old_dcurv.y * three * u1 * u1 * v1 +
+		old_dcurv.z * three * u1 * v1 * v1 +
+		old_dcurv.w * v1 * v1 * v1;
+	new_dcurv.y = old_dcurv.x * u1 * u1 * u2 +
+		old_dcurv.y * (u1 * u1 * v2 + two * u2 * u1 * v1) +
+		old_dcurv.z * (u2 * v1 * v1 + two * u1 * v1 * v2) +
+		old_dcurv.w * v1 * v1 * v2;
+	new_dcurv.z = old_dcurv.x * u1 * u2 * u2 +
+		old_dcurv.y * (u2 * u2 * v1 + two * u1 * u2 * v2) +
+		old_dcurv.z * (u1 * v2 * v2 + two * u2 * v2 * v1) +
+		old_dcurv.w * v1 * v2 * v2;
+	new_dcurv.w = old_dcurv.x * u2 * u2 * u2 +
+		old_dcurv.y * three * u2 * u2 * v2 +
+		old_dcurv.z * three * u2 * v2 * v2 +
+		old_dcurv.w * v2 * v2 * v2;
+}
+
+template <class F>
+static inline void diagonalize_curv_lanes(const Vec3Lanes<F>& old_u, const Vec3Lanes<F>& old_v,
+	const F& ku, const F& kuv, const F& kv,
+	const Vec3Lanes<F>& new_norm,
+	Vec3Lanes<F>& pdir1, Vec3Lanes<F>& pdir2, F& k1, F& k2)
+{
+	Vec3Lanes<F> r_old_u, r_old_v;
+	rot_coord_sys_lanes(old_u, old_v, new_norm, r_old_u, r_old_v);
+
+	// Jacobi rotation to diagonalize, only where kuv != 0
+	auto rotate = CmpNE(kuv, F(0.0f));
+	F one(1.0f);
+	F h = F(0.5f) * (kv - ku) / kuv;
+	F root = Sqrt(one + h * h);
+	F tt = Select(CmpLT(h, F(0.0f)), one / (h - root), one / (h + root));
+	F c = one / Sqrt(one + tt * tt);
+	F s = tt * c;
+	tt = Select(rotate, tt, F(0.0f));
+	c = Select(rotate, c, one);
+	s = Select(rotate, s, F(0.0f));
+
+	F r1 = ku - tt * kuv;
+	F r2 = kv + tt * kuv;
+
+	auto keep = CmpGE(Abs(r1), Abs(r2));
+	pdir1 = Select(keep, c * r_old_u - s * r_old_v, s * r_old_u + c * r_old_v);
+	k1 = Select(keep, r1, r2);
+	k2 = Select(keep, r2, r1);
+	pdir2 = Cross(new_norm, pdir1);
+}
+
+// Port of ldltdc: returns the mask of lanes whose decomposition succeeded
+template <class F, int N>
+static inline auto ldltdc_lanes(F (&A)[N][N], F (&rdiag)[N]) -> decltype(CmpNE(F(), F()))
+{
+	F zero(0.0f), one(1.0f);
+	if (N <= 3)
+	{
+		F d0 = A[0][0];
+		rdiag[0] = one / d0;
+		A[1][0] = A[0][1];
+		F l10 = rdiag[0] * A[1][0];
+		F d1 = A[1][1] - l10 * A[1][0];
+		rdiag[1] = one / d1;
+		F d2 = A[2][2] - rdiag[0] * (A[2][0] * A[2][0]) - rdiag[1] * (A[2][1] * A[2][1]);
+		rdiag[2] = one / d2;
+		A[2][0] = A[0][2];
+		A[2][1] = A[1][2] - l10 * A[2][0];
+		return And(And(CmpNE(d0, zero), CmpNE(d1, zero)), CmpNE(d2, zero));
+	}
+
+	auto valid = CmpNE(one, zero);
+	F v[N - 1];
+	for (int i = 0; i < N; i++)
+	{
+		for (int k = 0; k < i; k++)
+			v[k] = A[i][k] * rdiag[k];
+		for (int j = i; j < N; j++)
+		{
+			F sum = A[i][j];
+			for (int k = 0; k < i; k++)
+				sum = sum - v[k] * A[j][k];
+			if (i == j)
+			{
+				valid = And(valid, CmpNE(sum, zero));
+				rdiag[i] = one / sum;
+			}
+			else
+			{
+				A[j][i] = sum;
+			}
+		}
+	}
+	return valid;
+}
+
+template <class F, int N>
+static inline void ldltsl_lanes(const F (&A)[N][N], const F (&rdiag)[N], const F (&b)[N], F (&x)[N])
+{
+	for (int i = 0; i < N; i++)
+	{
+		F sum = b[i];
+		for (int k = 0; k < i; k++)
+			sum = sum - A[i][k] * x[k];
+		x[i] = sum * rdiag[i];
+	}
+	for (int i = N - 1; i >= 0; i--)
+	{
+		F sum(0.0f);
+		for (int k = i + 1; k < N; k++)
+			sum = sum + A[k][i] * x[k];
+		x[i] = x[i] - sum * rdiag[i];
+	}
+}
+
+// Edges and N-T-B frame of a batch of faces
+template <class F>
+struct FaceFrameLanes
+{
+	int vertexIndices[3][F::Width];
+	Vec3Lanes<F> e[3];
+	Vec3Lanes<F> t, b;
+};
+
+template <class F>
+static inline void LoadFaceFrame(const CurvatureKernelInput& input, int first, FaceFrameLanes<F>& frame)
+{
+	for (int l = 0; l < F::Width; l++)
+	{
+		for (int j = 0; j < 3; j++)
+			frame.vertexIndices[j][l] = static_cast<int>(input.faces[first + l][j]);
+	}
+
+	Vec3Lanes<F> p[3];
+	for (int j = 0; j < 3; j++)
+		p[j] = GatherVec3<F>(input.positions, frame.vertexIndices[j]);
+
+	frame.e[0] = p[2] - p[1];
+	frame.e[1] = p[0] - p[2];
+	frame.e[2] = p[1] - p[0];
+
+	frame.t = Normalize(frame.e[0]);
+	Vec3Lanes<F> n = Cross(frame.e[0], frame.e[1]);
+	frame.b = Normalize(Cross(n, frame.t));
+}
+
+// cornerAreas[face][j] / pointAreas[face[j]] for every lane
+template <class F>
+static inline F CornerWeight(const CurvatureKernelInput& input, int first, int j, const int (&vertexIndices)[F::Width])
+{
+	alignas(32) int cornerIndices[F::Width];
+	for (int l = 0; l < F::Width; l++)
+		cornerIndices[l] = 3 * (first + l) + j;
+	return GatherFloat<F>(&input.cornerAreas[0].x, cornerIndices) / GatherFloat<F>(input.pointAreas, vertexIndices);
+}
+
+template <class F>
+static inline void StoreFaceValid(const decltype(CmpNE(F(), F()))& valid, int first, unsigned char* faceValid)
+{
+	int bits = MaskBits(valid);
+	for (int l = 0; l < F::Width; l++)
+		faceValid[first + l] = static_cast<unsigned char>((bits >> l) & 1);
+}
+
+template <class F>
+static int FaceCurvatureKernel(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec3* cornerCurvatures, unsigned char* faceValid)
+{
+	const int W = F::Width;
+	int i = begin;
+	for (; i + W <= end; i += W)
+	{
+		FaceFrameLanes<F> frame;
+		LoadFaceFrame(input, i, frame);
+
+		Vec3Lanes<F> normal[3];
+		for (int j = 0; j < 3; j++)
+			normal[j] = GatherVec3<F>(input.normals, frame.vertexIndices[j]);
+
+		// Estimate curvature based on variation of normals
+		// along edges
+		F zero(0.0f);
+		F m[3] = { zero, zero, zero };
+		F w[3][3] = { { zero, zero, zero }, { zero, zero, zero }, { zero, zero, zero } };
+		for (int j = 0; j < 3; j++)
+		{
+			F u = Dot(frame.e[j], frame.t);
+			F v = Dot(frame.e[j], frame.b);
+			w[0][0] = w[0][0] + u * u;
+			w[0][1] = w[0][1] + u * v;
+			w[2][2] = w[2][2] + v * v;
+			Vec3Lanes<F> dn = normal[(j + 2) % 3] - normal[(j + 1) % 3];
+			F dnu = Dot(dn, frame.t);
+			F dnv = Dot(dn, frame.b);
+			m[0] = m[0] + dnu * u;
+			m[1] = m[1] + (dnu * v + dnv * u);
+			m[2] = m[2] + dnv * v;
+		}
+		w[1][1] = w[0][0] + w[2][2];
+		w[1][2] = w[0][1];
+
+		// Least squares solution
+		F diag[3];
+		auto valid = ldltdc_lanes<F, 3>(w, diag);
+		ldltsl_lanes<F, 3>(w, diag, m, m);
+		StoreFaceValid<F>(valid, i, faceValid);
+
+		// Project into each vertex's frame, weighted by the corner's share of the point area
+		for (int j = 0; j < 3; j++)
+		{
+			Vec3Lanes<F> pdir1 = GatherVec3<F>(input.pdir1, frame.vertexIndices[j]);
+			Vec3Lanes<F> pdir2 = GatherVec3<F>(input.pdir2, frame.vertexIndices[j]);
+			F c1, c12, c2;
+			proj_curv_lanes(frame.t, frame.b, m[0], m[1], m[2], pdir1, pdir2, c1, c12, c2);
+			F wt = CornerWeight<F>(input, i, j, frame.vertexIndices[j]);
+
+			alignas(32) float out[3][W];
+			(wt * c1).Store(out[0]);
+			(wt * c12).Store(out[1]);
+			(wt * c2).Store(out[2]);
+			for (int l = 0; l < W; l++)
+				cornerCurvatures[3 * (i + l) + j] = glm::vec3(out[0][l], out[1][l], out[2][l]);
+		}
+	}
+	return i;
+}
+
+template <class F>
+static int FaceDerivativeCurvatureKernel(const CurvatureKernelInput& input, int begin, int end,
+	glm::vec4* cornerDerivatives, unsigned char* faceValid)
+{
+	const int W = F::Width;
+	int i = begin;
+	for (; i + W <= end; i += W)
+	{
+		FaceFrameLanes<F> frame;
+		LoadFaceFrame(input, i, frame);
+
+		// Project curvature tensor from each vertex into this
+		// face's coordinate system
+		Vec3Lanes<F> pdir1[3], pdir2[3], fcurv[3];
+		F zero(0.0f);
+		for (int j = 0; j < 3; j++)
+		{
+			pdir1[j] = GatherVec3<F>(input.pdir1, frame.vertexIndices[j]);
+			pdir2[j] = GatherVec3<F>(input.pdir2, frame.vertexIndices[j]);
+			F k1 = GatherFloat<F>(input.curv1, frame.vertexIndices[j]);
+			F k2 = GatherFloat<F>(input.curv2, frame.vertexIndices[j]);
+			proj_curv_lanes(pdir1[j], pdir2[j], k1, zero, k2, frame.t, frame.b, fcurv[j].x, fcurv[j].y, fcurv[j].z);
+		}
+
+		// Estimate dcurv based on variation of curvature along edges
+		F two(2.0f);
+		F m[4] = { zero, zero, zero, zero };
+		F w[4][4] = { { zero, zero, zero, zero }, { zero, zero, zero, zero }, { zero, zero, zero, zero }, { zero, zero, zero, zero } };
+		for (int j = 0; j < 3; j++)
+		{
+			// Variation of curvature along each edge
+			Vec3Lanes<F> dfcurv = fcurv[(j + 2) % 3] - fcurv[(j + 1) % 3];
+			F u = Dot(frame.e[j], frame.t);
+			F v = Dot(frame.e[j], frame.b);
+			F u2 = u * u, v2 = v * v, uv = u * v;
+			w[0][0] = w[0][0] + u2;
+			w[0][1] = w[0][1] + uv;
+			w[3][3] = w[3][3] + v2;
+			m[0] = m[0] + u * dfcurv.x;
+			m[1] = m[1] + (v * dfcurv.x + two * u * dfcurv.y);
+			m[2] = m[2] + (two * v * dfcurv.y + u * dfcurv.z);
+			m[3] = m[3] + v * dfcurv.z;
+		}
+		w[1][1] = two * w[0][0] + w[3][3];
+		w[1][2] = two * w[0][1];
+		w[2][2] = w[0][0] + two * w[3][3];
+		w[2][3] = w[0][1];
+
+		// Least squares solution
+		F d[4];
+		auto valid = ldltdc_lanes<F, 4>(w, d);
+		ldltsl_lanes<F, 4>(w, d, m, m);
+		StoreFaceValid<F>(valid, i, faceValid);
+
+		Vec4Lanes<F> face_dcurv = { m[0], m[1], m[2], m[3] };
+
+		// Project into each vertex's frame
+		for (int j = 0; j < 3; j++)
+		{
+			Vec4Lanes<F> this_vert_dcurv;
+			proj_dcurv_lanes(frame.t, frame.b, face_dcurv, pdir1[j], pdir2[j], this_vert_dcurv);
+			F wt = CornerWeight<F>(input, i, j, frame.vertexIndices[j]);
+
+			alignas(32) float out[4][W];
+			(wt * this_vert_dcurv.x).Store(out[0]);
+			(wt * this_vert_dcurv.y).Store(out[1]);
+			(wt * this_vert_dcurv.z).Store(out[2]);
+			(wt * this_vert_dcurv.w).Store(out[3]);
+			for (int l = 0; l < W; l++)
+				cornerDerivatives[3 * (i + l) + j] = glm::vec4(out[0][l], out[1][l], out[2][l], out[3][l]);
+		}
+	}
+	return i;
+}
+
+template <class F>
+static int DiagonalizeKernel(int begin, int end, const glm::vec3* normals, const float* curv12,
+	glm::vec3* pdir1, glm::vec3* pdir2, float* curv1, float* curv2)
+{
+	const int W = F::Width;
+	int i = begin;
+	for (; i + W <= end; i += W)
+	{
+		alignas(32) int indices[W];
+		for (int l = 0; l < W; l++)
+			indices[l] = i + l;
+
+		Vec3Lanes<F> u = GatherVec3<F>(pdir1, indices);
+		Vec3Lanes<F> v = GatherVec3<F>(pdir2, indices);
+		Vec3Lanes<F> normal = GatherVec3<F>(normals, indices);
+		F ku = GatherFloat<F>(curv1, indices);
+		F kuv = GatherFloat<F>(curv12, indices);
+		F kv = GatherFloat<F>(curv2, indices);
+
+		Vec3Lanes<F> d1, d2;
+		F k1, k2;
+		diagonalize_curv_lanes(u, v, ku, kuv, kv, normal, d1, d2, k1, k2);
+
+		alignas(32) float out[6][W];
+		d1.x.Store(out[0]);
+		d1.y.Store(out[1]);
+		d1.z.Store(out[2]);
+		d2.x.Store(out[3]);
+		d2.y.Store(out[4]);
+		d2.z.Store(out[5]);
+		k1.Store(curv1 + i);
+		k2.Store(curv2 + i);
+		for (int l = 0; l < W; l++)
+		{
+			pdir1[i + l] = glm::vec3(out[0][l], out[1][l], out[2][l]);
+			pdir2[i + l] = glm::vec3(out[3][l], out[4][l], out[5][l]);
+		}
+	}
+	return i;
+}
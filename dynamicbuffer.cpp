@@ -0,0 +1,152 @@
+#include "dynamicbuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+static const GLuint64 fenceTimeout = 1000000000; // 1 s, in nanoseconds
+
+DynamicBuffer::DynamicBuffer(DynamicBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+DynamicBuffer& DynamicBuffer::operator=(DynamicBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		std::swap(bufferID, other.bufferID);
+		std::swap(mapping, other.mapping);
+		staging.swap(other.staging);
+		fences.swap(other.fences);
+		pending.swap(other.pending);
+		std::swap(regionSize, other.regionSize);
+		std::swap(regionCount, other.regionCount);
+		std::swap(writeRegion, other.writeRegion);
+		std::swap(readRegion, other.readRegion);
+		std::swap(waitCount, other.waitCount);
+	}
+	return *this;
+}
+bool DynamicBuffer::Create(std::size_t regionSize, unsigned int regionCount)
+{
+	Destroy();
+	if (regionSize == 0 || regionCount == 0)
+		return false;
+	this->regionSize = regionSize;
+	this->regionCount = regionCount;
+	GLsizeiptr size = static_cast<GLsizeiptr>(regionSize * regionCount);
+
+	GLint previousBuffer = 0;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousBuffer);
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+	if (GLEW_ARB_buffer_storage)
+	{
+		// Dynamic storage keeps glBufferSubData available in case the mapping fails
+		const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, mapFlags | GL_DYNAMIC_STORAGE_BIT);
+		mapping = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, mapFlags));
+	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, previousBuffer);
+
+	if (mapping == nullptr)
+		staging.resize(regionSize);
+	fences.assign(regionCount, nullptr);
+	pending.assign(regionCount, Range{ 0, regionSize }); // every region starts out undefined
+	writeRegion = 0;
+	readRegion = 0;
+	waitCount = 0;
+	return true;
+}
+void DynamicBuffer::Destroy()
+{
+	for (auto fence : fences)
+		glDeleteSync(fence);
+	glDeleteBuffers(1, &bufferID); // also unmaps it
+
+	bufferID = 0;
+	mapping = nullptr;
+	std::vector<unsigned char>().swap(staging);
+	fences.clear();
+	pending.clear();
+	regionSize = 0;
+	regionCount = 0;
+}
+unsigned char* DynamicBuffer::BeginWrite()
+{
+	if (!IsCreated())
+		return nullptr;
+	WaitForRegion(writeRegion);
+	return mapping ? mapping + writeRegion * regionSize : staging.data();
+}
+void DynamicBuffer::EndWrite(std::size_t first, std::size_t last)
+{
+	if (!IsCreated())
+		return;
+	last = std::min(last, regionSize);
+	if (mapping == nullptr && first < last)
+	{
+		GLint previousBuffer = 0;
+		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+		glBufferSubData(GL_ARRAY_BUFFER, writeRegion * regionSize + first, last - first, staging.data() + first);
+		glBindBuffer(GL_ARRAY_BUFFER, previousBuffer);
+	}
+	readRegion = writeRegion;
+	writeRegion = (writeRegion + 1) % regionCount;
+}
+void DynamicBuffer::FenceRead()
+{
+	if (!IsCreated())
+		return;
+	// A later fence covers every earlier draw of the frame
+	glDeleteSync(fences[readRegion]);
+	fences[readRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+std::size_t DynamicBuffer::Update(const void* source, std::size_t first, std::size_t last)
+{
+	if (!IsCreated())
+		return 0;
+	last = std::min(last, regionSize);
+	if (first < last)
+	{
+		for (auto& range : pending)
+		{
+			if (range.first >= range.last)
+				range = Range{ first, last };
+			else
+				range = Range{ std::min(range.first, first), std::max(range.last, last) };
+		}
+	}
+
+	Range range = pending[writeRegion];
+	if (range.first >= range.last)
+		return 0;
+	pending[writeRegion] = Range{ 0, 0 };
+
+	// The staging copy only has to hold the bytes that are uploaded
+	unsigned char* region = BeginWrite();
+	std::size_t bytes = range.last - range.first;
+	std::memcpy(region + range.first, static_cast<const unsigned char*>(source) + range.first, bytes);
+	EndWrite(range.first, range.last);
+	return bytes;
+}
+void DynamicBuffer::WaitForRegion(unsigned int region)
+{
+	GLsync fence = fences[region];
+	if (fence == nullptr)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		waitCount++;
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+	}
+	if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+		std::cerr << "ERROR::DYNAMIC_BUFFER::FENCE_WAIT_FAILED\n";
+	glDeleteSync(fence);
+	fences[region] = nullptr;
+}
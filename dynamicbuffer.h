@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+// GPU buffer whose contents change every frame. It holds regionCount copies of the data: each frame writes the next
+// region while the GPU may still be reading the previous ones, and a fence per region stops the CPU only if it gets
+// a whole ring ahead of the GPU. With GL_ARB_buffer_storage the buffer is mapped once, persistently and coherently,
+// so a region can be filled in place (also from worker threads) with no glBufferData reallocation or implicit sync;
+// otherwise the region is staged in memory and uploaded with glBufferSubData into the part the GPU is not using.
+// Like the mesh's other GL objects it is destroyed explicitly, on the GL thread.
+class DynamicBuffer
+{
+public:
+	DynamicBuffer() = default;
+	DynamicBuffer(const DynamicBuffer&) = delete;
+	DynamicBuffer& operator=(const DynamicBuffer&) = delete;
+	DynamicBuffer(DynamicBuffer&& other) noexcept;
+	DynamicBuffer& operator=(DynamicBuffer&& other) noexcept;
+
+	bool Create(std::size_t regionSize, unsigned int regionCount = 3);
+	void Destroy();
+	bool IsCreated() const { return bufferID != 0; }
+	bool IsPersistent() const { return mapping != nullptr; }
+	GLuint GetBufferID() const { return bufferID; }
+	std::size_t GetRegionSize() const { return regionSize; }
+
+	// Start writing the next region, waiting only while the GPU still reads it. The memory may be written from
+	// any thread until EndWrite; it holds what was last written to this region, not the previous frame.
+	unsigned char* BeginWrite();
+	// Publish bytes [first, last) of the region (uploaded now when the buffer is not persistent)
+	void EndWrite(std::size_t first, std::size_t last);
+	// Byte offset of the region last published, for glVertexAttribPointer or glBindBufferRange
+	std::size_t GetReadOffset() const { return readRegion * regionSize; }
+	// Fence the region last published, after the draws that read it have been submitted
+	void FenceRead();
+
+	// For data kept in full on the CPU (source, regionSize bytes) of which bytes [first, last) changed this frame:
+	// write the next region with everything that changed since that region was last written, so incremental
+	// updates stay incremental across the ring. Nothing is written, and the read region stays, if nothing is pending.
+	// Returns the number of bytes copied.
+	std::size_t Update(const void* source, std::size_t first, std::size_t last);
+
+	unsigned int GetWaitCount() const { return waitCount; } // BeginWrite calls that had to wait for the GPU
+private:
+	// Byte range not yet written to a region; empty when first >= last
+	struct Range
+	{
+		std::size_t first;
+		std::size_t last;
+	};
+
+	GLuint bufferID = 0;
+	unsigned char* mapping = nullptr; // whole buffer, if persistent
+	std::vector<unsigned char> staging; // one region, if not
+	std::vector<GLsync> fences; // per region
+	std::vector<Range> pending; // per region, for Update
+	std::size_t regionSize = 0;
+	unsigned int regionCount = 0;
+	unsigned int writeRegion = 0;
+	unsigned int readRegion = 0;
+	unsigned int waitCount = 0;
+
+	void WaitForRegion(unsigned int region);
+};
@@ -0,0 +1,219 @@
+#include "edgetopology.h"
+#include <algorithm>
+#include <cstdint>
+#include "parallel.h"
+
+static const int edgeChunk = 16384;
+static const int edgePartitionBits = 8;
+static const unsigned int edgePartitionCount = 1u << edgePartitionBits;
+
+// Half-edge as seen by one face corner
+struct HalfEdge
+{
+	std::uint64_t key; // lower vertex in the high word, so the key is the same from both faces
+	unsigned int corner; // 3 * face + j
+};
+
+static std::uint64_t GetEdgeKey(unsigned int a, unsigned int b)
+{
+	if (a > b)
+		std::swap(a, b);
+	return (static_cast<std::uint64_t>(a) << 32) | b;
+}
+static std::uint64_t HashEdgeKey(std::uint64_t key)
+{
+	return key * 0x9E3779B97F4A7C15ull;
+}
+static unsigned int GetEdgePartition(std::uint64_t key)
+{
+	return static_cast<unsigned int>(HashEdgeKey(key) >> (64 - edgePartitionBits));
+}
+
+void EdgeTopology::Build(const std::vector<std::array<unsigned int, 3>>& faces)
+{
+	int nf = static_cast<int>(faces.size());
+	std::size_t halfEdgeCount = 3 * faces.size();
+	int rangeCount = std::max(1, std::min(static_cast<int>(GetWorkerThreadCount()) * 4, (nf + edgeChunk - 1) / edgeChunk));
+	int rangeSize = (nf + rangeCount - 1) / std::max(rangeCount, 1);
+
+	// Pass 1: half-edges per (face range, partition). Ranges are contiguous and laid out in order within
+	// each partition, so the scatter below lists every partition's half-edges in face order.
+	std::vector<unsigned int> counts(static_cast<std::size_t>(rangeCount) * edgePartitionCount, 0);
+	ParallelFor(rangeCount, [&](int begin, int end)
+	{
+		for (int r = begin; r < end; r++)
+		{
+			unsigned int* rangeCounts = &counts[static_cast<std::size_t>(r) * edgePartitionCount];
+			for (int i = r * rangeSize; i < std::min(nf, (r + 1) * rangeSize); i++)
+			{
+				for (int j = 0; j < 3; j++)
+					rangeCounts[GetEdgePartition(GetEdgeKey(faces[i][j], faces[i][(j + 1) % 3]))]++;
+			}
+		}
+	}, 1);
+
+	// Partition major prefix sum; counts becomes the write cursor of each (range, partition)
+	std::vector<unsigned int> partitionOffsets(edgePartitionCount + 1);
+	unsigned int sum = 0;
+	for (unsigned int p = 0; p < edgePartitionCount; p++)
+	{
+		partitionOffsets[p] = sum;
+		for (int r = 0; r < rangeCount; r++)
+		{
+			unsigned int count = counts[static_cast<std::size_t>(r) * edgePartitionCount + p];
+			counts[static_cast<std::size_t>(r) * edgePartitionCount + p] = sum;
+			sum += count;
+		}
+	}
+	partitionOffsets[edgePartitionCount] = sum;
+
+	// Pass 2: scatter the half-edges into their partitions
+	std::vector<HalfEdge> halfEdges(halfEdgeCount);
+	ParallelFor(rangeCount, [&](int begin, int end)
+	{
+		for (int r = begin; r < end; r++)
+		{
+			unsigned int* cursors = &counts[static_cast<std::size_t>(r) * edgePartitionCount];
+			for (int i = r * rangeSize; i < std::min(nf, (r + 1) * rangeSize); i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					std::uint64_t key = GetEdgeKey(faces[i][j], faces[i][(j + 1) % 3]);
+					HalfEdge& halfEdge = halfEdges[cursors[GetEdgePartition(key)]++];
+					halfEdge.key = key;
+					halfEdge.corner = static_cast<unsigned int>(3 * i + j);
+				}
+			}
+		}
+	}, 1);
+
+	// Pass 3: each partition merges its half-edges into edges through an open addressing table.
+	// localEdges[h] is the partition local edge id of half-edge h.
+	std::vector<unsigned int> localEdges(halfEdgeCount);
+	std::vector<std::vector<MeshEdge>> partitionEdges(edgePartitionCount);
+	std::vector<unsigned int> partitionNonManifold(edgePartitionCount, 0);
+	ParallelFor(static_cast<int>(edgePartitionCount), [&](int begin, int end)
+	{
+		std::vector<unsigned int> table;
+		std::vector<bool> nonManifold;
+		for (int p = begin; p < end; p++)
+		{
+			unsigned int first = partitionOffsets[p], last = partitionOffsets[p + 1];
+			std::size_t tableSize = 16;
+			while (tableSize < 2 * static_cast<std::size_t>(last - first))
+				tableSize *= 2;
+			table.assign(tableSize, MeshEdge::invalidFace);
+
+			std::vector<MeshEdge>& output = partitionEdges[p];
+			nonManifold.clear();
+			for (unsigned int h = first; h < last; h++)
+			{
+				std::uint64_t key = halfEdges[h].key;
+				unsigned int face = halfEdges[h].corner / 3;
+				// The high hash bits chose the partition, so probe with the low ones
+				std::size_t slot = static_cast<std::size_t>(HashEdgeKey(key)) & (tableSize - 1);
+				for (;;)
+				{
+					unsigned int edge = table[slot];
+					if (edge == MeshEdge::invalidFace)
+					{
+						MeshEdge newEdge;
+						newEdge.vertices[0] = static_cast<unsigned int>(key >> 32);
+						newEdge.vertices[1] = static_cast<unsigned int>(key);
+						newEdge.faces[0] = face;
+						newEdge.faces[1] = MeshEdge::invalidFace;
+						table[slot] = static_cast<unsigned int>(output.size());
+						localEdges[h] = static_cast<unsigned int>(output.size());
+						output.push_back(newEdge);
+						nonManifold.push_back(false);
+						break;
+					}
+					MeshEdge& existing = output[edge];
+					if (GetEdgeKey(existing.vertices[0], existing.vertices[1]) == key)
+					{
+						// Half-edges arrive in face order, so the first two faces are the lowest.
+						// A degenerate face can list the same edge twice; it is still one face.
+						if (existing.faces[0] == face || existing.faces[1] == face)
+							;
+						else if (existing.faces[1] == MeshEdge::invalidFace)
+							existing.faces[1] = face;
+						else if (!nonManifold[edge])
+						{
+							nonManifold[edge] = true;
+							partitionNonManifold[p]++;
+						}
+						localEdges[h] = edge;
+						break;
+					}
+					slot = (slot + 1) & (tableSize - 1);
+				}
+			}
+		}
+	}, 1);
+
+	std::vector<unsigned int> edgeOffsets(edgePartitionCount + 1);
+	unsigned int edgeCount = 0;
+	nonManifoldEdgeCount = 0;
+	for (unsigned int p = 0; p < edgePartitionCount; p++)
+	{
+		edgeOffsets[p] = edgeCount;
+		edgeCount += static_cast<unsigned int>(partitionEdges[p].size());
+		nonManifoldEdgeCount += partitionNonManifold[p];
+	}
+	edgeOffsets[edgePartitionCount] = edgeCount;
+
+	// Pass 4: concatenate the partitions and record the edge of every corner
+	edges.resize(edgeCount);
+	faceEdges.resize(halfEdgeCount);
+	ParallelFor(static_cast<int>(edgePartitionCount), [&](int begin, int end)
+	{
+		for (int p = begin; p < end; p++)
+		{
+			std::copy(partitionEdges[p].begin(), partitionEdges[p].end(), edges.begin() + edgeOffsets[p]);
+			for (unsigned int h = partitionOffsets[p]; h < partitionOffsets[p + 1]; h++)
+				faceEdges[halfEdges[h].corner] = edgeOffsets[p] + localEdges[h];
+			std::vector<MeshEdge>().swap(partitionEdges[p]);
+		}
+	}, 1);
+
+	boundaryEdgeCount = 0;
+	for (const auto& edge : edges)
+	{
+		if (edge.IsBoundary())
+			boundaryEdgeCount++;
+	}
+}
+void EdgeTopology::BuildAdjacencyIndices(const std::vector<std::array<unsigned int, 3>>& faces,
+	std::vector<unsigned int>& indices) const
+{
+	int nf = static_cast<int>(faces.size());
+	indices.resize(6 * faces.size());
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const MeshEdge& edge = edges[faceEdges[3 * i + j]];
+				unsigned int neighbour = edge.faces[0] == static_cast<unsigned int>(i) ? edge.faces[1] : edge.faces[0];
+				// Own opposite vertex on a boundary
+				unsigned int opposite = faces[i][(j + 2) % 3];
+				if (neighbour != MeshEdge::invalidFace)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						unsigned int v = faces[neighbour][k];
+						if (v != edge.vertices[0] && v != edge.vertices[1])
+							opposite = v;
+					}
+				}
+				indices[6 * i + 2 * j] = faces[i][j];
+				indices[6 * i + 2 * j + 1] = opposite;
+			}
+		}
+	}, edgeChunk);
+}
+std::size_t EdgeTopology::GetMemoryUsage() const
+{
+	return edges.capacity() * sizeof(MeshEdge) + faceEdges.capacity() * sizeof(unsigned int);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Edge shared by one or two faces. vertices[0] < vertices[1]; faces[1] is invalidFace on a boundary.
+// An edge with more than two faces (non-manifold) keeps the two lowest face indices.
+struct MeshEdge
+{
+	static const unsigned int invalidFace = 0xFFFFFFFFu;
+
+	unsigned int vertices[2];
+	unsigned int faces[2];
+
+	bool IsBoundary() const { return faces[1] == invalidFace; }
+};
+
+// Unique edges of a triangle mesh with their face pairs, and the edge of every face corner.
+// Edge ids depend only on the faces, not on the thread count.
+class EdgeTopology
+{
+public:
+	EdgeTopology() = default;
+
+	// Half-edges are hashed into partitions by their vertex pair, then each partition is turned into edges
+	// with its own hash table; both steps run on the ParallelFor workers.
+	void Build(const std::vector<std::array<unsigned int, 3>>& faces);
+
+	const std::vector<MeshEdge>& GetEdges() const { return edges; }
+	// Edge between corners j and (j + 1) % 3 of face f
+	unsigned int GetFaceEdge(std::size_t f, int j) const { return faceEdges[3 * f + j]; }
+	std::size_t GetBoundaryEdgeCount() const { return boundaryEdgeCount; }
+	std::size_t GetNonManifoldEdgeCount() const { return nonManifoldEdgeCount; }
+
+	// Six indices per face for GL_TRIANGLES_ADJACENCY: v0, opposite of edge 0, v1, opposite of edge 1, v2,
+	// opposite of edge 2. On a boundary the face's own opposite vertex is used, so the "neighbour" is the
+	// face itself and never forms a silhouette with it.
+	void BuildAdjacencyIndices(const std::vector<std::array<unsigned int, 3>>& faces,
+		std::vector<unsigned int>& indices) const;
+
+	std::size_t GetMemoryUsage() const;
+private:
+	std::vector<MeshEdge> edges;
+	std::vector<unsigned int> faceEdges; // 3 per face
+	std::size_t boundaryEdgeCount = 0;
+	std::size_t nonManifoldEdgeCount = 0;
+};
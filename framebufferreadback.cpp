@@ -0,0 +1,121 @@
+#include "framebufferreadback.h"
+#include <cstring>
+#include <iostream>
+
+// Copy bottom-up rows (glReadPixels order) so that the image is top row first
+static void CopyRowsFlipped(unsigned char* destination, const unsigned char* source, int width, int height)
+{
+	std::size_t rowSize = static_cast<std::size_t>(width) * 3;
+	for (int y = 0; y < height; y++)
+		std::memcpy(destination + rowSize * y, source + rowSize * (height - 1 - y), rowSize);
+}
+
+FramebufferReadback::FramebufferReadback(ImageEncoderPool& encoder, int ringSize)
+	: encoder(encoder), slots(ringSize > 0 ? ringSize : 1), oldest(0), pendingCount(0)
+{
+	for (auto& slot : slots)
+	{
+		glGenBuffers(1, &slot.bufferID);
+		slot.bufferSize = 0;
+		slot.fence = nullptr;
+		slot.width = 0;
+		slot.height = 0;
+	}
+}
+FramebufferReadback::~FramebufferReadback()
+{
+	Finish();
+	for (auto& slot : slots)
+		glDeleteBuffers(1, &slot.bufferID);
+}
+void FramebufferReadback::Capture(const std::string& fileName, ImageFormat format)
+{
+	Capture([fileName, format](const unsigned char* pixels, int width, int height)
+	{
+		return WriteImageFile(fileName, format, width, height, 3, pixels);
+	});
+}
+void FramebufferReadback::Capture(PixelWriter writer)
+{
+	if (pendingCount == static_cast<int>(slots.size()))
+		CompleteOldest(true);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	Slot& slot = slots[(oldest + pendingCount) % slots.size()];
+	slot.width = viewport[2];
+	slot.height = viewport[3];
+	slot.writer = std::move(writer);
+
+	std::size_t size = static_cast<std::size_t>(slot.width) * slot.height * 3;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID);
+	if (slot.bufferSize != size)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		slot.bufferSize = size;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(viewport[0], viewport[1], slot.width, slot.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pendingCount++;
+}
+void FramebufferReadback::Update()
+{
+	while (pendingCount > 0 && CompleteOldest(false))
+		;
+}
+void FramebufferReadback::Finish()
+{
+	while (pendingCount > 0)
+		CompleteOldest(true);
+	encoder.Finish();
+}
+int FramebufferReadback::GetPendingCount() const
+{
+	return pendingCount;
+}
+bool FramebufferReadback::CompleteOldest(bool wait)
+{
+	Slot& slot = slots[oldest];
+	// The first wait flushes, so the fence is guaranteed to signal eventually
+	GLuint64 timeout = wait ? 1000000000ull : 0;
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (wait && status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(slot.fence, 0, timeout);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID);
+	const void* pixels = nullptr;
+	if (status != GL_WAIT_FAILED)
+		pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bufferSize, GL_MAP_READ_BIT);
+	// May wait for an encoder; the copy itself is the only work left on this thread
+	int buffer = encoder.AcquireBuffer(slot.bufferSize);
+	if (pixels)
+	{
+		CopyRowsFlipped(encoder.GetBufferData(buffer), static_cast<const unsigned char*>(pixels), slot.width,
+			slot.height);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+		std::cerr << "ERROR::READBACK::MAP_FAILED\n";
+	// The writer still runs after a failure, so ordered writers (video streams) never wait for a lost frame
+	PixelWriter writer = std::move(slot.writer);
+	int width = slot.width, height = slot.height;
+	bool mapped = pixels != nullptr;
+	encoder.Write(buffer, [writer, width, height, mapped](const unsigned char* data)
+	{
+		return writer(mapped ? data : nullptr, width, height);
+	});
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	oldest = (oldest + 1) % slots.size();
+	pendingCount--;
+	return true;
+}
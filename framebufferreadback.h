@@ -0,0 +1,51 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "imageencoder.h"
+
+// Asynchronous screenshots: glReadPixels goes into a ring of pixel pack buffers and a fence marks
+// when each copy is done. The pixels are mapped a few frames later, when the GPU has long finished,
+// and handed to an ImageEncoderPool, so neither the readback nor the encoding stalls the frame.
+class FramebufferReadback
+{
+public:
+	// ringSize is the number of captures that can be in flight on the GPU at once
+	FramebufferReadback(ImageEncoderPool& encoder, int ringSize = 3);
+	FramebufferReadback(const FramebufferReadback&) = delete;
+	FramebufferReadback& operator=(const FramebufferReadback&) = delete;
+	~FramebufferReadback(); // finishes the pending captures; GL thread
+
+	// Receives the RGB rows of a capture, top row first, on an encoder thread; pixels is nullptr if the
+	// readback failed. Returns false if nothing was written.
+	typedef std::function<bool(const unsigned char* pixels, int width, int height)> PixelWriter;
+
+	// Start copying the current viewport of the read framebuffer; returns without waiting for the GPU
+	// unless every buffer of the ring is still in flight, in which case the oldest capture is completed first
+	void Capture(const std::string& fileName, ImageFormat format = IMAGE_PNG);
+	void Capture(PixelWriter writer);
+	// Hand the captures whose copy has finished to the encoder; call once per frame. GL thread only.
+	void Update();
+	// Complete every capture and wait until the images are written. GL thread only.
+	void Finish();
+	int GetPendingCount() const;
+private:
+	struct Slot
+	{
+		GLuint bufferID;
+		std::size_t bufferSize;
+		GLsync fence;
+		int width;
+		int height;
+		PixelWriter writer;
+	};
+
+	ImageEncoderPool& encoder;
+	std::vector<Slot> slots;
+	int oldest; // index of the oldest capture in flight
+	int pendingCount;
+
+	// Map the oldest slot, copy it into an encoder buffer and submit it; wait blocks on its fence first
+	bool CompleteOldest(bool wait);
+};
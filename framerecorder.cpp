@@ -0,0 +1,89 @@
+#include "framerecorder.h"
+#include <cstdio>
+#include <iostream>
+#include "parallel.h"
+
+static unsigned int GetWriterThreadCount(const FrameRecorderOptions& options)
+{
+	return options.writerThreads > 0 ? options.writerThreads : GetWorkerThreadCount();
+}
+
+FrameRecorder::FrameRecorder(const FrameRecorderOptions& options)
+	: options(options), encoder(GetWriterThreadCount(options), GetWriterThreadCount(options) + 2), readback(encoder)
+{
+	const std::string& output = options.output;
+	videoOutput = (!output.empty() && output[0] == '|') ||
+		(output.size() > 4 && output.compare(output.size() - 4, 4, ".y4m") == 0);
+	videoOpened = false;
+	stopped = false;
+	frameCount = 0;
+	recordedCount = 0;
+	if (this->options.frameInterval < 1)
+		this->options.frameInterval = 1;
+}
+FrameRecorder::~FrameRecorder()
+{
+	Stop();
+}
+void FrameRecorder::Frame()
+{
+	if (stopped)
+		return;
+	if (frameCount++ % options.frameInterval != 0)
+	{
+		readback.Update();
+		return;
+	}
+
+	unsigned int index = recordedCount++;
+	if (videoOutput)
+	{
+		// The stream size is fixed by the first frame
+		if (!videoOpened)
+		{
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			if (!video.Open(options.output, viewport[2], viewport[3], options.framesPerSecond))
+			{
+				stopped = true;
+				return;
+			}
+			videoOpened = true;
+		}
+		Y4MWriter* stream = &video;
+		readback.Capture([stream, index](const unsigned char* pixels, int width, int height)
+		{
+			return stream->WriteFrame(index, pixels, width, height);
+		});
+	}
+	else
+	{
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), "_%06u.png", index);
+		readback.Capture(options.output + suffix);
+	}
+	readback.Update();
+}
+void FrameRecorder::Stop()
+{
+	if (stopped && !videoOpened)
+		return;
+
+	readback.Finish();
+	bool closed = video.Close();
+	videoOpened = false;
+	stopped = true;
+
+	double seconds = recordTimer.ElapsedMilliseconds() * 0.001;
+	std::cout << "Recorded " << encoder.GetWrittenCount() << " of " << recordedCount << " frames to " << options.output
+		<< " in " << seconds << " s (" << encoder.GetWrittenCount() / (seconds + 1e-9) << " frames/s)"
+		<< (closed ? "" : ", output incomplete") << '\n';
+}
+unsigned int FrameRecorder::GetRecordedCount() const
+{
+	return recordedCount;
+}
+unsigned int FrameRecorder::GetWrittenCount() const
+{
+	return encoder.GetWrittenCount();
+}
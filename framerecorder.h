@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include "framebufferreadback.h"
+#include "imageencoder.h"
+#include "timer.h"
+#include "y4mwriter.h"
+
+struct FrameRecorderOptions
+{
+	// "<prefix>" writes prefix_000000.png, prefix_000001.png, ...; "<file>.y4m" writes one Y4M video;
+	// "|<command>" streams Y4M into the command's standard input (e.g. "|ffmpeg -y -i - turntable.mp4")
+	std::string output;
+	int frameInterval = 1; // record every Nth frame
+	int framesPerSecond = 30; // frame rate in the Y4M header
+	unsigned int writerThreads = 0; // 0: GetWorkerThreadCount()
+};
+
+// Records the frames of a render loop. Readback goes through a FramebufferReadback and the writing through
+// an ImageEncoderPool, so the loop only blocks when the writers fall behind by more than the fixed number
+// of buffers; memory stays flat however long the recording is. Needs a current GL context.
+class FrameRecorder
+{
+public:
+	explicit FrameRecorder(const FrameRecorderOptions& options);
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator=(const FrameRecorder&) = delete;
+	~FrameRecorder(); // Stop
+
+	// Call once per rendered frame, after drawing and before the buffer swap. GL thread only.
+	void Frame();
+	// Write the frames that are still in flight and close the output. GL thread only.
+	void Stop();
+	unsigned int GetRecordedCount() const; // frames captured
+	unsigned int GetWrittenCount() const; // frames that reached the output
+private:
+	FrameRecorderOptions options;
+	ImageEncoderPool encoder;
+	FramebufferReadback readback;
+	Y4MWriter video;
+	bool videoOutput;
+	bool videoOpened;
+	bool stopped;
+	unsigned int frameCount; // frames seen, recorded or not
+	unsigned int recordedCount;
+	Timer recordTimer;
+};
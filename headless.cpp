@@ -0,0 +1,815 @@
+#include "headless.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "curvaturesimd.h"
+#include "framebufferreadback.h"
+#include "framerecorder.h"
+#include "imageencoder.h"
+#include "memorystats.h"
+#include "meshbatch.h"
+#include "meshcache.h"
+#include "meshoptimization.h"
+#include "model.h"
+#include "offscreentarget.h"
+#include "parallel.h"
+#include "programbinarycache.h"
+#include "renderer.h"
+#include "suggestivecontour.h"
+#include "textureloader.h"
+#include "timer.h"
+#include "vertexformat.h"
+
+#if defined(__linux__)
+#define HEADLESS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+HeadlessContext::HeadlessContext()
+{
+	eglDisplay = nullptr;
+	eglContext = nullptr;
+	hiddenWindow = nullptr;
+	backendName = "none";
+}
+HeadlessContext::~HeadlessContext()
+{
+	Shutdown();
+}
+bool HeadlessContext::Initialize()
+{
+	if (!InitializeEGL() && !InitializeHiddenWindow())
+	{
+		std::cerr << "ERROR::HEADLESS::NO_CONTEXT\n";
+		return false;
+	}
+
+	glewExperimental = true;
+	GLenum result = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW built for GLX complains about the missing X display even though the EGL context works
+	if (result == GLEW_ERROR_NO_GLX_DISPLAY)
+		result = GLEW_OK;
+#endif
+	if (result != GLEW_OK)
+	{
+		std::cerr << "Failed to initialize GLEW\n";
+		Shutdown();
+		return false;
+	}
+	// glewInit can leave a GL_INVALID_ENUM behind on core profiles
+	glGetError();
+
+	std::cout << "Headless context: " << backendName << ", " << glGetString(GL_RENDERER) << ", OpenGL "
+		<< glGetString(GL_VERSION) << '\n';
+	return true;
+}
+void HeadlessContext::Shutdown()
+{
+#ifdef HEADLESS_EGL
+	if (eglContext)
+	{
+		eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(eglDisplay, eglContext);
+	}
+	if (eglDisplay)
+		eglTerminate(eglDisplay);
+#endif
+	eglContext = nullptr;
+	eglDisplay = nullptr;
+
+	if (hiddenWindow)
+	{
+		glfwDestroyWindow(static_cast<GLFWwindow*>(hiddenWindow));
+		glfwTerminate();
+		hiddenWindow = nullptr;
+	}
+	backendName = "none";
+}
+const char* HeadlessContext::GetBackendName() const
+{
+	return backendName;
+}
+bool HeadlessContext::InitializeEGL()
+{
+#ifdef HEADLESS_EGL
+	EGLDisplay display = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+	eglDisplay = display;
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0 ||
+		!eglBindAPI(EGL_OPENGL_API))
+	{
+		Shutdown();
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		Shutdown();
+		return false;
+	}
+	eglContext = context;
+
+	// No surface at all (EGL_KHR_surfaceless_context); everything is drawn into the OffscreenTarget
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		Shutdown();
+		return false;
+	}
+	backendName = "EGL";
+	return true;
+#else
+	return false;
+#endif
+}
+bool HeadlessContext::InitializeHiddenWindow()
+{
+	if (!glfwInit())
+		return false;
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	GLFWwindow* window = glfwCreateWindow(1, 1, "Headless", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	hiddenWindow = window;
+	backendName = "hidden GLFW window";
+	return true;
+}
+
+enum FrameCapture
+{
+	CAPTURE_BLOCKING, // glReadPixels and the PNG encoder block every frame, like SaveScreenshot
+	CAPTURE_ASYNC, // FramebufferReadback into "<outputPrefix>_<frame>.png"
+	CAPTURE_RECORDER // FrameRecorder with options.record
+};
+
+// Render every frame into target and capture it; returns the number of frames that could not be written
+static int RenderFrames(Renderer& renderer, OffscreenTarget& target, const HeadlessOptions& options,
+	FrameCapture capture, double& milliseconds)
+{
+	Camera* camera = renderer.GetCamera();
+	glm::vec3 orbitCenter(0.0f, 0.0f, 0.0f);
+	float orbitRadius = glm::length(camera->position - orbitCenter);
+	float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+	ImageEncoderPool encoder(GetWorkerThreadCount(), GetWorkerThreadCount() + 1);
+	FramebufferReadback readback(encoder);
+	std::unique_ptr<FrameRecorder> recorder;
+	if (capture == CAPTURE_RECORDER)
+		recorder.reset(new FrameRecorder(options.record));
+	std::vector<unsigned char> pixels;
+	int failures = 0;
+
+	Timer timer;
+	for (int i = 0; i < options.frameCount; i++)
+	{
+		if (options.frameCount > 1)
+		{
+			float angle = 2.0f * 3.14159265f * i / options.frameCount;
+			glm::vec3 eye = orbitCenter + orbitRadius * glm::vec3(std::sin(angle), 0.0f, std::cos(angle));
+			camera->LookAt(eye, orbitCenter);
+		}
+
+		target.Bind();
+		glEnable(GL_DEPTH_TEST);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderer.Render(aspect);
+		if (recorder)
+		{
+			recorder->Frame();
+			continue;
+		}
+
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), "_%04d.png", i);
+		std::string fileName = options.outputPrefix + suffix;
+		if (capture == CAPTURE_ASYNC)
+		{
+			readback.Capture(fileName);
+			readback.Update();
+		}
+		else
+		{
+			target.ReadPixels(pixels);
+			if (!WritePixelsPNG(fileName, options.width, options.height, pixels))
+			{
+				std::cerr << "ERROR::HEADLESS::IMAGE_NOT_WRITTEN: " << fileName << '\n';
+				failures++;
+			}
+		}
+	}
+	readback.Finish();
+	if (recorder)
+	{
+		recorder->Stop();
+		failures += static_cast<int>(recorder->GetRecordedCount() - recorder->GetWrittenCount());
+	}
+	milliseconds = timer.ElapsedMilliseconds();
+	target.Unbind();
+
+	return failures + static_cast<int>(encoder.GetFailureCount());
+}
+
+// Render the orbit without capturing it, finishing every frame so the GPU work is counted too
+static double TimeFrames(Renderer& renderer, OffscreenTarget& target, const HeadlessOptions& options)
+{
+	Camera* camera = renderer.GetCamera();
+	glm::vec3 orbitCenter(0.0f, 0.0f, 0.0f);
+	float orbitRadius = glm::length(camera->position - orbitCenter);
+	float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+	int frameCount = options.frameCount > 0 ? options.frameCount : 1;
+
+	target.Bind();
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	Timer timer;
+	for (int i = 0; i < frameCount; i++)
+	{
+		float angle = 2.0f * 3.14159265f * i / frameCount;
+		camera->LookAt(orbitCenter + orbitRadius * glm::vec3(std::sin(angle), 0.0f, std::cos(angle)), orbitCenter);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		renderer.Render(aspect);
+		glFinish();
+	}
+	double milliseconds = timer.ElapsedMilliseconds();
+	target.Unbind();
+	return milliseconds / frameCount;
+}
+
+// Appended to a benchmark line when meshlet culling is on
+static void LogMeshletStatistics(Renderer& renderer)
+{
+	if (!IsMeshletCullingEnabled() || !renderer.GetModel())
+		return;
+	MeshletStatistics statistics = renderer.GetModel()->GetMeshletStatistics();
+	std::cout << ", meshlets kept " << statistics.trianglesKept << " of " << statistics.triangleCount << " triangles ("
+		<< statistics.backFacing << " back facing, " << statistics.frontFacing << " front facing of "
+		<< statistics.meshletCount << ")";
+}
+
+static void BenchmarkSuggestiveContours(Renderer& renderer, OffscreenTarget& target, const HeadlessOptions& options)
+{
+	SuggestiveContourMode mode = GetSuggestiveContourMode();
+	const SuggestiveContourMode modes[] = { SUGGESTIVE_CONTOURS_OFF, SUGGESTIVE_CONTOURS_CPU, SUGGESTIVE_CONTOURS_GPU };
+	double baseMilliseconds = 0.0;
+	for (auto benchmarkMode : modes)
+	{
+		SetSuggestiveContourMode(benchmarkMode);
+		HeadlessOptions warmUp = options;
+		warmUp.frameCount = 1;
+		TimeFrames(renderer, target, warmUp); // uploads and the first use of each program
+		double milliseconds = TimeFrames(renderer, target, options);
+		if (benchmarkMode == SUGGESTIVE_CONTOURS_OFF)
+		{
+			baseMilliseconds = milliseconds;
+			std::cout << "  no contours: " << milliseconds << " ms per frame\n";
+			continue;
+		}
+		std::cout << "  " << GetSuggestiveContourModeName(benchmarkMode) << " contours: " << milliseconds
+			<< " ms per frame (+" << milliseconds - baseMilliseconds << " ms)";
+		if (benchmarkMode == SUGGESTIVE_CONTOURS_CPU && renderer.GetModel())
+		{
+			SuggestiveContourStatistics statistics = renderer.GetModel()->GetSuggestiveContourStatistics();
+			std::cout << ", extraction " << statistics.milliseconds << " ms on " << GetWorkerThreadCount()
+				<< " threads, " << statistics.segments << " segments of " << statistics.zeroCrossings
+				<< " zero crossings in " << statistics.facesTested << " front faces";
+		}
+		LogMeshletStatistics(renderer);
+		std::cout << '\n';
+	}
+	SetSuggestiveContourMode(mode);
+}
+
+static void BenchmarkMeshBatching(Renderer& renderer, OffscreenTarget& target, const HeadlessOptions& options)
+{
+	bool enabled = IsMeshBatchingEnabled();
+	for (bool batched : { false, true })
+	{
+		SetMeshBatchingEnabled(batched);
+		HeadlessOptions warmUp = options;
+		warmUp.frameCount = 1;
+		TimeFrames(renderer, target, warmUp); // uploads, and the batch is built
+		double milliseconds = TimeFrames(renderer, target, options);
+		std::cout << "  " << (batched ? "batched" : "per mesh") << ": " << milliseconds << " ms per frame";
+		if (renderer.GetModel())
+		{
+			const DrawStatistics& statistics = renderer.GetModel()->GetDrawStatistics();
+			std::cout << ", " << statistics.drawCalls << " draw calls for " << statistics.meshes << " meshes, "
+				<< statistics.triangles << " triangles, " << statistics.milliseconds << " ms to submit";
+		}
+		if (renderer.GetModel() && IsFrustumCullingEnabled())
+		{
+			const CullStatistics& statistics = renderer.GetModel()->GetCullStatistics();
+			std::cout << ", culling " << statistics.milliseconds << " ms (" << statistics.visibleItems << " of "
+				<< statistics.itemCount << " parts visible, " << statistics.visibleNodes << " of "
+				<< statistics.testedNodes << " tested nodes)";
+		}
+		LogMeshletStatistics(renderer);
+		std::cout << '\n';
+	}
+	SetMeshBatchingEnabled(enabled);
+}
+
+static double TimeCurvature(Model& model, int runs)
+{
+	Timer timer;
+	for (int run = 0; run < runs; run++)
+		model.RecomputeCurvatures();
+	return timer.ElapsedMilliseconds() / runs;
+}
+
+// The principal curvatures, their directions and dcurv of every mesh, one vertex after the other
+static void GatherCurvatures(const Model& model, std::vector<float>& values)
+{
+	values.clear();
+	for (const auto& mesh : model.GetMeshes())
+	{
+		const MeshGeometry& geometry = mesh.GetGeometry();
+		for (std::size_t i = 0; i < geometry.GetVertexCount(); i++)
+		{
+			const float vertexValues[] = { geometry.curv1[i], geometry.curv2[i],
+				geometry.pdir1[i].x, geometry.pdir1[i].y, geometry.pdir1[i].z,
+				geometry.pdir2[i].x, geometry.pdir2[i].y, geometry.pdir2[i].z,
+				geometry.dcurv[i].x, geometry.dcurv[i].y, geometry.dcurv[i].z, geometry.dcurv[i].w };
+			values.insert(values.end(), std::begin(vertexValues), std::end(vertexValues));
+		}
+	}
+}
+
+static void BenchmarkCurvature(Renderer& renderer, const HeadlessOptions& options)
+{
+	Model* model = renderer.GetModel();
+	if (!model)
+		return;
+	std::size_t faceCount = 0;
+	for (const auto& mesh : model->GetMeshes())
+		faceCount += mesh.GetFaces().size();
+
+	int runs = options.frameCount > 0 ? options.frameCount : 1;
+	unsigned int maxThreads = GetWorkerThreadCount();
+	double singleThreadMilliseconds = 0.0;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		SetWorkerThreadCount(threads);
+		double milliseconds = TimeCurvature(*model, runs);
+		if (threads == 1)
+			singleThreadMilliseconds = milliseconds;
+		std::cout << "  " << threads << " threads, " << GetSimdLevelName(GetSimdLevel()) << ": " << milliseconds
+			<< " ms (" << static_cast<long long>(faceCount / (milliseconds * 0.001 + 1e-9)) << " faces/s, "
+			<< singleThreadMilliseconds / (milliseconds + 1e-9) << "x as fast as 1 thread)\n";
+	}
+
+	// Each SIMD level on every thread, against the results of the scalar code
+	SimdLevel simdLevel = GetSimdLevel();
+	const SimdLevel levels[] = { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 };
+	std::vector<float> scalarValues, values;
+	double scalarMilliseconds = 0.0;
+	for (auto level : levels)
+	{
+		SetSimdLevel(level);
+		if (GetSimdLevel() != level)
+		{
+			std::cout << "  " << GetSimdLevelName(level) << ": not supported by this CPU\n";
+			continue;
+		}
+		double milliseconds = TimeCurvature(*model, runs);
+		std::cout << "  " << maxThreads << " threads, " << GetSimdLevelName(level) << ": " << milliseconds << " ms ("
+			<< static_cast<long long>(faceCount / (milliseconds * 0.001 + 1e-9)) << " faces/s";
+		if (level == SIMD_SCALAR)
+		{
+			scalarMilliseconds = milliseconds;
+			GatherCurvatures(*model, scalarValues);
+			std::cout << ")\n";
+			continue;
+		}
+		GatherCurvatures(*model, values);
+		float largestDifference = 0.0f;
+		for (std::size_t i = 0; i < values.size() && i < scalarValues.size(); i++)
+			largestDifference = std::max(largestDifference, std::fabs(values[i] - scalarValues[i]));
+		std::cout << ", " << scalarMilliseconds / (milliseconds + 1e-9) << "x as fast as scalar, largest difference "
+			<< largestDifference << ")\n";
+	}
+	SetSimdLevel(simdLevel);
+	SetWorkerThreadCount(maxThreads);
+}
+
+static void LogFrameTimes(const char* readbackName, int frameCount, double milliseconds)
+{
+	int frames = frameCount > 0 ? frameCount : 1;
+	std::cout << "  " << readbackName << " readback: " << milliseconds / frames << " ms per frame ("
+		<< frames * 1000.0 / (milliseconds + 1e-9) << " frames/s)\n";
+}
+
+// Returns the number of loads that failed
+static int BenchmarkLoading(const HeadlessOptions& options)
+{
+	bool cacheEnabled = IsMeshCacheEnabled();
+	SetMeshCacheEnabled(true);
+	std::string cachePath = GetMeshCachePath(options.modelPath);
+	int runs = options.frameCount > 0 ? options.frameCount : 1;
+	int failures = 0;
+	std::cout << "Headless: loading " << options.modelPath << ' ' << runs << " times each way\n";
+
+	// Cold: no cache file, so each load imports, computes the curvature and writes the cache
+	double coldMilliseconds = 0.0, curvatureMilliseconds = 0.0;
+	for (int run = 0; run < runs; run++)
+	{
+		std::remove(cachePath.c_str());
+		Model model;
+		Timer timer;
+		if (!model.LoadGeometry(options.modelPath))
+			failures++;
+		coldMilliseconds += timer.ElapsedMilliseconds();
+		curvatureMilliseconds += model.GetCurvatureMilliseconds();
+	}
+	std::ifstream cacheFile(cachePath, std::ios::binary);
+	if (!cacheFile)
+	{
+		std::cerr << "ERROR::HEADLESS::NO_MESH_CACHE: " << cachePath << '\n';
+		SetMeshCacheEnabled(cacheEnabled);
+		return failures + 1;
+	}
+	cacheFile.close();
+
+	// Warm: read back through the memory mapping
+	double warmMilliseconds = 0.0;
+	for (int run = 0; run < runs; run++)
+	{
+		Model model;
+		Timer timer;
+		if (!model.LoadGeometry(options.modelPath))
+			failures++;
+		warmMilliseconds += timer.ElapsedMilliseconds();
+	}
+	SetMeshCacheEnabled(cacheEnabled);
+
+	coldMilliseconds /= runs;
+	curvatureMilliseconds /= runs;
+	warmMilliseconds /= runs;
+	std::cout << "  cold load: " << coldMilliseconds << " ms (curvature " << curvatureMilliseconds
+		<< " ms, import and cache write " << coldMilliseconds - curvatureMilliseconds << " ms)\n"
+		<< "  warm load: " << warmMilliseconds << " ms (" << coldMilliseconds / (warmMilliseconds + 1e-9)
+		<< "x as fast)\n";
+	return failures;
+}
+
+// The GPU figures are what Mesh::Upload would create for the streams (see GetVertexStreamFormat), so no upload is
+// needed; returns false if the model could not be loaded
+static bool MeasureMemory(const HeadlessOptions& options)
+{
+	// Cold, so the time covers the import and the curvature
+	bool cacheEnabled = IsMeshCacheEnabled();
+	SetMeshCacheEnabled(false);
+	std::size_t residentBefore = GetCurrentResidentSetSize();
+	Model model;
+	Timer loadTimer;
+	bool loaded = model.LoadGeometry(options.modelPath);
+	double loadMilliseconds = loadTimer.ElapsedMilliseconds();
+	std::size_t residentAfter = GetCurrentResidentSetSize();
+	SetMeshCacheEnabled(cacheEnabled);
+	if (!loaded)
+		return false;
+
+	std::size_t vertexCount = 0, faceCount = 0, indexCount = 0, geometryBytes = 0, topologyBytes = 0;
+	for (const auto& mesh : model.GetMeshes())
+	{
+		vertexCount += mesh.GetVertexCount();
+		faceCount += mesh.GetFaces().size();
+		indexCount += mesh.GetIndexCount();
+		geometryBytes += mesh.GetGeometry().GetMemoryUsage();
+		topologyBytes += mesh.GetFaces().size() * sizeof(std::array<unsigned int, 3>) +
+			mesh.GetIndices().size() * sizeof(unsigned int) + mesh.GetAdjacentFaces().GetMemoryUsage() +
+			mesh.GetCornerAreas().size() * sizeof(glm::vec3);
+	}
+	double vertices = static_cast<double>(std::max<std::size_t>(vertexCount, 1));
+	const double megabyte = 1024.0 * 1024.0;
+	std::cout << "Headless: " << options.modelPath << ", " << vertexCount << " vertices, " << faceCount << " faces, "
+		<< "loaded in " << loadMilliseconds << " ms (curvature " << model.GetCurvatureMilliseconds() << " ms), "
+		<< "resident " << (static_cast<double>(residentAfter) - static_cast<double>(residentBefore)) / megabyte
+		<< " MB more\n";
+	std::cout << "  CPU: geometry " << geometryBytes / vertices << " bytes per vertex, with faces, indices, "
+		<< "adjacency and corner areas " << (geometryBytes + topologyBytes) / vertices << "\n";
+	for (VertexFormat format : { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_COMPACT })
+	{
+		// The surface streams are the ones a shader like teapot.vshader reads; the others only the line passes
+		std::size_t surfaceStride = 0, stride = 0;
+		for (int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++)
+		{
+			VertexAttribute attribute = static_cast<VertexAttribute>(i);
+			std::size_t attributeStride = GetVertexStreamFormat(format, attribute).stride;
+			stride += attributeStride;
+			if (attribute == ATTRIBUTE_POSITION || attribute == ATTRIBUTE_NORMAL || attribute == ATTRIBUTE_TEXCOORDS)
+				surfaceStride += attributeStride;
+		}
+		std::cout << "  GPU " << GetVertexFormatName(format) << ": surface streams " << surfaceStride
+			<< " bytes per vertex, every stream " << stride << ", indices " << indexCount * sizeof(GLuint) / vertices
+			<< "\n";
+	}
+	return true;
+}
+
+int RunHeadless(const HeadlessOptions& options)
+{
+	HeadlessContext context;
+	if (!context.Initialize())
+		return 1;
+	if (options.compareLoading || options.measureMemory)
+	{
+		int failures = options.compareLoading ? BenchmarkLoading(options) : MeasureMemory(options) ? 0 : 1;
+		context.Shutdown();
+		return failures > 0 ? 1 : 0;
+	}
+
+	int failures = 0;
+	{
+		OffscreenTarget target;
+		if (!target.Create(options.width, options.height))
+			return 1;
+
+		// The meshes measure their feature size, and the renderer builds the shaders, only if contours are on
+		if (options.compareContours && GetSuggestiveContourMode() == SUGGESTIVE_CONTOURS_OFF)
+			SetSuggestiveContourMode(SUGGESTIVE_CONTOURS_CPU);
+		// Likewise the batch shader
+		if (options.compareBatching)
+			SetMeshBatchingEnabled(true);
+
+		Timer loadTimer;
+		Renderer renderer(options.modelPath);
+		// Every frame must show the final textures, not the placeholders
+		GetTextureLoader().Finish();
+		double loadMilliseconds = loadTimer.ElapsedMilliseconds();
+		std::cout << "Headless: " << options.frameCount << " frames of " << options.width << "x" << options.height
+			<< ", load " << loadMilliseconds << " ms\n";
+
+		double syncMilliseconds = 0.0, asyncMilliseconds = 0.0, recordMilliseconds = 0.0;
+		if (options.compareContours)
+			BenchmarkSuggestiveContours(renderer, target, options);
+		else if (options.compareBatching)
+			BenchmarkMeshBatching(renderer, target, options);
+		else if (options.compareCurvature)
+			BenchmarkCurvature(renderer, options);
+		else
+		{
+			if (!options.record.output.empty())
+			{
+				failures += RenderFrames(renderer, target, options, CAPTURE_RECORDER, recordMilliseconds);
+				LogFrameTimes("recorder", options.frameCount, recordMilliseconds);
+			}
+			else if (options.compareReadback || !options.asyncReadback)
+			{
+				failures += RenderFrames(renderer, target, options, CAPTURE_BLOCKING, syncMilliseconds);
+				LogFrameTimes("blocking", options.frameCount, syncMilliseconds);
+			}
+			if (options.record.output.empty() && (options.compareReadback || options.asyncReadback))
+			{
+				failures += RenderFrames(renderer, target, options, CAPTURE_ASYNC, asyncMilliseconds);
+				LogFrameTimes("asynchronous", options.frameCount, asyncMilliseconds);
+			}
+			if (options.record.output.empty() && options.compareReadback)
+				std::cout << "  asynchronous readback is " << syncMilliseconds / (asyncMilliseconds + 1e-9)
+					<< "x as fast\n";
+		}
+	}
+	context.Shutdown();
+	return failures > 0 ? 1 : 0;
+}
+
+// Curvature of teapot/teapot.obj welded with the default MeshOptimizationOptions, at vertices at least four rings
+// away from any mesh boundary, so neither Assimp's vertex order nor its split of the groups into meshes changes it.
+// The signs of dcurv follow the orientation of pdir1 and pdir2, which the face order decides, so only its
+// magnitudes are stored.
+struct CurvatureProbe
+{
+	glm::vec3 position;
+	float curv1, curv2;
+	glm::vec4 dcurv;
+};
+static const CurvatureProbe curvatureProbes[] = {
+	{ glm::vec3(-1.44532f, 0.084525f, 0.0f), 4.4836f, 0.2929088f, glm::vec4(89.42131f, 0.6815498f, 3.122311f, -0.06900918f) },
+	{ glm::vec3(-0.844439f, 0.4632f, -1.62307f), 0.8768717f, 0.4160389f, glm::vec4(2.048695f, 0.09476665f, 0.1855507f, -0.00238373f) },
+	{ glm::vec3(0.0f, 2.5728f, -0.6736f), 0.2003328f, -0.1004502f, glm::vec4(-0.01220283f, 0.4221405f, -0.01566395f, -1.122204f) },
+	{ glm::vec3(-0.1674f, 2.74905f, 0.0f), -10.24999f, 4.600549f, glm::vec4(1.345221f, -1.702898f, -14.66023f, 0.8126351f) },
+	{ glm::vec3(-0.216f, 1.8f, 2.8944f), 7.108116f, 0.9373981f, glm::vec4(21.49992f, -0.160129f, -10.49365f, -5.05796f) },
+	{ glm::vec3(0.0f, 2.42582f, -3.35863f), 3.532622f, 0.2623687f, glm::vec4(23.07259f, 9.259118f, 8.062975f, 41.61624f) },
+};
+// Largest difference allowed, relative to the largest magnitude of the same quantity at the vertex. The per face
+// terms are summed in an order that changes with the face order, the thread count and the SIMD level, which moves
+// the results by about 1e-5.
+static const float curvatureTolerance = 1e-3f;
+static const float probePositionTolerance = 1e-4f;
+
+static bool IsWithinTolerance(float value, float expected, float scale)
+{
+	return std::fabs(value - expected) <= curvatureTolerance * scale;
+}
+// dcurv is the curvature derivative in the frame (pdir1, pdir2): C111, C112, C122, C222. Reversing pdir1 negates
+// C111 and C122, and reversing pdir2 negates C112 and C222. Which way each direction points depends on the order
+// the faces are visited in, so the signs must match for one of the four orientations of the frame.
+static bool IsDerivativeWithinTolerance(const glm::vec4& value, const glm::vec4& expected)
+{
+	float scale = std::max(std::max(std::fabs(expected.x), std::fabs(expected.y)),
+		std::max(std::fabs(expected.z), std::fabs(expected.w)));
+	for (int orientation = 0; orientation < 4; orientation++)
+	{
+		float sign1 = (orientation & 1) ? -1.0f : 1.0f;
+		float sign2 = (orientation & 2) ? -1.0f : 1.0f;
+		glm::vec4 oriented = value * glm::vec4(sign1, sign2, sign1, sign2);
+		bool passed = true;
+		for (int k = 0; k < 4; k++)
+			passed = passed && IsWithinTolerance(oriented[k], expected[k], scale);
+		if (passed)
+			return true;
+	}
+	return false;
+}
+
+// Stands in for the driver: a program's binary is the ID of the driver that built it, and only that driver
+// accepts it back
+class FakeProgramBinaryBackend : public ProgramBinaryBackend
+{
+public:
+	std::string driverID = "Fake vendor\nFake renderer\n1.0\n";
+	int programBinaryCalls = 0;
+
+	bool IsSupported() override { return true; }
+	std::string GetDriverID() override { return driverID; }
+	bool GetProgramBinary(GLuint, GLenum& format, std::vector<char>& binary) override
+	{
+		format = fakeBinaryFormat;
+		binary.assign(driverID.begin(), driverID.end());
+		return true;
+	}
+	bool ProgramBinary(GLuint, GLenum format, const std::vector<char>& binary) override
+	{
+		programBinaryCalls++;
+		return format == fakeBinaryFormat && std::string(binary.begin(), binary.end()) == driverID;
+	}
+private:
+	static const GLenum fakeBinaryFormat = 0x1234;
+};
+
+// ProgramBinaryCache against the fake driver: a miss, a hit, a driver change and a damaged file. Uses (and removes)
+// the directory "selftest_shadercache". Returns the number of checks that failed.
+static int CheckProgramBinaryCache()
+{
+	const std::string directory = "selftest_shadercache";
+	FakeProgramBinaryBackend backend;
+	ProgramBinaryCache cache(directory, backend);
+	const std::vector<std::string> sources = { "vertex source", "fragment source", "" };
+	std::string key = cache.ComputeKey(sources);
+	std::string path = directory + '/' + key + ".bin";
+	std::remove(path.c_str());
+
+	int failures = 0;
+	auto check = [&failures](const char* name, bool passed)
+	{
+		std::cout << "Self test: program binary cache " << name << ' ' << (passed ? "ok" : "FAILED") << '\n';
+		if (!passed)
+			failures++;
+	};
+	check("miss", !cache.Load(key, 1) && backend.programBinaryCalls == 0);
+	check("store", cache.Store(key, 1));
+	check("hit", cache.Load(key, 2) && backend.programBinaryCalls == 1);
+
+	// The key covers the driver, and a binary the driver no longer takes under the old key is not used either
+	std::string driverID = backend.driverID;
+	backend.driverID = "Fake vendor\nFake renderer\n2.0\n";
+	std::string updatedKey = cache.ComputeKey(sources);
+	check("driver change", updatedKey != key && !cache.Load(updatedKey, 3) && !cache.Load(key, 3) &&
+		backend.programBinaryCalls == 2);
+	backend.driverID = driverID;
+
+	// A damaged file is caught by its checksum before the driver sees it
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekg(-1, std::ios::end);
+		char last = 0;
+		file.get(last);
+		file.seekp(-1, std::ios::end);
+		file.put(static_cast<char>(last ^ 0x5A));
+	}
+	check("corrupt file", !cache.Load(key, 4) && backend.programBinaryCalls == 2);
+
+	std::remove(path.c_str());
+#ifdef _WIN32
+	_rmdir(directory.c_str());
+#else
+	rmdir(directory.c_str());
+#endif
+	return failures;
+}
+
+int RunSelfTest()
+{
+	// Loading makes no GL calls and nothing is uploaded, so no context is needed
+	SetMeshCacheEnabled(false);
+	SetReleaseCpuMeshData(false);
+	MeshOptimizationOptions optimizationOptions;
+	optimizationOptions.enabled = true;
+	SetMeshOptimizationOptions(optimizationOptions);
+	SetLevelOfDetailOptions(LevelOfDetailOptions());
+
+	int failures = 0;
+	{
+		Model model;
+		if (!model.LoadGeometry("teapot/teapot.obj"))
+			return 1;
+
+		for (const auto& probe : curvatureProbes)
+		{
+			const MeshGeometry* geometry = nullptr;
+			std::size_t vertex = 0;
+			float nearest = probePositionTolerance;
+			for (const auto& mesh : model.GetMeshes())
+			{
+				const MeshGeometry& meshGeometry = mesh.GetGeometry();
+				for (std::size_t i = 0; i < meshGeometry.GetVertexCount(); i++)
+				{
+					float distance = glm::length(meshGeometry.positions[i] - probe.position);
+					if (distance <= nearest)
+					{
+						nearest = distance;
+						geometry = &meshGeometry;
+						vertex = i;
+					}
+				}
+			}
+			if (!geometry)
+			{
+				std::cerr << "ERROR::SELFTEST::NO_VERTEX_AT " << probe.position.x << ' ' << probe.position.y << ' '
+					<< probe.position.z << '\n';
+				failures++;
+				continue;
+			}
+
+			float curv1 = geometry->curv1[vertex], curv2 = geometry->curv2[vertex];
+			glm::vec4 dcurv = geometry->dcurv[vertex];
+			float curvatureScale = std::max(std::fabs(probe.curv1), std::fabs(probe.curv2));
+			bool passed = IsWithinTolerance(curv1, probe.curv1, curvatureScale) &&
+				IsWithinTolerance(curv2, probe.curv2, curvatureScale) && IsDerivativeWithinTolerance(dcurv, probe.dcurv);
+
+			std::cout << "Self test: vertex at (" << probe.position.x << ", " << probe.position.y << ", "
+				<< probe.position.z << "): curv " << curv1 << ", " << curv2 << " (expected " << probe.curv1 << ", "
+				<< probe.curv2 << "), dcurv " << dcurv.x << ", " << dcurv.y << ", " << dcurv.z << ", " << dcurv.w
+				<< " (expected " << probe.dcurv.x << ", " << probe.dcurv.y << ", " << probe.dcurv.z << ", "
+				<< probe.dcurv.w << ") " << (passed ? "ok" : "FAILED") << '\n';
+			if (!passed)
+				failures++;
+		}
+	}
+	int probeCount = static_cast<int>(sizeof(curvatureProbes) / sizeof(curvatureProbes[0]));
+	std::cout << "Self test: " << probeCount - failures << " of " << probeCount << " vertices within tolerance ("
+		<< GetWorkerThreadCount() << " threads, " << GetSimdLevelName(GetSimdLevel()) << ")\n";
+
+	failures += CheckProgramBinaryCache();
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include "framerecorder.h"
+
+// OpenGL 3.3 core context without a visible window. On Linux it uses EGL (surfaceless Mesa platform,
+// so llvmpipe works on servers without a display or GPU); elsewhere, or if EGL fails, a hidden GLFW window.
+// Rendering goes to an OffscreenTarget, never to a default framebuffer.
+class HeadlessContext
+{
+public:
+	HeadlessContext();
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+	~HeadlessContext();
+
+	bool Initialize(); // creates the context, makes it current and initializes GLEW
+	void Shutdown();
+	const char* GetBackendName() const;
+private:
+	void* eglDisplay;
+	void* eglContext;
+	void* hiddenWindow; // GLFWwindow
+	const char* backendName;
+
+	bool InitializeEGL();
+	bool InitializeHiddenWindow();
+};
+
+struct HeadlessOptions
+{
+	std::string modelPath = "teapot/teapot.obj";
+	std::string outputPrefix = "frame"; // images are written as <outputPrefix>_0000.png, ...
+	int width = 800;
+	int height = 600;
+	int frameCount = 1; // more than one frame orbits the camera around the model, one view per frame
+	bool asyncReadback = true; // pixel buffer readback and background encoding instead of blocking per frame
+	bool compareReadback = false; // render the frames twice, with blocking and with asynchronous readback
+	// Instead of writing images, time the frames without suggestive contours and with each SuggestiveContourMode
+	bool compareContours = false;
+	// Instead of writing images, time the frames with one draw call per mesh and with the meshes batched
+	bool compareBatching = false;
+	// Instead of writing images, time the curvature of the model's meshes on 1 to GetWorkerThreadCount() threads,
+	// then with each SimdLevel (compared with the scalar results), frameCount times each
+	bool compareCurvature = false;
+	// Instead of rendering, time Model::LoadGeometry cold (import, curvature and writing the mesh cache) and warm
+	// (from the mesh cache), frameCount times each
+	bool compareLoading = false;
+	// Instead of rendering, load the model once without the mesh cache and report its bytes per vertex on the CPU
+	// and, for each VertexFormat, on the GPU, and the load time
+	bool measureMemory = false;
+	FrameRecorderOptions record; // when record.output is set, the frames go to a FrameRecorder instead
+};
+
+// Render options.frameCount frames of a model to image files and report the timings; returns the process exit code
+int RunHeadless(const HeadlessOptions& options);
+// Import teapot/teapot.obj without the mesh cache, welded, and compare its curvature at a few fixed vertices with
+// stored values (with the current worker thread count and SIMD level), then check ProgramBinaryCache against a fake
+// backend. Needs no GL context. Returns the process exit code.
+int RunSelfTest();
@@ -0,0 +1,93 @@
+#include "imageencoder.h"
+#include <iostream>
+#include <stb_image_write.h>
+
+bool WriteImageFile(const std::string& fileName, ImageFormat format, int width, int height, int components,
+	const unsigned char* data)
+{
+	bool written = false;
+	if (data && format == IMAGE_BMP)
+		written = stbi_write_bmp(fileName.c_str(), width, height, components, data) != 0;
+	else if (data)
+		written = stbi_write_png(fileName.c_str(), width, height, components, data, width * components) != 0;
+	if (!written)
+		std::cerr << "ERROR::IMAGE::NOT_WRITTEN: " << fileName << '\n';
+	return written;
+}
+
+ImageEncoderPool::ImageEncoderPool(unsigned int threadCount, unsigned int bufferCount)
+	: buffers(bufferCount > 0 ? bufferCount : 1), encodingCount(0), writtenCount(0), failureCount(0),
+	pool(threadCount)
+{
+	for (int i = static_cast<int>(buffers.size()) - 1; i >= 0; i--)
+		freeBuffers.push_back(i);
+}
+ImageEncoderPool::~ImageEncoderPool()
+{
+	Finish();
+}
+int ImageEncoderPool::AcquireBuffer(std::size_t size)
+{
+	int buffer;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		bufferReleased.wait(lock, [this]() { return !freeBuffers.empty(); });
+		buffer = freeBuffers.back();
+		freeBuffers.pop_back();
+	}
+	// Only grows, so after the first few frames no capture allocates
+	if (buffers[buffer].size() < size)
+		buffers[buffer].resize(size);
+	return buffer;
+}
+unsigned char* ImageEncoderPool::GetBufferData(int buffer)
+{
+	return buffers[buffer].data();
+}
+void ImageEncoderPool::Encode(int buffer, const std::string& fileName, ImageFormat format, int width, int height,
+	int components)
+{
+	Write(buffer, [fileName, format, width, height, components](const unsigned char* data)
+	{
+		return WriteImageFile(fileName, format, width, height, components, data);
+	});
+}
+void ImageEncoderPool::Write(int buffer, std::function<bool(const unsigned char*)> write)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		encodingCount++;
+	}
+	pool.Submit([this, buffer, write]()
+	{
+		ReleaseBuffer(buffer, write(buffers[buffer].data()));
+	});
+}
+void ImageEncoderPool::Finish()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bufferReleased.wait(lock, [this]() { return encodingCount == 0; });
+}
+unsigned int ImageEncoderPool::GetWrittenCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return writtenCount;
+}
+unsigned int ImageEncoderPool::GetFailureCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failureCount;
+}
+void ImageEncoderPool::ReleaseBuffer(int buffer, bool written)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		freeBuffers.push_back(buffer);
+		encodingCount--;
+		if (written)
+			writtenCount++;
+		else
+			failureCount++;
+	}
+	bufferReleased.notify_all();
+}
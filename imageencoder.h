@@ -0,0 +1,54 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+
+enum ImageFormat
+{
+	IMAGE_PNG,
+	IMAGE_BMP
+};
+
+// Tightly packed rows, top row first; prints an error and returns false if the file could not be written
+bool WriteImageFile(const std::string& fileName, ImageFormat format, int width, int height, int components,
+	const unsigned char* data);
+
+// Compresses and writes images (or runs other per frame writers) on background threads. The pixel buffers are allocated once and reused;
+// when every buffer is still being encoded, AcquireBuffer blocks, which bounds the memory in flight.
+// stb_image_write's flip flag is process wide and not thread safe, so images must be handed over
+// top row first (callers flip while copying) and nothing may set the flag.
+class ImageEncoderPool
+{
+public:
+	ImageEncoderPool(unsigned int threadCount, unsigned int bufferCount);
+	ImageEncoderPool(const ImageEncoderPool&) = delete;
+	ImageEncoderPool& operator=(const ImageEncoderPool&) = delete;
+	~ImageEncoderPool(); // waits for the images that are still queued
+
+	// Returns a free buffer with at least size bytes, waiting for an encoder to finish if necessary
+	int AcquireBuffer(std::size_t size);
+	unsigned char* GetBufferData(int buffer);
+	// Write the buffer's tightly packed rows in the background, then give the buffer back to the pool
+	void Encode(int buffer, const std::string& fileName, ImageFormat format, int width, int height, int components);
+	// Run write(buffer data) in the background, then give the buffer back; write returns false on failure
+	void Write(int buffer, std::function<bool(const unsigned char*)> write);
+	// Wait until every image handed to Encode has been written
+	void Finish();
+
+	unsigned int GetWrittenCount() const;
+	unsigned int GetFailureCount() const;
+private:
+	std::vector<std::vector<unsigned char>> buffers;
+	std::vector<int> freeBuffers;
+	unsigned int encodingCount;
+	unsigned int writtenCount;
+	unsigned int failureCount;
+	mutable std::mutex mutex;
+	std::condition_variable bufferReleased;
+	ThreadPool pool; // last, so its workers are joined before the buffers go away
+
+	void ReleaseBuffer(int buffer, bool written);
+};
@@ -1,10 +1,183 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "apparentridges.h"
+#include "batchrenderer.h"
+#include "bvh.h"
+#include "curvaturesimd.h"
+#include "headless.h"
+#include "mesh.h"
+#include "meshbatch.h"
+#include "meshcache.h"
+#include "meshlet.h"
+#include "meshoptimization.h"
+#include "meshsimplification.h"
+#include "parallel.h"
+#include "programbinarycache.h"
+#include "silhouette.h"
+#include "suggestivecontour.h"
+#include "vertexformat.h"
 #include "window.h"
 
-int main()
+int main(int argc, char** argv)
 {
+	// -threads N: number of worker threads for mesh processing (default: all hardware threads)
+	// -simd N: 0 = scalar, 1 = SSE, 2 = AVX2 curvature kernels (default: best supported)
+	// -noshadercache: always compile and link shaders from source
+	// -releasecpu: free the CPU copy of each mesh once it is on the GPU
+	// -silhouettes: find the silhouette and boundary edges on the CPU each frame and draw them as lines
+	// -contours cpu|gpu: draw suggestive contours extracted on the CPU or in a geometry shader, with
+	//   -contourthreshold T, -contourfade F (see SuggestiveContourOptions)
+	// -ridges: compute the view dependent curvature each frame and draw apparent ridges, with
+	//   -ridgethreshold T, -ridgefade F, -ridgetolerance RADIANS (see ApparentRidgeOptions)
+	// -batchdraw: pack each model's meshes into shared buffers and draw them with multi-draw indirect (see MeshBatch)
+	// -cull: skip the mesh parts outside the view frustum, found each frame through a BVH (see Model::Cull)
+	// -meshlets: split the meshes into meshlets and skip the back facing ones in the surface, suggestive contour
+	//   and apparent ridge passes (see MeshletSet)
+	// -optimize: weld the imported vertices and reorder faces and vertices for the vertex cache, with
+	//   -weldtolerance T (relative to the model size), -keeptextureseams (see MeshOptimizationOptions)
+	// -compactvertices: upload quantized vertex streams that the shaders decode (see VertexFormat)
+	// -lod: simplify each mesh into coarser levels and draw each at the coarsest level that looks the same, with
+	//   -lodlevels N, -lodpixelerror P, -lodcurvatureweight W (see LevelOfDetailOptions)
+	// -nocache: always import with Assimp and recompute curvature (neither read nor write the mesh cache)
+	// -headless: render without a window into image files and exit, with
+	//   -model PATH, -frames N (views orbiting the model), -size WxH, -output PREFIX (PREFIX_0000.png, ...),
+	//   -syncreadback (read back and encode each frame before the next), -readbackbench (time both ways),
+	//   -contourbench (time the frames without suggestive contours and with each mode instead of writing images),
+	//   -drawbench (time the frames with a draw call per mesh and batched instead of writing images),
+	//   -curvaturebench (time the curvature on 1 to -threads threads and with each -simd level, -frames times each,
+	//   instead of writing images), -loadbench (time loading the model without and with the mesh cache instead
+	//   of rendering), -memorybench (load the model once without the mesh cache and report its bytes per vertex
+	//   and load time instead of rendering)
+	// -selftest: import teapot/teapot.obj without the mesh cache, compare its curvature at a few vertices with stored
+	//   values, check the program binary cache against a fake driver and exit (see RunSelfTest); honours -threads
+	//   and -simd
+	// -batch MANIFEST: render every view listed in the manifest (see batchrenderer.h) and exit, with
+	//   -size WxH, -loaders N (model loading threads), -queue N (models loaded ahead)
+	// -record OUTPUT: record the frames (window or headless) as OUTPUT_000000.png, ..., into OUTPUT if it ends
+	//   in .y4m, or as Y4M into a command if OUTPUT is "|command"; with -recordevery N, -fps N
+	bool headless = false;
+	bool selfTest = false;
+	HeadlessOptions headlessOptions;
+	BatchOptions batchOptions;
+	SuggestiveContourOptions contourOptions;
+	ApparentRidgeOptions ridgeOptions;
+	MeshOptimizationOptions optimizationOptions;
+	LevelOfDetailOptions levelOfDetailOptions;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			SetWorkerThreadCount(static_cast<unsigned int>(std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "-simd") == 0 && i + 1 < argc)
+			SetSimdLevel(static_cast<SimdLevel>(std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "-nocache") == 0)
+			SetMeshCacheEnabled(false);
+		else if (std::strcmp(argv[i], "-noshadercache") == 0)
+			SetProgramBinaryCacheEnabled(false);
+		else if (std::strcmp(argv[i], "-releasecpu") == 0)
+			SetReleaseCpuMeshData(true);
+		else if (std::strcmp(argv[i], "-silhouettes") == 0)
+			SetSilhouetteExtractionEnabled(true);
+		else if (std::strcmp(argv[i], "-contours") == 0 && i + 1 < argc)
+		{
+			++i;
+			SetSuggestiveContourMode(std::strcmp(argv[i], "gpu") == 0 ? SUGGESTIVE_CONTOURS_GPU :
+				(std::strcmp(argv[i], "cpu") == 0 ? SUGGESTIVE_CONTOURS_CPU : SUGGESTIVE_CONTOURS_OFF));
+		}
+		else if (std::strcmp(argv[i], "-contourthreshold") == 0 && i + 1 < argc)
+			contourOptions.threshold = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-contourfade") == 0 && i + 1 < argc)
+			contourOptions.fade = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-ridges") == 0)
+			SetApparentRidgesEnabled(true);
+		else if (std::strcmp(argv[i], "-ridgethreshold") == 0 && i + 1 < argc)
+			ridgeOptions.threshold = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-ridgefade") == 0 && i + 1 < argc)
+			ridgeOptions.fade = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-ridgetolerance") == 0 && i + 1 < argc)
+			ridgeOptions.viewTolerance = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-batchdraw") == 0)
+			SetMeshBatchingEnabled(true);
+		else if (std::strcmp(argv[i], "-cull") == 0)
+			SetFrustumCullingEnabled(true);
+		else if (std::strcmp(argv[i], "-meshlets") == 0)
+			SetMeshletCullingEnabled(true);
+		else if (std::strcmp(argv[i], "-optimize") == 0)
+			optimizationOptions.enabled = true;
+		else if (std::strcmp(argv[i], "-weldtolerance") == 0 && i + 1 < argc)
+			optimizationOptions.weldTolerance = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-keeptextureseams") == 0)
+			optimizationOptions.keepTextureSeams = true;
+		else if (std::strcmp(argv[i], "-compactvertices") == 0)
+			SetVertexFormat(VERTEX_FORMAT_COMPACT);
+		else if (std::strcmp(argv[i], "-lod") == 0)
+			levelOfDetailOptions.enabled = true;
+		else if (std::strcmp(argv[i], "-lodlevels") == 0 && i + 1 < argc)
+			levelOfDetailOptions.levelCount = static_cast<unsigned int>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "-lodpixelerror") == 0 && i + 1 < argc)
+			levelOfDetailOptions.pixelError = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-lodcurvatureweight") == 0 && i + 1 < argc)
+			levelOfDetailOptions.curvatureWeight = static_cast<float>(std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "-selftest") == 0)
+			selfTest = true;
+		else if (std::strcmp(argv[i], "-headless") == 0)
+			headless = true;
+		else if (std::strcmp(argv[i], "-model") == 0 && i + 1 < argc)
+			headlessOptions.modelPath = argv[++i];
+		else if (std::strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			headlessOptions.frameCount = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+			std::sscanf(argv[++i], "%dx%d", &headlessOptions.width, &headlessOptions.height);
+		else if (std::strcmp(argv[i], "-output") == 0 && i + 1 < argc)
+			headlessOptions.outputPrefix = argv[++i];
+		else if (std::strcmp(argv[i], "-syncreadback") == 0)
+			headlessOptions.asyncReadback = false;
+		else if (std::strcmp(argv[i], "-readbackbench") == 0)
+			headlessOptions.compareReadback = true;
+		else if (std::strcmp(argv[i], "-contourbench") == 0)
+			headlessOptions.compareContours = true;
+		else if (std::strcmp(argv[i], "-drawbench") == 0)
+			headlessOptions.compareBatching = true;
+		else if (std::strcmp(argv[i], "-curvaturebench") == 0)
+			headlessOptions.compareCurvature = true;
+		else if (std::strcmp(argv[i], "-loadbench") == 0)
+			headlessOptions.compareLoading = true;
+		else if (std::strcmp(argv[i], "-memorybench") == 0)
+			headlessOptions.measureMemory = true;
+		else if (std::strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+			headlessOptions.record.output = argv[++i];
+		else if (std::strcmp(argv[i], "-recordevery") == 0 && i + 1 < argc)
+			headlessOptions.record.frameInterval = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-fps") == 0 && i + 1 < argc)
+			headlessOptions.record.framesPerSecond = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-batch") == 0 && i + 1 < argc)
+			batchOptions.manifestPath = argv[++i];
+		else if (std::strcmp(argv[i], "-loaders") == 0 && i + 1 < argc)
+			batchOptions.loaderThreads = static_cast<unsigned int>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "-queue") == 0 && i + 1 < argc)
+			batchOptions.queueDepth = static_cast<unsigned int>(std::atoi(argv[++i]));
+	}
+	SetSuggestiveContourOptions(contourOptions);
+	SetApparentRidgeOptions(ridgeOptions);
+	SetMeshOptimizationOptions(optimizationOptions);
+	SetLevelOfDetailOptions(levelOfDetailOptions);
+
+	if (selfTest)
+		return RunSelfTest();
+	if (!batchOptions.manifestPath.empty())
+	{
+		batchOptions.width = headlessOptions.width;
+		batchOptions.height = headlessOptions.height;
+		return RunBatch(batchOptions);
+	}
+	if (headless)
+		return RunHeadless(headlessOptions);
+
 	Window* window = new Window(800, 600, "Outline Drawing");
 	window->Initialize();
+	if (!headlessOptions.record.output.empty())
+		window->StartRecording(headlessOptions.record);
 	window->Run();
 	window->Shutdown();
 	delete window;
-}
\ No newline at end of file
+}
@@ -0,0 +1,115 @@
+#include "materialpool.h"
+#include <algorithm>
+#include <iostream>
+#include "mesh.h"
+
+unsigned int MaterialPool::Add(const Material& material, unsigned int* generation)
+{
+	std::array<float, 9> key = { material.ka.x, material.ka.y, material.ka.z, material.kd.x, material.kd.y,
+		material.kd.z, material.ks.x, material.ks.y, material.ks.z };
+
+	std::lock_guard<std::mutex> lock(mutex);
+	requestCount++;
+	if (generation)
+		*generation = this->generation;
+	auto it = slots.find(key);
+	if (it != slots.end())
+		return it->second;
+
+	unsigned int slot = static_cast<unsigned int>(blocks.size());
+	slots.emplace(key, slot);
+	blocks.push_back(MaterialBlock{ glm::vec4(material.ka, 1.0f), glm::vec4(material.kd, 1.0f),
+		glm::vec4(material.ks, 1.0f) });
+	dirty = true;
+	return slot;
+}
+std::size_t MaterialPool::GetMaterialCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return blocks.size();
+}
+std::size_t MaterialPool::GetRequestCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return requestCount;
+}
+void MaterialPool::Bind(unsigned int slot)
+{
+	if (slotBound && boundSlot == slot)
+		return;
+	glBindBufferRange(GL_UNIFORM_BUFFER, blockBinding, bufferID, slot * slotStride, sizeof(MaterialBlock));
+	boundSlot = slot;
+	slotBound = true;
+}
+GLuint MaterialPool::GetTextureID() const
+{
+	return textureID;
+}
+int MaterialPool::GetSlotTexels() const
+{
+	return static_cast<int>(slotStride / sizeof(glm::vec4));
+}
+void MaterialPool::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	slots.clear();
+	blocks.clear();
+	requestCount = 0;
+	uploadedCount = 0;
+	slotBound = false;
+	generation++;
+}
+unsigned int MaterialPool::GetGeneration() const
+{
+	return generation;
+}
+void MaterialPool::Upload()
+{
+	// Cleared before the lock is taken, so slots added while this uploads raise it again
+	bool added = dirty.exchange(false);
+	if (bufferID != 0 && !added)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (bufferID != 0 && uploadedCount == blocks.size())
+		return;
+
+	if (bufferID == 0)
+	{
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		// The texture buffer view also needs whole texels
+		GLsizeiptr unit = std::max<GLsizeiptr>(alignment, sizeof(glm::vec4));
+		slotStride = (sizeof(MaterialBlock) + unit - 1) / unit * unit;
+		glGenBuffers(1, &bufferID);
+		glGenTextures(1, &textureID);
+	}
+
+	// Growing reallocates under the same name, so the texture buffer view stays attached
+	std::size_t first = uploadedCount;
+	glBindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	if (blocks.size() > capacity || capacity == 0)
+	{
+		capacity = std::max<std::size_t>(std::max<std::size_t>(blocks.size(), 2 * capacity), 16);
+		glBufferData(GL_UNIFORM_BUFFER, capacity * slotStride, nullptr, GL_STATIC_DRAW);
+		first = 0;
+		slotBound = false;
+	}
+	for (std::size_t slot = first; slot < blocks.size(); slot++)
+		glBufferSubData(GL_UNIFORM_BUFFER, slot * slotStride, sizeof(MaterialBlock), &blocks[slot]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	uploadedCount = blocks.size();
+	std::cout << "Materials: " << blocks.size() << " distinct of " << requestCount << ", "
+		<< capacity * slotStride << " byte uniform buffer\n";
+}
+
+MaterialPool& GetMaterialPool()
+{
+	static MaterialPool pool;
+	return pool;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct Material;
+
+// Every distinct Material in one uniform buffer. Each slot holds the Mat block in std140 layout (ka, kd and ks,
+// each padded to a vec4), and slots are GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT apart so that a draw selects its
+// material with glBindBufferRange alone. Identical materials share a slot. A MeshBatch reads the same buffer
+// through a GL_RGBA32F texture buffer, at texel slot * GetSlotTexels().
+class MaterialPool
+{
+public:
+	MaterialPool() = default;
+	MaterialPool(const MaterialPool&) = delete;
+	MaterialPool& operator=(const MaterialPool&) = delete;
+
+	// Slot of material, added if no identical material is pooled yet. Makes no GL calls; any thread. generation,
+	// if given, receives the GetGeneration() the slot belongs to.
+	unsigned int Add(const Material& material, unsigned int* generation = nullptr);
+	std::size_t GetMaterialCount() const;
+	std::size_t GetRequestCount() const; // Add calls, i.e. how many materials there would be without sharing
+
+	// Upload the slots added since the last call; when there are none it only tests a flag. Once per frame,
+	// before the draws. GL thread only.
+	void Upload();
+	// Bind the slot's range to the Mat block's binding point; the slot must have been uploaded. Nothing is bound
+	// if the slot is bound already. GL thread only.
+	void Bind(unsigned int slot);
+	// GL_TEXTURE_BUFFER view of the pool, current after Upload. GL thread only.
+	GLuint GetTextureID() const;
+	int GetSlotTexels() const; // texels (vec4) from one slot to the next
+
+	// Forget every slot, keeping the buffer for the next ones, e.g. between batch jobs so that the pool does not
+	// grow with every model rendered. The slots handed out before belong to an older generation; meshes add their
+	// material again when they see one (Mesh::UpdateMaterialSlot). GL thread only, and no MeshBatch built before
+	// may be drawn after it.
+	void Reset();
+	unsigned int GetGeneration() const; // GL thread only
+
+	static const GLuint blockBinding = 0; // of the Mat block
+private:
+	// One slot as laid out in the buffer
+	struct MaterialBlock
+	{
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+
+	mutable std::mutex mutex; // Add runs on loader threads
+	std::map<std::array<float, 9>, unsigned int> slots; // ka, kd, ks -> slot
+	std::vector<MaterialBlock> blocks; // by slot
+	std::size_t requestCount = 0;
+	unsigned int generation = 0; // changed by Reset on the GL thread only
+	std::atomic<bool> dirty{ false }; // slots were added since the last Upload
+
+	GLuint bufferID = 0;
+	GLuint textureID = 0;
+	GLsizeiptr slotStride = 0; // bytes
+	std::size_t uploadedCount = 0;
+	std::size_t capacity = 0; // slots the buffer has room for
+	unsigned int boundSlot = 0;
+	bool slotBound = false;
+};
+
+// Pool shared by every Mesh
+MaterialPool& GetMaterialPool();
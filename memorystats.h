@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Resident set size of this process in bytes, 0 where the platform does not report it
+std::size_t GetCurrentResidentSetSize();
+std::size_t GetPeakResidentSetSize(); // highest value since the process started
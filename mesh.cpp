@@ -1,358 +1,1039 @@
 #include "mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<std::array<unsigned int, 3>> faces, std::vector<unsigned int> indices, 
-	std::vector<std::vector<unsigned int>> adjacentFaces, std::vector<Texture> textures, Material mat)
-{
-	// geometry primitive ʱȭ
-	this->vertices = vertices;
-	this->faces = faces;
-	this->indices = indices;
-	this->adjacentFaces = adjacentFaces;
-	this->textures = textures;
-	this->mat = mat;
-
-	int nv = vertices.size();
-
-	// principal curvature, derivative of principal curvature 
-	CalculatePointAreas();
-	CalculatePrincipalCurvatures();
-	CalculateDerivativeCurvature();
+static bool releaseCpuMeshData = false;
+// Triangles per MeshPart: enough that a part's draw is worth a culling test, few enough to be culled often
+static const GLsizei partTriangleCount = 4096;
 
-	// adjacent face, count texture ʱȭ
-	adjacentFaceCountID = CreateAdjacentFaceCountTexture();
-	// adjacentFaceID = CreateAdjacentFaceTexture();
-	SetupMesh();
+void SetReleaseCpuMeshData(bool release)
+{
+	releaseCpuMeshData = release;
 }
-void Mesh::Draw(const Shader& shader)
+bool GetReleaseCpuMeshData()
+{
+	return releaseCpuMeshData;
+}
+
+std::vector<UniformHandle<int>> ResolveTextureSamplers(const Shader& shader, const std::vector<Texture>& textures)
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
 
-	auto textureSize = textures.size();
-	for (auto i = 0; i != textureSize; ++i)
+	std::vector<UniformHandle<int>> handles;
+	for (const auto& texture : textures)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
 		std::string number;
-		std::string name = textures[i].GetType();
+		const std::string& name = texture.GetType();
 		if (name == "texture_diffuse")
 			number = std::to_string(diffuseNr++);
 		else if (name == "texture_specular")
 			number = std::to_string(specularNr++);
+		handles.push_back(shader.GetUniformHandle<int>(name + number));
+	}
+	return handles;
+}
+
+Mesh::Mesh(MeshGeometry geometry, std::vector<std::array<unsigned int, 3>> faces, std::vector<unsigned int> indices, 
+	VertexFaceAdjacency adjacentFaces, std::vector<Texture> textures, Material mat,
+	std::vector<glm::vec3> cornerAreas, unsigned int validCurvatureStages)
+{
+	// geometry primitive ʱȭ
+	// Everything is moved in; the loader gives up its arrays instead of keeping a copy
+	this->geometry = std::move(geometry);
+	this->faces = std::move(faces);
+	this->indices = std::move(indices);
+	this->adjacentFaces = std::move(adjacentFaces);
+	this->textures = std::move(textures);
+	this->mat = mat;
+	this->materialSlot = GetMaterialPool().Add(mat, &materialGeneration);
+	this->cornerAreas = std::move(cornerAreas);
+	this->indexCount = static_cast<GLsizei>(this->indices.size());
+	this->vertexCount = static_cast<GLsizei>(this->geometry.GetVertexCount());
+	this->vertexQuantization = ComputeVertexQuantization(this->geometry);
+	this->cpuDataReleased = false;
+	this->handleProgramID = 0;
+	this->curvatureMilliseconds = 0.0;
+	// Every later stage reads the corner areas, so without them nothing precomputed can be trusted
+	this->validCurvatureStages = this->cornerAreas.size() == this->faces.size() ? validCurvatureStages : 0;
+
+	// GPU objects are created on the first Draw, when the shader's attributes are known
+	vertexArrayID = 0;
+	for (auto i = 0; i != VERTEX_ATTRIBUTE_COUNT; ++i)
+		attributeBufferIDs[i] = 0;
+	elementBufferID = 0;
+	uploadedAttributeMask = 0;
+	adjacentFaceCountID = 0;
+	adjacentFaceBufferID = 0;
+	adjacentFaceID = 0;
+	silhouetteElementBufferID = 0;
+	adjacencyElementBufferID = 0;
+	adjacencyIndexCount = 0;
+	silhouetteStatistics = SilhouetteStatistics();
+	contourVertexArrayID = 0;
+	contourBufferID = 0;
+	contourStatistics = SuggestiveContourStatistics();
+	apparentRidgeStatistics = ApparentRidgeStatistics();
+	apparentRidgeBoundOffset = 0;
+	meshletStatistics = MeshletStatistics();
+
+	if (IsMeshletCullingEnabled() && this->indices.size() == 3 * this->faces.size())
+		BuildMeshlets();
+	BuildParts();
+	if (IsSilhouetteExtractionEnabled())
+		BuildSilhouetteStructures();
+
+	if (IsCurvatureStageValid(CURVATURE_ALL))
+	{
+		// Otherwise UpdateCurvatures does this
+		BuildViewDependentStages();
+		return;
+	}
+
+	int nv = this->geometry.GetVertexCount(), nf = this->faces.size();
+	Timer curvatureTimer;
 
-		shader.SetInt(name + number, i);
+	// principal curvature, derivative of principal curvature 
+	UpdateCurvatures();
+	curvatureMilliseconds = curvatureTimer.ElapsedMilliseconds();
+	std::cout << "Curvature: " << nv << " vertices, " << nf << " faces, " << curvatureMilliseconds << " ms ("
+		<< GetWorkerThreadCount() << " threads, " << GetSimdLevelName(GetSimdLevel()) << ", "
+		<< static_cast<long long>(nf / (curvatureMilliseconds * 0.001 + 1e-9)) << " faces/s), geometry "
+		<< this->geometry.GetMemoryUsage() / 1024 << " KB\n";
+}
+void Mesh::Draw(const Shader& shader, const unsigned char* visibleParts)
+{
+	Upload(shader);
+	if (releaseCpuMeshData && !cpuDataReleased)
+		ReleaseCpuData();
+
+	SetVertexFormatUniforms(shader);
+
+	auto textureSize = textures.size();
+	for (auto i = 0; i != textureSize; ++i)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		shader.Set(textureSamplerHandles[i], i);
 		glBindTexture(GL_TEXTURE_2D, textures[i].GetTextureID());
 	}
 
-	shader.SetUniformBlockBinding("Mat", 0);
+	GetMaterialPool().Bind(materialSlot);
 	glBindVertexArray(vertexArrayID);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr); // simple rendering: GL_TRIANGLES, silhouette: GL_TRIANGLES_ADJACENCY
+	DrawTriangles(visibleParts);
 	glBindVertexArray(0);
 
 	glActiveTexture(GL_TEXTURE0);
+
+	apparentRidgeBuffer.FenceRead();
 }
-void Mesh::SetupMesh()
+void Mesh::DrawTriangles(const unsigned char* visibleParts)
 {
-	glGenVertexArrays(1, &vertexArrayID);
-	glBindVertexArray(vertexArrayID);
+	bool cullMeshlets = IsMeshletCullingEnabled() && !meshletFacing.empty();
+	if (!visibleParts && !cullMeshlets)
+	{
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr); // GL_TRIANGLES_ADJACENCY: see DrawWithAdjacency
+		return;
+	}
 
-	glGenBuffers(1, &vertexBufferID);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	// Index ranges of the parts, or meshlets, that are kept, merged where one ends where the next begins
+	drawRangeCounts.clear();
+	drawRangeOffsets.clear();
+	GLuint rangeEnd = 0;
+	auto addRange = [&](GLuint first, GLsizei count)
+	{
+		if (!drawRangeCounts.empty() && first == rangeEnd)
+			drawRangeCounts.back() += count;
+		else
+		{
+			drawRangeCounts.push_back(count);
+			drawRangeOffsets.push_back(reinterpret_cast<const void*>(first * sizeof(GLuint)));
+		}
+		rangeEnd = first + count;
+	};
+	if (cullMeshlets)
+	{
+		const std::vector<Meshlet>& list = meshlets.GetMeshlets();
+		GLuint partIndexCount = 3 * partTriangleCount;
+		for (std::size_t m = 0; m < list.size(); m++)
+		{
+			if (meshletFacing[m] == MESHLET_BACK_FACING)
+				continue;
+			GLuint first = 3 * list[m].firstFace, count = 3 * list[m].faceCount;
+			// A meshlet may straddle two parts
+			bool visible = !visibleParts;
+			for (GLuint p = first / partIndexCount; !visible && p <= (first + count - 1) / partIndexCount; p++)
+				visible = visibleParts[p] != 0;
+			if (visible)
+				addRange(first, static_cast<GLsizei>(count));
+		}
+	}
+	else
+	{
+		for (std::size_t p = 0; p < parts.size(); p++)
+		{
+			if (visibleParts[p])
+				addRange(parts[p].firstIndex, parts[p].indexCount);
+		}
+	}
+	if (!drawRangeCounts.empty())
+		glMultiDrawElements(GL_TRIANGLES, drawRangeCounts.data(), GL_UNSIGNED_INT, drawRangeOffsets.data(),
+			static_cast<GLsizei>(drawRangeCounts.size()));
+}
+void Mesh::Upload(const Shader& shader)
+{
+	if (vertexArrayID == 0)
+		SetupMesh();
+	UploadAttributes(shader.GetActiveAttributeMask());
+}
+void Mesh::DeleteGpuObjects()
+{
+	if (vertexArrayID == 0)
+		return;
 
-	glGenBuffers(1, &elementBufferID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	for (auto i = 0; i != VERTEX_ATTRIBUTE_COUNT; ++i)
+	{
+		if (attributeBufferIDs[i] != 0)
+			glDeleteBuffers(1, &attributeBufferIDs[i]);
+		attributeBufferIDs[i] = 0;
+	}
+	glDeleteBuffers(1, &elementBufferID);
+	glDeleteTextures(1, &adjacentFaceCountID);
+	glDeleteTextures(1, &adjacentFaceID);
+	glDeleteBuffers(1, &adjacentFaceBufferID);
+	glDeleteBuffers(1, &silhouetteElementBufferID);
+	glDeleteBuffers(1, &adjacencyElementBufferID);
+	glDeleteVertexArrays(1, &contourVertexArrayID);
+	glDeleteBuffers(1, &contourBufferID);
+	apparentRidgeBuffer.Destroy();
 
-	glGenBuffers(1, &uniformBlockIndexID);
-	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockIndexID);
-	glBufferData(GL_UNIFORM_BUFFER, 3 * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uniformBlockIndexID, 0, 3 * sizeof(glm::vec3));
-
-	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockIndexID);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec3), glm::value_ptr(mat.ka));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockIndexID);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::vec3), sizeof(glm::vec3), glm::value_ptr(mat.kd));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	glBindBuffer(GL_UNIFORM_BUFFER, uniformBlockIndexID);
-	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::vec3), sizeof(glm::vec3), glm::value_ptr(mat.ks));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pdir1));
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pdir2));
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, curv1));
-	glEnableVertexAttribArray(6);
-	glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, curv2));
-	glEnableVertexAttribArray(7);
-	glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, dcurv));
+	vertexArrayID = 0;
+	elementBufferID = 0;
+	adjacentFaceCountID = 0;
+	adjacentFaceID = 0;
+	adjacentFaceBufferID = 0;
+	silhouetteElementBufferID = 0;
+	adjacencyElementBufferID = 0;
+	contourVertexArrayID = 0;
+	contourBufferID = 0;
+	apparentRidgeBoundOffset = 0;
+	uploadedAttributeMask = 0;
+}
+void Mesh::DrawSilhouettes(const Shader& shader, const glm::vec3& eye)
+{
+	if (!silhouetteExtractor.IsBuilt())
+		return;
+	Upload(shader);
 
+	silhouetteExtractor.Extract(eye, silhouetteIndices, &silhouetteStatistics);
+	if (silhouetteIndices.empty())
+		return;
+	SetVertexFormatUniforms(shader);
+
+	// The element buffer binding is VAO state, so the triangle indices are bound again afterwards
+	glBindVertexArray(vertexArrayID);
+	if (silhouetteElementBufferID == 0)
+		glGenBuffers(1, &silhouetteElementBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, silhouetteElementBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, silhouetteIndices.size() * sizeof(unsigned int), silhouetteIndices.data(),
+		GL_STREAM_DRAW);
+	glDrawElements(GL_LINES, static_cast<GLsizei>(silhouetteIndices.size()), GL_UNSIGNED_INT, nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
 	glBindVertexArray(0);
 }
-void Mesh::CalculatePointAreas()
+void Mesh::DrawWithAdjacency(const Shader& shader)
 {
-	int nf = faces.size(), nv = vertices.size();
-	std::array<unsigned int, 3> face;
-	cornerAreas.reserve(nf);
-
-	for (int i = 0; i < nf; i++)
-	{
-		// Edges
-		face = faces[i];
-		glm::vec3 e[3] = { vertices[face[2]].position - vertices[face[1]].position,
-			vertices[face[0]].position - vertices[face[2]].position,
-			vertices[face[1]].position - vertices[face[0]].position };
+	Upload(shader);
+	if (adjacencyElementBufferID == 0)
+		return;
+	SetVertexFormatUniforms(shader);
 
-		// Compute corner weights
-		float area = 0.5f * glm::length(glm::cross(e[0], e[1]));
-		float l2[3] = { glm::length2(e[0]), glm::length2(e[1]), glm::length2(e[2]) };
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, adjacencyElementBufferID);
+	glDrawElements(GL_TRIANGLES_ADJACENCY, adjacencyIndexCount, GL_UNSIGNED_INT, nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
+	glBindVertexArray(0);
+}
+const SilhouetteStatistics& Mesh::GetSilhouetteStatistics() const
+{
+	return silhouetteStatistics;
+}
+void Mesh::DrawSuggestiveContours(const glm::vec3& eye, const SuggestiveContourOptions& options)
+{
+	if (cpuDataReleased || !suggestiveContours.IsBuilt())
+		return;
 
-		// Barycentric weights of circumcenter
-		float bcw[3] = { l2[0] * (l2[1] + l2[2] - l2[0]),
-						 l2[1] * (l2[2] + l2[0] - l2[1]),
-						 l2[2] * (l2[0] + l2[1] - l2[2]) };
-		glm::vec3 cornerArea;
-		if (bcw[0] <= 0.0f)
-		{
-			cornerArea.y = -0.25f * l2[2] * area /
-				glm::dot(e[0], e[2]);
-			cornerArea.z = -0.25f * l2[1] * area /
-				glm::dot(e[0], e[1]);
-			cornerArea.x = area - cornerArea.y - cornerArea.z;
-		}
-		else if (bcw[1] <= 0.0f)
-		{
-			cornerArea.z = -0.25f * l2[0] * area /
-				glm::dot(e[1], e[0]);
-			cornerArea.x = -0.25f * l2[2] * area /
-				glm::dot(e[1], e[2]);
-			cornerArea.y = area - cornerArea.z - cornerArea.x;
-		}
-		else if (bcw[2] <= 0.0f)
+	const std::vector<unsigned int>* candidateFaces = nullptr;
+	if (IsMeshletCullingEnabled() && !meshletFacing.empty())
+	{
+		// Contours lie on front facing faces only
+		const std::vector<Meshlet>& list = meshlets.GetMeshlets();
+		contourFaces.clear();
+		for (std::size_t m = 0; m < list.size(); m++)
 		{
-			cornerArea.x = -0.25f * l2[1] * area /
-				glm::dot(e[2], e[1]);
-			cornerArea.y = -0.25f * l2[0] * area /
-				glm::dot(e[2], e[0]);
-			cornerArea.z = area - cornerArea.x - cornerArea.y;
+			if (meshletFacing[m] == MESHLET_BACK_FACING)
+				continue;
+			for (unsigned int f = list[m].firstFace; f < list[m].firstFace + list[m].faceCount; f++)
+				contourFaces.push_back(f);
 		}
-		else
+		candidateFaces = &contourFaces;
+	}
+	suggestiveContours.Extract(geometry, faces, eye, options, contourVertices, &contourStatistics, candidateFaces);
+	if (contourVertices.empty())
+		return;
+
+	if (contourVertexArrayID == 0)
+	{
+		glGenVertexArrays(1, &contourVertexArrayID);
+		glGenBuffers(1, &contourBufferID);
+		glBindVertexArray(contourVertexArrayID);
+		glBindBuffer(GL_ARRAY_BUFFER, contourBufferID);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SuggestiveContourVertex),
+			reinterpret_cast<void*>(offsetof(SuggestiveContourVertex, position)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(SuggestiveContourVertex),
+			reinterpret_cast<void*>(offsetof(SuggestiveContourVertex, alpha)));
+	}
+	else
+	{
+		glBindVertexArray(contourVertexArrayID);
+		glBindBuffer(GL_ARRAY_BUFFER, contourBufferID);
+	}
+	glBufferData(GL_ARRAY_BUFFER, contourVertices.size() * sizeof(SuggestiveContourVertex), contourVertices.data(),
+		GL_STREAM_DRAW);
+	glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(contourVertices.size()));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+void Mesh::DrawSuggestiveContoursGpu(const Shader& shader)
+{
+	if (handleProgramID != shader.GetProgramID())
+		ResolveShaderHandles(shader);
+	shader.Set(featureSizeHandle, suggestiveContours.GetFeatureSize());
+	Draw(shader);
+}
+const SuggestiveContourStatistics& Mesh::GetSuggestiveContourStatistics() const
+{
+	return contourStatistics;
+}
+void Mesh::UpdateApparentRidges(const glm::vec3& eye, float viewTolerance)
+{
+	if (cpuDataReleased || !apparentRidges.IsBuilt())
+		return;
+	if (!apparentRidgeBuffer.IsCreated())
+		CreateApparentRidgeBuffer();
+
+	apparentRidges.Update(geometry, faces, adjacentFaces, eye, viewTolerance, apparentRidgeStaging.data(),
+		&apparentRidgeStatistics);
+	// The region written was last drawn three frames ago, so this only waits if the GPU is that far behind
+	std::size_t stride = sizeof(ApparentRidgeVertex);
+	apparentRidgeStatistics.streamedBytes = apparentRidgeBuffer.Update(apparentRidgeStaging.data(),
+		apparentRidges.GetWrittenBegin() * stride, apparentRidges.GetWrittenEnd() * stride);
+	if (apparentRidgeBuffer.GetReadOffset() != apparentRidgeBoundOffset)
+		BindApparentRidgeAttributes();
+}
+void Mesh::DrawApparentRidges(const Shader& shader)
+{
+	if (!apparentRidgeBuffer.IsCreated())
+		return;
+	if (handleProgramID != shader.GetProgramID())
+		ResolveShaderHandles(shader);
+	shader.Set(featureSizeHandle, apparentRidges.GetFeatureSize());
+	Draw(shader);
+}
+const ApparentRidgeStatistics& Mesh::GetApparentRidgeStatistics() const
+{
+	return apparentRidgeStatistics;
+}
+void Mesh::CullMeshlets(const glm::vec3& eye)
+{
+	if (meshlets.IsBuilt())
+		meshlets.Classify(eye, meshletFacing, &meshletStatistics);
+}
+const MeshletStatistics& Mesh::GetMeshletStatistics() const
+{
+	return meshletStatistics;
+}
+void Mesh::CreateApparentRidgeBuffer()
+{
+	if (vertexArrayID == 0)
+		SetupMesh();
+
+	// Every region starts out pending in full, so the first Update of each copies these initial values too
+	ApparentRidgeVertex initial = { 0.0f, glm::vec2(1.0f, 0.0f), 0.0f };
+	apparentRidgeStaging.assign(geometry.GetVertexCount(), initial);
+	if (!apparentRidgeBuffer.Create(apparentRidgeStaging.size() * sizeof(ApparentRidgeVertex)))
+		return;
+
+	glBindVertexArray(vertexArrayID);
+	glEnableVertexAttribArray(ATTRIBUTE_Q1);
+	glEnableVertexAttribArray(ATTRIBUTE_T1);
+	glEnableVertexAttribArray(ATTRIBUTE_DT1Q1);
+	glBindVertexArray(0);
+	BindApparentRidgeAttributes();
+}
+void Mesh::BindApparentRidgeAttributes()
+{
+	apparentRidgeBoundOffset = apparentRidgeBuffer.GetReadOffset();
+	auto pointer = [this](std::size_t member) { return reinterpret_cast<void*>(apparentRidgeBoundOffset + member); };
+	GLsizei stride = sizeof(ApparentRidgeVertex);
+
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, apparentRidgeBuffer.GetBufferID());
+	glVertexAttribPointer(ATTRIBUTE_Q1, 1, GL_FLOAT, GL_FALSE, stride, pointer(offsetof(ApparentRidgeVertex, q1)));
+	glVertexAttribPointer(ATTRIBUTE_T1, 2, GL_FLOAT, GL_FALSE, stride, pointer(offsetof(ApparentRidgeVertex, t1)));
+	glVertexAttribPointer(ATTRIBUTE_DT1Q1, 1, GL_FLOAT, GL_FALSE, stride, pointer(offsetof(ApparentRidgeVertex, dt1q1)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+void Mesh::BuildMeshlets()
+{
+	Timer buildTimer;
+	std::vector<unsigned int> faceOrder;
+	meshlets.Build(geometry.positions, geometry.normals, faces, adjacentFaces, faceOrder);
+	if (GetMeshOptimizationOptions().enabled && !faceOrder.empty())
+	{
+		// The meshlet order replaces the one optimized at import; optimize again within each meshlet
+		std::vector<std::array<unsigned int, 3>> meshletFaces(faceOrder.size());
+		for (std::size_t i = 0; i < faceOrder.size(); i++)
+			meshletFaces[i] = faces[faceOrder[i]];
+		std::vector<unsigned int> meshletEnds, cacheOrder, optimizedOrder(faceOrder.size());
+		for (const auto& meshlet : meshlets.GetMeshlets())
+			meshletEnds.push_back(meshlet.firstFace + meshlet.faceCount);
+		OptimizeVertexCache(meshletFaces, geometry.GetVertexCount(), cacheOrder, &meshletEnds);
+		for (std::size_t i = 0; i < cacheOrder.size(); i++)
+			optimizedOrder[i] = faceOrder[cacheOrder[i]];
+		faceOrder.swap(optimizedOrder);
+	}
+
+	// Everything per face follows; a mesh cached in meshlet order usually comes back unchanged
+	bool reordered = false;
+	for (std::size_t i = 0; i < faceOrder.size() && !reordered; i++)
+		reordered = faceOrder[i] != i;
+	if (reordered)
+	{
+		std::vector<std::array<unsigned int, 3>> orderedFaces(faces.size());
+		for (std::size_t i = 0; i < faceOrder.size(); i++)
+			orderedFaces[i] = faces[faceOrder[i]];
+		faces.swap(orderedFaces);
+		if (cornerAreas.size() == faces.size())
 		{
-			float scale = 0.5f * area / (bcw[0] + bcw[1] + bcw[2]);
-			cornerArea.x = scale * (bcw[1] + bcw[2]);
-			cornerArea.y = scale * (bcw[2] + bcw[0]);
-			cornerArea.z = scale * (bcw[0] + bcw[1]);
+			std::vector<glm::vec3> orderedAreas(cornerAreas.size());
+			for (std::size_t i = 0; i < faceOrder.size(); i++)
+				orderedAreas[i] = cornerAreas[faceOrder[i]];
+			cornerAreas.swap(orderedAreas);
 		}
-		cornerAreas.push_back(cornerArea);
+		adjacentFaces.Build(faces, geometry.GetVertexCount());
 	}
-	for (int i = 0; i < nf; i++)
+	for (std::size_t i = 0; i < faces.size(); i++)
 	{
-		face = faces[i];
-		vertices[face[0]].pointArea += cornerAreas[i].x;
-		vertices[face[1]].pointArea += cornerAreas[i].y;
-		vertices[face[2]].pointArea += cornerAreas[i].z;
+		for (int j = 0; j < 3; j++)
+			indices[3 * i + j] = faces[i][j];
 	}
+
+	float coneAngles = 0.0f;
+	for (const auto& meshlet : meshlets.GetMeshlets())
+		coneAngles += meshlet.coneAngle;
+	std::size_t meshletCount = meshlets.GetMeshlets().size();
+	std::cout << "Meshlets: " << meshletCount << " of " << faces.size() / std::max<std::size_t>(meshletCount, 1)
+		<< " faces on average, mean cone half angle " << coneAngles / std::max<std::size_t>(meshletCount, 1) * 57.2958f
+		<< " degrees, ACMR " << AnalyzeVertexCache(faces, geometry.GetVertexCount()).acmr << ", "
+		<< buildTimer.ElapsedMilliseconds() << " ms\n";
 }
-void Mesh::CalculatePrincipalCurvatures()
+void Mesh::BuildParts()
 {
-	// Resize the arrays we'll be using
-	int nv = vertices.size(), nf = faces.size();
-	std::vector<float> curv12;
-	curv12.reserve(nv);
-	std::array<unsigned int, 3> face;
+	GLsizei partIndexCount = 3 * partTriangleCount;
+	for (GLsizei first = 0; first < indexCount; first += partIndexCount)
+	{
+		MeshPart part;
+		part.firstIndex = static_cast<GLuint>(first);
+		part.indexCount = std::min(partIndexCount, indexCount - first);
+		for (GLsizei i = first; i < first + part.indexCount; i++)
+			part.bounds.Expand(geometry.positions[indices[i]]);
+		bounds.Expand(part.bounds);
+		parts.push_back(part);
+	}
+}
+void Mesh::BuildViewDependentStages()
+{
+	if (GetSuggestiveContourMode() != SUGGESTIVE_CONTOURS_OFF)
+		suggestiveContours.Build(geometry);
+	if (AreApparentRidgesEnabled())
+		apparentRidges.Build(geometry);
+}
+void Mesh::BuildSilhouetteStructures()
+{
+	Timer buildTimer;
+	edgeTopology.Build(faces);
+	silhouetteExtractor.Build(geometry.positions, faces, edgeTopology);
+	std::cout << "Edges: " << edgeTopology.GetEdges().size() << " (" << edgeTopology.GetBoundaryEdgeCount()
+		<< " boundary, " << edgeTopology.GetNonManifoldEdgeCount() << " non-manifold), "
+		<< buildTimer.ElapsedMilliseconds() << " ms, " << (edgeTopology.GetMemoryUsage() +
+		silhouetteExtractor.GetMemoryUsage()) / 1024 << " KB\n";
+}
+void Mesh::ResolveShaderHandles(const Shader& shader)
+{
+	textureSamplerHandles = ResolveTextureSamplers(shader, textures);
 
-	for (int i = 0; i < nv; i++)
+	// Block bindings are program state, so this only has to happen once per program
+	shader.SetUniformBlockBinding("Mat", MaterialPool::blockBinding);
+	featureSizeHandle = shader.GetUniformHandle<float>("featureSize");
+	vertexFormatHandles.Resolve(shader);
+	handleProgramID = shader.GetProgramID();
+}
+void Mesh::SetVertexFormatUniforms(const Shader& shader)
+{
+	if (handleProgramID != shader.GetProgramID())
+		ResolveShaderHandles(shader);
+	vertexFormatHandles.Set(shader, vertexQuantization);
+}
+void Mesh::UpdateCurvatures()
+{
+	UpdateCurvatureStages();
+	BuildViewDependentStages();
+}
+void Mesh::UpdateCurvatureStages()
+{
+	CalculateDerivativeCurvature();
+}
+void Mesh::InvalidateGeometry()
+{
+	if (cpuDataReleased)
 	{
-		curv12.push_back(0.0f);
+		std::cerr << "ERROR::MESH::CPU_DATA_RELEASED: geometry can no longer be recomputed\n";
+		return;
 	}
+	validCurvatureStages = 0;
+	uploadedAttributeMask = 0;
+}
+bool Mesh::IsCurvatureStageValid(CurvatureStage stage) const
+{
+	return (validCurvatureStages & stage) == stage;
+}
+void Mesh::ReleaseCpuData()
+{
+	if (cpuDataReleased)
+		return;
 
-	// Set up an initial coordinate system per vertex
-	for (int i = 0; i < nf; i++) 
+	// Every stream must be on the GPU first, since no other shader could get it afterwards
+	if (vertexArrayID == 0)
+		SetupMesh();
+	UploadAttributes((1u << VERTEX_ATTRIBUTE_COUNT) - 1);
+
+	geometry = MeshGeometry();
+	std::vector<std::array<unsigned int, 3>>().swap(faces);
+	std::vector<unsigned int>().swap(indices);
+	adjacentFaces = VertexFaceAdjacency();
+	edgeTopology = EdgeTopology(); // the adjacency indices are on the GPU; the extractor keeps its own copy
+	std::vector<glm::vec3>().swap(cornerAreas);
+	std::vector<ApparentRidgeVertex>().swap(apparentRidgeStaging);
+	cpuDataReleased = true;
+}
+bool Mesh::IsCpuDataReleased() const
+{
+	return cpuDataReleased;
+}
+const MeshGeometry& Mesh::GetGeometry() const { return geometry; }
+const std::vector<std::array<unsigned int, 3>>& Mesh::GetFaces() const { return faces; }
+const std::vector<unsigned int>& Mesh::GetIndices() const { return indices; }
+const VertexFaceAdjacency& Mesh::GetAdjacentFaces() const { return adjacentFaces; }
+const std::vector<glm::vec3>& Mesh::GetCornerAreas() const { return cornerAreas; }
+const std::vector<Texture>& Mesh::GetTextures() const { return textures; }
+const Material& Mesh::GetMaterial() const { return mat; }
+double Mesh::GetCurvatureMilliseconds() const { return curvatureMilliseconds; }
+void Mesh::SetTextures(std::vector<Texture> textures)
+{
+	this->textures = std::move(textures);
+	// The sampler handles are per texture
+	handleProgramID = 0;
+}
+GLuint Mesh::GetAttributeBufferID(VertexAttribute attribute) const { return attributeBufferIDs[attribute]; }
+GLuint Mesh::GetElementBufferID() const { return elementBufferID; }
+unsigned int Mesh::GetMaterialSlot() const { return materialSlot; }
+void Mesh::UpdateMaterialSlot()
+{
+	if (materialGeneration != GetMaterialPool().GetGeneration())
+		materialSlot = GetMaterialPool().Add(mat, &materialGeneration);
+}
+GLsizei Mesh::GetVertexCount() const { return vertexCount; }
+GLsizei Mesh::GetIndexCount() const { return indexCount; }
+const std::vector<MeshPart>& Mesh::GetParts() const { return parts; }
+const BoundingBox& Mesh::GetBounds() const { return bounds; }
+void Mesh::SetVertexQuantization(const VertexQuantization& quantization)
+{
+	if (quantization == vertexQuantization)
+		return;
+	if (cpuDataReleased)
 	{
-		face = faces[i];
-		vertices[face[0]].pdir1 = vertices[face[1]].position - vertices[face[0]].position;
-		vertices[face[1]].pdir1 = vertices[face[2]].position - vertices[face[1]].position;
-		vertices[face[2]].pdir1 = vertices[face[0]].position - vertices[face[2]].position;
+		std::cerr << "ERROR::MESH::CPU_DATA_RELEASED: the vertex streams can no longer be encoded again\n";
+		return;
 	}
+	vertexQuantization = quantization;
+	if (GetVertexFormat() == VERTEX_FORMAT_COMPACT)
+		uploadedAttributeMask &= ~((1u << ATTRIBUTE_POSITION) | (1u << ATTRIBUTE_TEXCOORDS));
+}
+const VertexQuantization& Mesh::GetVertexQuantization() const { return vertexQuantization; }
+CurvatureKernelInput Mesh::GetCurvatureKernelInput() const
+{
+	CurvatureKernelInput input;
+	input.faces = faces.data();
+	input.cornerAreas = cornerAreas.data();
+	input.positions = geometry.positions.data();
+	input.normals = geometry.normals.data();
+	input.pdir1 = geometry.pdir1.data();
+	input.pdir2 = geometry.pdir2.data();
+	input.curv1 = geometry.curv1.data();
+	input.curv2 = geometry.curv2.data();
+	input.pointAreas = geometry.pointAreas.data();
+	return input;
+}
+void Mesh::SetupMesh()
+{
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+
+	glGenBuffers(1, &elementBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
-	for (int i = 0; i < nv; i++)
+	glBindVertexArray(0);
+
+	if (!edgeTopology.GetEdges().empty())
 	{
-		vertices[i].pdir1 = glm::cross(vertices[i].pdir1, vertices[i].normal);
-		vertices[i].pdir1 = glm::normalize(vertices[i].pdir1);
-		vertices[i].pdir2 = glm::cross(vertices[i].normal, vertices[i].pdir1);
+		std::vector<unsigned int> adjacencyIndices;
+		edgeTopology.BuildAdjacencyIndices(faces, adjacencyIndices);
+		adjacencyIndexCount = static_cast<GLsizei>(adjacencyIndices.size());
+		glGenBuffers(1, &adjacencyElementBufferID);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, adjacencyElementBufferID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, adjacencyIndices.size() * sizeof(unsigned int), adjacencyIndices.data(),
+			GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
-	// Compute curvature per-face
-	for (int i = 0; i < nf; i++) 
-	{
-		// Edges
-		face = faces[i];
-		glm::vec3 e[3] = { vertices[face[2]].position - vertices[face[1]].position,
-			vertices[face[0]].position - vertices[face[2]].position,
-			vertices[face[1]].position - vertices[face[0]].position };
-
-		// N-T-B coordinate system per face
-		glm::vec3 t = e[0];
-		t = glm::normalize(t);
-		glm::vec3 n = glm::cross(e[0], e[1]);
-		glm::vec3 b = glm::cross(n, t);
-		b = glm::normalize(b);
-
-		// Estimate curvature based on variation of normals
-		// along edges
-		float m[3] = { 0, 0, 0 };
-		float w[3][3] = { {0,0,0}, {0,0,0}, {0,0,0} };
-		for (int j = 0; j < 3; j++)
+	// adjacent face, count texture ʱȭ
+	adjacentFaceCountID = CreateAdjacentFaceCountTexture();
+	adjacentFaceID = CreateAdjacentFaceTexture();
+}
+void Mesh::UploadAttributes(unsigned int attributeMask)
+{
+	// Streams that are current, or that the shader never reads, are left alone; locations from
+	// VERTEX_ATTRIBUTE_COUNT on are fed by others (the apparent ridge stream, a MeshBatch)
+	unsigned int missingMask = attributeMask & ((1u << VERTEX_ATTRIBUTE_COUNT) - 1) & ~uploadedAttributeMask;
+	if (missingMask == 0)
+		return;
+
+	glBindVertexArray(vertexArrayID);
+	VertexFormat format = GetVertexFormat();
+	std::size_t uploadedBytes = 0, floatBytes = 0;
+	std::vector<unsigned char> encoded;
+	VertexEncodingError encodingError = VertexEncodingError();
+	for (auto i = 0; i != VERTEX_ATTRIBUTE_COUNT; ++i)
+	{
+		if ((missingMask & (1u << i)) == 0)
+			continue;
+
+		VertexAttribute attribute = static_cast<VertexAttribute>(i);
+		if (attributeBufferIDs[i] == 0)
+			glGenBuffers(1, &attributeBufferIDs[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, attributeBufferIDs[i]);
+		if (format == VERTEX_FORMAT_COMPACT)
 		{
-			float u = glm::dot(e[j], t);
-			float v = glm::dot(e[j], b);
-			w[0][0] += u * u;
-			w[0][1] += u * v;
-			w[2][2] += v * v;
-			// The below are computed once at the end of the loop
-			// w[1][1] += v*v + u*u;
-			// w[1][2] += u*v;
-			unsigned int faceAddress0 = static_cast<unsigned int>((j + 2) % 3);
-			unsigned int faceAddress1 = static_cast<unsigned int>((j + 1) % 3);
-			glm::vec3 dn = vertices[face[faceAddress0]].normal - vertices[face[faceAddress1]].normal; // PREV_MOD3: (j - 1) % 3, NEXT_MOD3: (j + 1) % 3
-			float dnu = glm::dot(dn, t);
-			float dnv = glm::dot(dn, b);
-			m[0] += dnu * u;
-			m[1] += dnu * v + dnv * u;
-			m[2] += dnv * v;
+			encoded.clear();
+			EncodeCompactAttribute(geometry, attribute, vertexQuantization, encoded, &encodingError);
+			glBufferData(GL_ARRAY_BUFFER, encoded.size(), encoded.data(), GL_STATIC_DRAW);
+			uploadedBytes += encoded.size();
 		}
-		w[1][1] = w[0][0] + w[2][2];
-		w[1][2] = w[0][1];
-
-		// Least squares solution
-		float diag[3];
-		if (!ldltdc<float, 3>(w, diag)) 
+		else
 		{
-			//dprintf("ldltdc failed!\n");
-			continue;
+			glBufferData(GL_ARRAY_BUFFER, geometry.GetAttributeSize(attribute), geometry.GetAttributeData(attribute), GL_STATIC_DRAW);
+			uploadedBytes += geometry.GetAttributeSize(attribute);
 		}
-		ldltsl<float, 3>(w, diag, m, m);
+		floatBytes += geometry.GetAttributeSize(attribute);
+
+		VertexStreamFormat stream = GetVertexStreamFormat(format, attribute);
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, stream.components, stream.type, stream.normalized, 0, (void*)0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	uploadedAttributeMask |= missingMask;
+	std::cout << "Uploaded " << uploadedBytes / 1024 << " KB of vertex streams (attribute mask 0x" << std::hex
+		<< uploadedAttributeMask << std::dec << ", " << GetVertexFormatName(format) << ")\n";
+	if (format == VERTEX_FORMAT_COMPACT)
+	{
+		// Against the float streams: what the shaders now decode differs from them by at most this much
+		float diagonal = glm::length(vertexQuantization.positions.max - vertexQuantization.positions.min);
+		std::cout << "Compact vertices: " << (floatBytes - uploadedBytes) / 1024 << " KB ("
+			<< 100.0 * (floatBytes - uploadedBytes) / std::max<std::size_t>(floatBytes, 1) << "%) less than float, max error";
+		if (missingMask & (1u << ATTRIBUTE_POSITION))
+			std::cout << " position " << encodingError.position / std::max(diagonal, 1e-30f) << " of the diagonal";
+		if (missingMask & (1u << ATTRIBUTE_TEXCOORDS))
+			std::cout << " texcoord " << encodingError.texCoord;
+		if (missingMask & (1u << ATTRIBUTE_NORMAL))
+			std::cout << " normal " << encodingError.normalDegrees << " deg";
+		if (missingMask & ((1u << ATTRIBUTE_PDIR1) | (1u << ATTRIBUTE_PDIR2)))
+			std::cout << " pdir " << encodingError.directionDegrees << " deg";
+		if (missingMask & ((1u << ATTRIBUTE_CURV1) | (1u << ATTRIBUTE_CURV2)))
+			std::cout << " curv " << encodingError.curvature << " of the largest";
+		if (missingMask & (1u << ATTRIBUTE_DCURV))
+			std::cout << " dcurv " << encodingError.derivative << " of the largest";
+		if (encodingError.clampedValues > 0)
+			std::cout << ", " << encodingError.clampedValues << " values clamped to the half float range";
+		std::cout << "\n";
+	}
+}
+// Visit every (face, corner) pair that references vertex v, in increasing face order.
+// adjacentFaces[v] is built in face order, so gathering through it adds the per-face
+// contributions in exactly the order the serial per-face scatter did, and the parallel
+// results are bit-identical to the single-threaded ones.
+template <class Func>
+static inline void ForEachVertexCorner(IndexSpan adjacent,
+	const std::vector<std::array<unsigned int, 3>>& faces, unsigned int v, Func func)
+{
+	bool first = true;
+	unsigned int previous = 0;
+	for (auto f : adjacent)
+	{
+		// A degenerate face lists the same vertex more than once
+		if (!first && f == previous)
+			continue;
+		first = false;
+		previous = f;
 
-		// Push it back out to the vertices
 		for (int j = 0; j < 3; j++)
 		{
-			int vj = face[j];
-			float c1, c12, c2;
-			proj_curv(t, b, m[0], m[1], m[2],
-				vertices[vj].pdir1, vertices[vj].pdir2, c1, c12, c2);
-			float wt = cornerAreas[i][j] / vertices[vj].pointArea;
-			vertices[vj].curv1 += wt * c1;
-			curv12[vj] += wt * c12;
-			vertices[vj].curv2 += wt * c2;
+			if (faces[f][j] == v)
+				func(f, j);
 		}
 	}
+}
+
+void Mesh::CalculatePointAreas()
+{
+	if (IsCurvatureStageValid(CURVATURE_POINT_AREAS))
+		return;
+
+	int nf = faces.size(), nv = geometry.GetVertexCount();
+	cornerAreas.resize(nf);
 
-	// Compute principal directions and curvatures at each vertex
-	for (int i = 0; i < nv; i++)
+	// Compute corner weights per face
+	ParallelFor(nf, [&](int begin, int end)
 	{
-		diagonalize_curv(vertices[i].pdir1, vertices[i].pdir2,
-			vertices[i].curv1, curv12[i], vertices[i].curv2,
-			vertices[i].normal, vertices[i].pdir1, vertices[i].pdir2,
-			vertices[i].curv1, vertices[i].curv2);
-	} 
-}
+		for (int i = begin; i < end; i++)
+		{
+			// Edges
+			const std::array<unsigned int, 3>& face = faces[i];
+			glm::vec3 e[3] = { geometry.positions[face[2]] - geometry.positions[face[1]],
+				geometry.positions[face[0]] - geometry.positions[face[2]],
+				geometry.positions[face[1]] - geometry.positions[face[0]] };
 
-void Mesh::CalculateDerivativeCurvature()
+			// Compute corner weights
+			float area = 0.5f * glm::length(glm::cross(e[0], e[1]));
+			float l2[3] = { glm::length2(e[0]), glm::length2(e[1]), glm::length2(e[2]) };
+
+			// Barycentric weights of circumcenter
+			float bcw[3] = { l2[0] * (l2[1] + l2[2] - l2[0]),
+							 l2[1] * (l2[2] + l2[0] - l2[1]),
+							 l2[2] * (l2[0] + l2[1] - l2[2]) };
+			glm::vec3 cornerArea;
+			if (bcw[0] <= 0.0f)
+			{
+				cornerArea.y = -0.25f * l2[2] * area /
+					glm::dot(e[0], e[2]);
+				cornerArea.z = -0.25f * l2[1] * area /
+					glm::dot(e[0], e[1]);
+				cornerArea.x = area - cornerArea.y - cornerArea.z;
+			}
+			else if (bcw[1] <= 0.0f)
+			{
+				cornerArea.z = -0.25f * l2[0] * area /
+					glm::dot(e[1], e[0]);
+				cornerArea.x = -0.25f * l2[2] * area /
+					glm::dot(e[1], e[2]);
+				cornerArea.y = area - cornerArea.z - cornerArea.x;
+			}
+			else if (bcw[2] <= 0.0f)
+			{
+				cornerArea.x = -0.25f * l2[1] * area /
+					glm::dot(e[2], e[1]);
+				cornerArea.y = -0.25f * l2[0] * area /
+					glm::dot(e[2], e[0]);
+				cornerArea.z = area - cornerArea.x - cornerArea.y;
+			}
+			else
+			{
+				float scale = 0.5f * area / (bcw[0] + bcw[1] + bcw[2]);
+				cornerArea.x = scale * (bcw[1] + bcw[2]);
+				cornerArea.y = scale * (bcw[2] + bcw[0]);
+				cornerArea.z = scale * (bcw[0] + bcw[1]);
+			}
+			cornerAreas[i] = cornerArea;
+		}
+	});
+
+	// Gather corner areas per vertex, so that every vertex is written by one thread only
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			float pointArea = 0.0f;
+			ForEachVertexCorner(adjacentFaces[i], faces, i, [&](unsigned int f, int j)
+			{
+				pointArea += cornerAreas[f][j];
+			});
+			geometry.pointAreas[i] = pointArea;
+		}
+	});
+
+	validCurvatureStages |= CURVATURE_POINT_AREAS;
+}
+void Mesh::CalculatePrincipalCurvatures()
 {
-	CalculatePrincipalCurvatures();
+	if (IsCurvatureStageValid(CURVATURE_PRINCIPAL))
+		return;
+	CalculatePointAreas();
 
 	// Resize the arrays we'll be using
-	int nv = vertices.size(), nf = faces.size();
-	std::array<unsigned int, 3> face;
-
-	// Compute dcurv per-face
-	for (int i = 0; i < nf; i++)
-	{
-		face = faces[i];
-		// Edges
-		glm::vec3 e[3] = { vertices[face[2]].position - vertices[face[1]].position,
-			vertices[face[0]].position - vertices[face[2]].position,
-			vertices[face[1]].position - vertices[face[0]].position };
-
-		// N-T-B coordinate system per face
-		glm::vec3 t = e[0];
-		t = glm::normalize(t);
-		glm::vec3 n = glm::cross(e[0], e[1]);
-		glm::vec3 b = glm::cross(n, t);
-		b = glm::normalize(b);
-
-		// Project curvature tensor from each vertex into this
-		// face's coordinate system
-		glm::vec3 fcurv[3];
-		for (int j = 0; j < 3; j++)
+	int nv = geometry.GetVertexCount(), nf = faces.size();
+	std::vector<glm::vec3> cornerCurvatures(3 * nf); // weighted (curv1, curv12, curv2) per corner
+	std::vector<float> curv12(nv);
+	std::vector<unsigned char> faceValid(nf);
+
+	// Set up an initial coordinate system per vertex
+	// (the edge leaving the vertex in the last face that references it)
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
 		{
-			int vj = face[j];
-			proj_curv(vertices[vj].pdir1, vertices[vj].pdir2, vertices[vj].curv1, 0, vertices[vj].curv2,
-				t, b, fcurv[j].x, fcurv[j].y, fcurv[j].z);
+			ForEachVertexCorner(adjacentFaces[i], faces, i, [&](unsigned int f, int j)
+			{
+				const std::array<unsigned int, 3>& face = faces[f];
+				geometry.pdir1[i] = geometry.positions[face[(j + 1) % 3]] - geometry.positions[face[j]];
+			});
+
+			geometry.pdir1[i] = glm::cross(geometry.pdir1[i], geometry.normals[i]);
+			geometry.pdir1[i] = glm::normalize(geometry.pdir1[i]);
+			geometry.pdir2[i] = glm::cross(geometry.normals[i], geometry.pdir1[i]);
 		}
+	});
 
-		// Estimate dcurv based on variation of curvature along edges
-		float m[4] = { 0, 0, 0, 0 };
-		float w[4][4] = { {0,0,0,0}, {0,0,0,0}, {0,0,0,0}, {0,0,0,0} };
-		for (int j = 0; j < 3; j++)
+	// Compute curvature per-face, whole batches with the SIMD kernels and the rest here
+	CurvatureKernelInput kernelInput = GetCurvatureKernelInput();
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		int first = ComputeFaceCurvaturesSimd(kernelInput, begin, end, cornerCurvatures.data(), faceValid.data());
+		for (int i = first; i < end; i++)
 		{
-			// Variation of curvature along each edge
-			unsigned int faceAddress0 = static_cast<unsigned int>((j + 2) % 3);
-			unsigned int faceAddress1 = static_cast<unsigned int>((j + 1) % 3);
-			glm::vec3 dfcurv = fcurv[faceAddress0] - fcurv[faceAddress1];
-			float u = glm::dot(e[j], t);
-			float v = glm::dot(e[j], b);
-			// std::cout << u << ' ' << v << '\n';
-			float u2 = u * u, v2 = v * v, uv = u * v;
-			w[0][0] += u2;
-			w[0][1] += uv;
-			w[3][3] += v2;
-			// All the below are computed at the end of the loop
-			// w[1][1] += 2.0f*u2 + v2;
-			// w[1][2] += 2.0f*uv;
-			// w[2][2] += u2 + 2.0f*v2;
-			// w[2][3] += uv;
-			m[0] += u * dfcurv.x;
-			m[1] += v * dfcurv.x + 2.0f * u * dfcurv.y;
-			m[2] += 2.0f * v * dfcurv.y + u * dfcurv.z;
-			m[3] += v * dfcurv.z;
+			// Edges
+			const std::array<unsigned int, 3>& face = faces[i];
+			glm::vec3 e[3] = { geometry.positions[face[2]] - geometry.positions[face[1]],
+				geometry.positions[face[0]] - geometry.positions[face[2]],
+				geometry.positions[face[1]] - geometry.positions[face[0]] };
+
+			// N-T-B coordinate system per face
+			glm::vec3 t = e[0];
+			t = glm::normalize(t);
+			glm::vec3 n = glm::cross(e[0], e[1]);
+			glm::vec3 b = glm::cross(n, t);
+			b = glm::normalize(b);
+
+			// Estimate curvature based on variation of normals
+			// along edges
+			float m[3] = { 0, 0, 0 };
+			float w[3][3] = { {0,0,0}, {0,0,0}, {0,0,0} };
+			for (int j = 0; j < 3; j++)
+			{
+				float u = glm::dot(e[j], t);
+				float v = glm::dot(e[j], b);
+				w[0][0] += u * u;
+				w[0][1] += u * v;
+				w[2][2] += v * v;
+				// The below are computed once at the end of the loop
+				// w[1][1] += v*v + u*u;
+				// w[1][2] += u*v;
+				unsigned int faceAddress0 = static_cast<unsigned int>((j + 2) % 3);
+				unsigned int faceAddress1 = static_cast<unsigned int>((j + 1) % 3);
+				glm::vec3 dn = geometry.normals[face[faceAddress0]] - geometry.normals[face[faceAddress1]]; // PREV_MOD3: (j - 1) % 3, NEXT_MOD3: (j + 1) % 3
+				float dnu = glm::dot(dn, t);
+				float dnv = glm::dot(dn, b);
+				m[0] += dnu * u;
+				m[1] += dnu * v + dnv * u;
+				m[2] += dnv * v;
+			}
+			w[1][1] = w[0][0] + w[2][2];
+			w[1][2] = w[0][1];
+
+			// Least squares solution
+			float diag[3];
+			if (!ldltdc<float, 3>(w, diag))
+			{
+				//dprintf("ldltdc failed!\n");
+				faceValid[i] = 0;
+				continue;
+			}
+			ldltsl<float, 3>(w, diag, m, m);
+			faceValid[i] = 1;
+
+			// Project into each vertex's frame, weighted by the corner's share of the point area
+			for (int j = 0; j < 3; j++)
+			{
+				int vj = face[j];
+				float c1, c12, c2;
+				proj_curv(t, b, m[0], m[1], m[2],
+					geometry.pdir1[vj], geometry.pdir2[vj], c1, c12, c2);
+				float wt = cornerAreas[i][j] / geometry.pointAreas[vj];
+				cornerCurvatures[3 * i + j] = glm::vec3(wt * c1, wt * c12, wt * c2);
+			}
 		}
-		w[1][1] = 2.0f * w[0][0] + w[3][3];
-		w[1][2] = 2.0f * w[0][1];
-		w[2][2] = w[0][0] + 2.0f * w[3][3];
-		w[2][3] = w[0][1];
-
-		// Least squares solution
-		float d[4];
-		if (!ldltdc<float, 4>(w, d))
+	});
+
+	// Push it back out to the vertices and compute principal directions and curvatures at each vertex
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
 		{
-			//dprintf("ldltdc failed!\n");
-			continue;
+			float curv1 = 0.0f, sum12 = 0.0f, curv2 = 0.0f;
+			ForEachVertexCorner(adjacentFaces[i], faces, i, [&](unsigned int f, int j)
+			{
+				if (!faceValid[f])
+					return;
+				const glm::vec3& c = cornerCurvatures[3 * f + j];
+				curv1 += c.x;
+				sum12 += c.y;
+				curv2 += c.z;
+			});
+			geometry.curv1[i] = curv1;
+			curv12[i] = sum12;
+			geometry.curv2[i] = curv2;
 		}
-		ldltsl<float, 4>(w, d, m, m);
 
-		glm::vec4 face_dcurv = glm::vec4(m[0], m[1], m[2], m[3]);
+		int first = DiagonalizeCurvaturesSimd(begin, end, geometry.normals.data(), curv12.data(),
+			geometry.pdir1.data(), geometry.pdir2.data(), geometry.curv1.data(), geometry.curv2.data());
+		for (int i = first; i < end; i++)
+		{
+			diagonalize_curv(geometry.pdir1[i], geometry.pdir2[i],
+				geometry.curv1[i], curv12[i], geometry.curv2[i],
+				geometry.normals[i], geometry.pdir1[i], geometry.pdir2[i],
+				geometry.curv1[i], geometry.curv2[i]);
+		}
+	});
 
-		// Push it back out to each vertex
-		for (int j = 0; j < 3; j++)
+	validCurvatureStages |= CURVATURE_PRINCIPAL;
+}
+
+void Mesh::CalculateDerivativeCurvature()
+{
+	if (IsCurvatureStageValid(CURVATURE_DERIVATIVE))
+		return;
+	CalculatePrincipalCurvatures();
+
+	// Resize the arrays we'll be using
+	int nv = geometry.GetVertexCount(), nf = faces.size();
+	std::vector<glm::vec4> cornerDerivatives(3 * nf); // weighted dcurv per corner
+	std::vector<unsigned char> faceValid(nf);
+
+	// Compute dcurv per-face, whole batches with the SIMD kernels and the rest here
+	CurvatureKernelInput kernelInput = GetCurvatureKernelInput();
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		int first = ComputeFaceDerivativeCurvaturesSimd(kernelInput, begin, end, cornerDerivatives.data(), faceValid.data());
+		for (int i = first; i < end; i++)
+		{
+			const std::array<unsigned int, 3>& face = faces[i];
+			// Edges
+			glm::vec3 e[3] = { geometry.positions[face[2]] - geometry.positions[face[1]],
+				geometry.positions[face[0]] - geometry.positions[face[2]],
+				geometry.positions[face[1]] - geometry.positions[face[0]] };
+
+			// N-T-B coordinate system per face
+			glm::vec3 t = e[0];
+			t = glm::normalize(t);
+			glm::vec3 n = glm::cross(e[0], e[1]);
+			glm::vec3 b = glm::cross(n, t);
+			b = glm::normalize(b);
+
+			// Project curvature tensor from each vertex into this
+			// face's coordinate system
+			glm::vec3 fcurv[3];
+			for (int j = 0; j < 3; j++)
+			{
+				int vj = face[j];
+				proj_curv(geometry.pdir1[vj], geometry.pdir2[vj], geometry.curv1[vj], 0, geometry.curv2[vj],
+					t, b, fcurv[j].x, fcurv[j].y, fcurv[j].z);
+			}
+
+			// Estimate dcurv based on variation of curvature along edges
+			float m[4] = { 0, 0, 0, 0 };
+			float w[4][4] = { {0,0,0,0}, {0,0,0,0}, {0,0,0,0}, {0,0,0,0} };
+			for (int j = 0; j < 3; j++)
+			{
+				// Variation of curvature along each edge
+				unsigned int faceAddress0 = static_cast<unsigned int>((j + 2) % 3);
+				unsigned int faceAddress1 = static_cast<unsigned int>((j + 1) % 3);
+				glm::vec3 dfcurv = fcurv[faceAddress0] - fcurv[faceAddress1];
+				float u = glm::dot(e[j], t);
+				float v = glm::dot(e[j], b);
+				float u2 = u * u, v2 = v * v, uv = u * v;
+				w[0][0] += u2;
+				w[0][1] += uv;
+				w[3][3] += v2;
+				// All the below are computed at the end of the loop
+				// w[1][1] += 2.0f*u2 + v2;
+				// w[1][2] += 2.0f*uv;
+				// w[2][2] += u2 + 2.0f*v2;
+				// w[2][3] += uv;
+				m[0] += u * dfcurv.x;
+				m[1] += v * dfcurv.x + 2.0f * u * dfcurv.y;
+				m[2] += 2.0f * v * dfcurv.y + u * dfcurv.z;
+				m[3] += v * dfcurv.z;
+			}
+			w[1][1] = 2.0f * w[0][0] + w[3][3];
+			w[1][2] = 2.0f * w[0][1];
+			w[2][2] = w[0][0] + 2.0f * w[3][3];
+			w[2][3] = w[0][1];
+
+			// Least squares solution
+			float d[4];
+			if (!ldltdc<float, 4>(w, d))
+			{
+				//dprintf("ldltdc failed!\n");
+				faceValid[i] = 0;
+				continue;
+			}
+			ldltsl<float, 4>(w, d, m, m);
+			faceValid[i] = 1;
+
+			glm::vec4 face_dcurv = glm::vec4(m[0], m[1], m[2], m[3]);
+
+			// Project into each vertex's frame
+			for (int j = 0; j < 3; j++)
+			{
+				int vj = face[j];
+				glm::vec4 this_vert_dcurv;
+				proj_dcurv(t, b, face_dcurv,
+					geometry.pdir1[vj], geometry.pdir2[vj], this_vert_dcurv);
+				float wt = cornerAreas[i][j] / geometry.pointAreas[vj];
+				cornerDerivatives[3 * i + j] = wt * this_vert_dcurv;
+			}
+		}
+	});
+
+	// Push it back out to each vertex
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
 		{
-			int vj = face[j];
-			glm::vec4 this_vert_dcurv;
-			proj_dcurv(t, b, face_dcurv,
-				vertices[vj].pdir1, vertices[vj].pdir2, this_vert_dcurv);
-			float wt = cornerAreas[i][j] / vertices[vj].pointArea;
-			vertices[vj].dcurv += wt * this_vert_dcurv;
+			glm::vec4 dcurv = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+			ForEachVertexCorner(adjacentFaces[i], faces, i, [&](unsigned int f, int j)
+			{
+				if (faceValid[f])
+					dcurv += cornerDerivatives[3 * f + j];
+			});
+			geometry.dcurv[i] = dcurv;
 		}
-	}
+	});
+
+	validCurvatureStages |= CURVATURE_DERIVATIVE;
 }
 
 static void rot_coord_sys(const glm::vec3& old_u, const glm::vec3& old_v,
@@ -449,9 +1130,9 @@ void diagonalize_curv(const glm::vec3& old_u, const glm::vec3& old_v,
 		// Jacobi rotation to diagonalize
 		float h = 0.5f * (kv - ku) / kuv;
 		tt = (h < 0.0f) ?
-			1.0f / (h - sqrt(1.0f + h * h)) :
-			1.0f / (h + sqrt(1.0f + h * h));
-		c = 1.0f / sqrt(1.0f + tt * tt);
+			1.0f / (h - std::sqrt(1.0f + h * h)) :
+			1.0f / (h + std::sqrt(1.0f + h * h));
+		c = 1.0f / std::sqrt(1.0f + tt * tt);
 		s = tt * c;
 	}
 
@@ -539,11 +1220,12 @@ static inline void ldltsl(const T(&A)[N][N],
 
 GLuint Mesh::CreateAdjacentFaceCountTexture()
 {
+	// One texel per vertex; vertices past the 256 x 256 texture are not represented
 	unsigned char* adjacentFaceCounts = new unsigned char[256 * 256];
-	int verticesCount = vertices.size();
+	int verticesCount = static_cast<int>(std::min<std::size_t>(adjacentFaces.GetVertexCount(), 256 * 256));
 	for (int i = 0; i < verticesCount; i++)
 	{
-		adjacentFaceCounts[i] = adjacentFaces[i].size();
+		adjacentFaceCounts[i] = adjacentFaces.GetFaceCount(i);
 	}
 	for (int i = verticesCount; i < 256 * 256; i++)
 	{
@@ -561,5 +1243,29 @@ GLuint Mesh::CreateAdjacentFaceCountTexture()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	delete[] adjacentFaceCounts;
 
+	return textureID;
+}
+GLuint Mesh::CreateAdjacentFaceTexture()
+{
+	// Offsets and face indices share one buffer, so a shader can walk the faces of vertex v with
+	// texelFetch(adjacentFaces, int(nv) + 1 + k) for k in [texelFetch(v), texelFetch(v + 1))
+	const auto& offsets = adjacentFaces.GetOffsets();
+	const auto& faceIndices = adjacentFaces.GetFaceIndices();
+	std::size_t offsetBytes = offsets.size() * sizeof(unsigned int);
+	std::size_t faceBytes = faceIndices.size() * sizeof(unsigned int);
+
+	glGenBuffers(1, &adjacentFaceBufferID);
+	glBindBuffer(GL_TEXTURE_BUFFER, adjacentFaceBufferID);
+	glBufferData(GL_TEXTURE_BUFFER, offsetBytes + faceBytes, nullptr, GL_STATIC_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, offsetBytes, offsets.data());
+	glBufferSubData(GL_TEXTURE_BUFFER, offsetBytes, faceBytes, faceIndices.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, adjacentFaceBufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
 	return textureID;
 }
\ No newline at end of file
@@ -1,32 +1,31 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstring>
+#include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/norm.hpp>
 #include <string>
 #include <vector>
+#include "adjacency.h"
+#include "apparentridges.h"
+#include "bvh.h"
+#include "curvaturesimd.h"
+#include "dynamicbuffer.h"
+#include "meshgeometry.h"
+#include "edgetopology.h"
+#include "materialpool.h"
+#include "meshlet.h"
+#include "meshoptimization.h"
+#include "parallel.h"
 #include "shader.h"
+#include "silhouette.h"
+#include "suggestivecontour.h"
 #include "texture.h"
-
-// vertex (ġ, normal vector, UV coordinates)
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texCoords;
-
-	glm::vec3 cornerArea;
-	float pointArea;
-
-	glm::vec3 pdir1, pdir2;
-	float curv1, curv2;
-	glm::vec4 dcurv;
-
-	float q1;
-	glm::vec2 t1;
-	float dt1q1;
-};
+#include "timer.h"
+#include "vertexformat.h"
 
 // mtlϿ ִ ka(ambient color), kd(diffuse color), ks(specular color)
 struct Material
@@ -36,35 +35,205 @@ struct Material
 	glm::vec3 ks;
 };
 
+// Curvature products derived from positions and normals. Each stage depends on the ones above it:
+// point areas -> principal curvatures -> derivative of curvature
+enum CurvatureStage : unsigned int
+{
+	CURVATURE_POINT_AREAS = 1 << 0,
+	CURVATURE_PRINCIPAL = 1 << 1,
+	CURVATURE_DERIVATIVE = 1 << 2,
+
+	CURVATURE_ALL = CURVATURE_POINT_AREAS | CURVATURE_PRINCIPAL | CURVATURE_DERIVATIVE
+};
+
+// A contiguous range of a mesh's indices with the bounds of its triangles; the unit of frustum culling
+struct MeshPart
+{
+	BoundingBox bounds; // object space
+	GLuint firstIndex;
+	GLsizei indexCount;
+};
+
+// When set, each Mesh frees its CPU copy of the geometry once it has been uploaded by the first Draw
+void SetReleaseCpuMeshData(bool release);
+bool GetReleaseCpuMeshData();
+
+// Sampler handles for textures named texture_diffuse1, texture_diffuse2, ..., texture_specular1, ... in order
+std::vector<UniformHandle<int>> ResolveTextureSamplers(const Shader& shader, const std::vector<Texture>& textures);
+
+// Owns its arrays; it can be moved but not copied
 class Mesh
 {
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<std::array<unsigned int, 3>> faces, std::vector<unsigned int> indices, 
-		std::vector<std::vector<unsigned int>> adjacentFaces, std::vector<Texture> textures, Material mat);
-	void Draw(const Shader& shader);
+	// cornerAreas and validCurvatureStages describe curvature that is already present in geometry
+	// (e.g. loaded from the mesh cache); stages that are not valid are computed here
+	Mesh(MeshGeometry geometry, std::vector<std::array<unsigned int, 3>> faces, std::vector<unsigned int> indices, 
+		VertexFaceAdjacency adjacentFaces, std::vector<Texture> textures, Material mat,
+		std::vector<glm::vec3> cornerAreas = {}, unsigned int validCurvatureStages = 0);
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+	// Draw the parts whose visibleParts entry is nonzero, adjacent ones merged into one range, or every
+	// triangle without visibleParts. Meshlets found back facing by CullMeshlets are left out as well.
+	void Draw(const Shader& shader, const unsigned char* visibleParts = nullptr);
+	// Create the GPU objects and upload the streams the shader reads; Draw does this on first use. GL thread only.
+	void Upload(const Shader& shader);
+	// Delete every GPU object, e.g. before the mesh is dropped. GL thread only.
+	void DeleteGpuObjects();
+	// Silhouette and boundary edges for an eye position in object space, as GL_LINES over the mesh's own
+	// vertices. Only available when silhouette extraction was enabled as the mesh was created.
+	void DrawSilhouettes(const Shader& shader, const glm::vec3& eye);
+	// The faces with their neighbours as GL_TRIANGLES_ADJACENCY, for geometry shader silhouettes.
+	// Only available when silhouette extraction was enabled as the mesh was created.
+	void DrawWithAdjacency(const Shader& shader);
+	const SilhouetteStatistics& GetSilhouetteStatistics() const;
+	// Suggestive contours seen from eye (object space), extracted on the CPU and drawn as GL_LINES with the
+	// position at location 0 and the alpha at location 1. Needs the CPU geometry; nothing is drawn after ReleaseCpuData.
+	void DrawSuggestiveContours(const glm::vec3& eye, const SuggestiveContourOptions& options);
+	// Draw the triangles with a shader that extracts the contours itself (suggestivecontour.gshader),
+	// after setting its featureSize uniform
+	void DrawSuggestiveContoursGpu(const Shader& shader);
+	const SuggestiveContourStatistics& GetSuggestiveContourStatistics() const; // of the last DrawSuggestiveContours
+	// Bring q1, t1 and dt1q1 up to date for eye (object space) and stream the vertices that changed into the
+	// view dependent attributes. Needs the CPU geometry and apparent ridges enabled as the mesh was created.
+	void UpdateApparentRidges(const glm::vec3& eye, float viewTolerance);
+	// Draw the triangles with a shader that reads the view dependent attributes (apparentridge.gshader),
+	// after setting its featureSize uniform
+	void DrawApparentRidges(const Shader& shader);
+	const ApparentRidgeStatistics& GetApparentRidgeStatistics() const; // of the last UpdateApparentRidges
+	// Classify the meshlets for eye (object space); until the next call Draw, the line passes drawn through it
+	// and DrawSuggestiveContours skip the back facing ones. Only if meshlet culling was enabled as the mesh was created.
+	void CullMeshlets(const glm::vec3& eye);
+	const MeshletStatistics& GetMeshletStatistics() const; // of the last CullMeshlets
+
+
+	// Compute the curvature products that are missing; stages that are still valid are not recomputed
+	void UpdateCurvatures();
+	// Likewise, but only the curvature stages: the line stages keep the feature sizes they measured before
+	void UpdateCurvatureStages();
+	// Must be called after positions or normals change, so that every curvature stage is recomputed
+	void InvalidateGeometry();
+	bool IsCurvatureStageValid(CurvatureStage stage) const;
+
+	// Upload every attribute stream, then free the CPU side geometry, topology and adjacency.
+	// Needs a current GL context. Afterwards the curvature can no longer be recomputed.
+	void ReleaseCpuData();
+	bool IsCpuDataReleased() const;
+
+	const MeshGeometry& GetGeometry() const;
+	const std::vector<std::array<unsigned int, 3>>& GetFaces() const;
+	const std::vector<unsigned int>& GetIndices() const;
+	const VertexFaceAdjacency& GetAdjacentFaces() const;
+	const std::vector<glm::vec3>& GetCornerAreas() const;
+	const std::vector<Texture>& GetTextures() const;
+	const Material& GetMaterial() const;
+	double GetCurvatureMilliseconds() const; // time the constructor spent computing curvature
+	// Replace the textures, e.g. with the GL textures created after loading on another thread
+	void SetTextures(std::vector<Texture> textures);
+
+	// GPU objects, e.g. for packing into a MeshBatch; valid once Upload has run for a shader reading the stream
+	GLuint GetAttributeBufferID(VertexAttribute attribute) const;
+	GLuint GetElementBufferID() const;
+	unsigned int GetMaterialSlot() const; // in GetMaterialPool()
+	// Add the material to the pool again if the pool was reset since the slot was assigned. GL thread only.
+	void UpdateMaterialSlot();
+	GLsizei GetVertexCount() const; // also after ReleaseCpuData
+	GLsizei GetIndexCount() const;
+	// Computed as the mesh is created and kept after ReleaseCpuData
+	const std::vector<MeshPart>& GetParts() const;
+	const BoundingBox& GetBounds() const;
+	// Ranges of the compact vertex format; the mesh's own until replaced, e.g. by the model's. Streams already
+	// uploaded are encoded again, so it must be set before ReleaseCpuData.
+	void SetVertexQuantization(const VertexQuantization& quantization);
+	const VertexQuantization& GetVertexQuantization() const;
 private:
-	std::vector<Vertex> vertices; // vertex 
+	MeshGeometry geometry; // per vertex attributes (structure of arrays)
 	std::vector<std::array<unsigned int, 3>> faces; // face 
-	std::vector<std::vector<unsigned int>> adjacentFaces;
+	VertexFaceAdjacency adjacentFaces;
 	std::vector<glm::vec3> cornerAreas;
 	std::vector<unsigned int> indices; // index 
 	std::vector<Texture> textures; // texture 
 	Material mat; // mtl   
 	
 	GLuint vertexArrayID;
-	GLuint vertexBufferID;
+	GLuint attributeBufferIDs[VERTEX_ATTRIBUTE_COUNT]; // one buffer per attribute stream, 0 if not uploaded
 	GLuint elementBufferID;
-	GLuint uniformBlockIndexID;
+	unsigned int materialSlot; // of mat in GetMaterialPool()
+	unsigned int materialGeneration; // GetMaterialPool().GetGeneration() materialSlot belongs to
+	unsigned int uploadedAttributeMask; // VertexAttribute bits whose GPU stream is current
+	VertexQuantization vertexQuantization;
+
+	unsigned int validCurvatureStages; // CurvatureStage bits that are up to date
+	GLsizei indexCount; // kept for drawing after the CPU data is released
+	GLsizei vertexCount; // likewise
+	std::vector<MeshPart> parts;
+	BoundingBox bounds;
+	std::vector<GLsizei> drawRangeCounts; // index ranges of the last culled Draw
+	std::vector<const void*> drawRangeOffsets;
+
+	// Meshlets (only if meshlet culling is enabled); the faces and indices are then in meshlet order
+	MeshletSet meshlets;
+	std::vector<unsigned char> meshletFacing; // MeshletFacing per meshlet, from the last CullMeshlets
+	MeshletStatistics meshletStatistics;
+	std::vector<unsigned int> contourFaces; // of the meshlets not back facing, for the CPU contours
+	double curvatureMilliseconds;
+	bool cpuDataReleased;
+
+	GLuint handleProgramID; // program the handles below were resolved for
+	std::vector<UniformHandle<int>> textureSamplerHandles; // one per texture
+	VertexFormatHandles vertexFormatHandles;
 
 	GLuint adjacentFaceCountID;
-	GLuint adjacentFaceID;
+	GLuint adjacentFaceBufferID; // CSR adjacency: offsets (nv + 1) followed by the face indices
+	GLuint adjacentFaceID; // GL_TEXTURE_BUFFER (GL_R32UI) view of adjacentFaceBufferID
+
+	// Edges, silhouettes and the GL_TRIANGLES_ADJACENCY indices (built only if silhouette extraction is enabled)
+	EdgeTopology edgeTopology;
+	SilhouetteExtractor silhouetteExtractor;
+	std::vector<unsigned int> silhouetteIndices; // of the last DrawSilhouettes
+	SilhouetteStatistics silhouetteStatistics;
+	GLuint silhouetteElementBufferID;
+	GLuint adjacencyElementBufferID;
+	GLsizei adjacencyIndexCount;
+
+	void BuildSilhouetteStructures();
+
+	// Suggestive contours (feature size measured only if a SuggestiveContourMode is set)
+	SuggestiveContourExtractor suggestiveContours;
+	std::vector<SuggestiveContourVertex> contourVertices; // of the last DrawSuggestiveContours
+	SuggestiveContourStatistics contourStatistics;
+	GLuint contourVertexArrayID;
+	GLuint contourBufferID;
+	UniformHandle<float> featureSizeHandle;
+
+	// Apparent ridges (only if enabled). The view dependent stream is a triple buffered DynamicBuffer; each frame
+	// only the ranges of apparentRidgeStaging its region has not seen yet are copied into it.
+	ApparentRidgeStage apparentRidges;
+	ApparentRidgeStatistics apparentRidgeStatistics;
+	std::vector<ApparentRidgeVertex> apparentRidgeStaging; // every vertex, as last computed
+	DynamicBuffer apparentRidgeBuffer;
+	std::size_t apparentRidgeBoundOffset; // region the VAO's ridge attributes point at
+
+	void BuildViewDependentStages(); // measure the feature sizes of the enabled line stages
+	void CreateApparentRidgeBuffer();
+	void BindApparentRidgeAttributes(); // to apparentRidgeBuffer's read region
 
+	// Upload the attribute streams in attributeMask that are not on the GPU yet
+	void UploadAttributes(unsigned int attributeMask);
+	void ResolveShaderHandles(const Shader& shader);
+	void SetVertexFormatUniforms(const Shader& shader); // resolving the handles first if needed
+	void BuildMeshlets(); // and put the faces, their corner areas and adjacency, and the indices in meshlet order
+	void BuildParts();
+	void DrawTriangles(const unsigned char* visibleParts); // the parts and meshlets not culled; VAO bound
 	void SetupMesh(); // Mesh 
+	// Each stage computes its dependencies first and does nothing if it is already valid
 	void CalculatePointAreas();
 	void CalculatePrincipalCurvatures(); // principal curvatures 
 	void CalculateDerivativeCurvature();
+	CurvatureKernelInput GetCurvatureKernelInput() const;
 	GLuint CreateAdjacentFaceCountTexture();
-	// GLuint CreateAdjacentFaceTexture(); // adjacent face texture 
+	GLuint CreateAdjacentFaceTexture(); // adjacent face texture buffer
 };
 
 // Principal Curvatures
@@ -0,0 +1,334 @@
+#include "meshbatch.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "timer.h"
+
+// Texture unit of the material pool; the meshes' own textures take units 0, 1, ... as in Mesh::Draw
+static const int materialTextureUnit = 15;
+
+static bool meshBatchingEnabled = false;
+
+void SetMeshBatchingEnabled(bool enabled)
+{
+	meshBatchingEnabled = enabled;
+}
+bool IsMeshBatchingEnabled()
+{
+	return meshBatchingEnabled;
+}
+
+static bool SameTextures(std::vector<Texture>& a, std::vector<Texture>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (std::size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].GetTextureID() != b[i].GetTextureID() || a[i].GetType() != b[i].GetType())
+			return false;
+	}
+	return true;
+}
+
+bool MeshBatch::Build(std::vector<Mesh>& meshes, const Shader& shader)
+{
+	Destroy();
+	if (meshes.empty())
+		return false;
+
+	Timer buildTimer;
+	// One set of decode uniforms serves every mesh, so they must all be quantized alike
+	for (const auto& mesh : meshes)
+	{
+		if (GetVertexFormat() == VERTEX_FORMAT_COMPACT && mesh.GetVertexQuantization() != meshes[0].GetVertexQuantization())
+		{
+			std::cerr << "ERROR::MESHBATCH::VERTEX_QUANTIZATION_MISMATCH: the meshes are drawn one by one\n";
+			return false;
+		}
+	}
+	quantization = meshes[0].GetVertexQuantization();
+	for (auto& mesh : meshes)
+		mesh.Upload(shader);
+	attributeMask = shader.GetActiveAttributeMask() & ((1u << VERTEX_ATTRIBUTE_COUNT) - 1);
+	meshCount = meshes.size();
+
+	// The arenas hold the meshes in order; baseVertex and firstIndex place each one
+	std::vector<GLint> baseVertices(meshes.size());
+	std::vector<GLuint> firstIndices(meshes.size());
+	std::vector<std::size_t> firstItems(meshes.size()); // of the mesh's parts in visibleParts
+	GLsizeiptr vertexCount = 0, indexCount = 0;
+	std::size_t itemCount = 0;
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		baseVertices[i] = static_cast<GLint>(vertexCount);
+		firstIndices[i] = static_cast<GLuint>(indexCount);
+		firstItems[i] = itemCount;
+		vertexCount += meshes[i].GetVertexCount();
+		indexCount += meshes[i].GetIndexCount();
+		itemCount += meshes[i].GetParts().size();
+	}
+	std::size_t arenaBytes = 0;
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	for (auto a = 0; a != VERTEX_ATTRIBUTE_COUNT; ++a)
+	{
+		if ((attributeMask & (1u << a)) == 0)
+			continue;
+
+		VertexAttribute attribute = static_cast<VertexAttribute>(a);
+		VertexStreamFormat format = GetVertexStreamFormat(GetVertexFormat(), attribute);
+		GLsizeiptr stride = format.stride;
+		glGenBuffers(1, &attributeBufferIDs[a]);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, attributeBufferIDs[a]);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexCount * stride, nullptr, GL_STATIC_DRAW);
+		for (std::size_t i = 0; i < meshes.size(); i++)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].GetAttributeBufferID(attribute));
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, baseVertices[i] * stride,
+				meshes[i].GetVertexCount() * stride);
+		}
+		arenaBytes += vertexCount * stride;
+
+		glBindBuffer(GL_ARRAY_BUFFER, attributeBufferIDs[a]);
+		glEnableVertexAttribArray(a);
+		glVertexAttribPointer(a, format.components, format.type, format.normalized, 0, (void*)0);
+	}
+
+	std::vector<GLuint> materialIndices(vertexCount);
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		meshes[i].UpdateMaterialSlot();
+		std::fill(materialIndices.begin() + baseVertices[i], materialIndices.begin() + baseVertices[i] +
+			meshes[i].GetVertexCount(), meshes[i].GetMaterialSlot());
+	}
+	glGenBuffers(1, &materialIndexBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, materialIndexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, materialIndices.size() * sizeof(GLuint), materialIndices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(ATTRIBUTE_MATERIAL);
+	glVertexAttribIPointer(ATTRIBUTE_MATERIAL, 1, GL_UNSIGNED_INT, 0, (void*)0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	arenaBytes += materialIndices.size() * sizeof(GLuint);
+
+	glGenBuffers(1, &elementBufferID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, elementBufferID);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].GetElementBufferID());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, firstIndices[i] * sizeof(GLuint),
+			meshes[i].GetIndexCount() * sizeof(GLuint));
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferID);
+	glBindVertexArray(0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	arenaBytes += indexCount * sizeof(GLuint);
+
+	// Runs of meshes sharing their textures, in the order the texture sets first appear; the commands are
+	// grouped by run so that each run is one multi-draw
+	std::vector<std::size_t> meshRuns(meshes.size());
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		std::vector<Texture> textures = meshes[i].GetTextures();
+		std::size_t r = 0;
+		while (r < runs.size() && !SameTextures(runs[r].textures, textures))
+			r++;
+		if (r == runs.size())
+		{
+			runs.push_back(Run());
+			runs.back().textures = std::move(textures);
+		}
+		meshRuns[i] = r;
+	}
+	for (std::size_t r = 0; r < runs.size(); r++)
+	{
+		runs[r].firstCommand = commands.size();
+		runs[r].firstPart = parts.size();
+		for (std::size_t i = 0; i < meshes.size(); i++)
+		{
+			if (meshRuns[i] != r || meshes[i].GetIndexCount() == 0)
+				continue;
+			DrawElementsIndirectCommand command = { static_cast<GLuint>(meshes[i].GetIndexCount()), 1,
+				firstIndices[i], baseVertices[i], 0 };
+			commands.push_back(command);
+			const std::vector<MeshPart>& meshParts = meshes[i].GetParts();
+			for (std::size_t p = 0; p < meshParts.size(); p++)
+			{
+				parts.push_back(Part{ firstItems[i] + p, i, firstIndices[i] + meshParts[p].firstIndex,
+					static_cast<GLuint>(meshParts[p].indexCount), baseVertices[i] });
+			}
+		}
+		runs[r].commandCount = commands.size() - runs[r].firstCommand;
+		runs[r].partCount = parts.size() - runs[r].firstPart;
+	}
+
+	if (GLEW_ARB_multi_draw_indirect)
+	{
+		glGenBuffers(1, &indirectBufferID);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBufferID);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(),
+			GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		if (!parts.empty())
+			visibleCommandBuffer.Create(parts.size() * sizeof(DrawElementsIndirectCommand));
+	}
+
+	std::cout << "Batch: " << meshes.size() << " meshes, " << vertexCount << " vertices, " << indexCount / 3
+		<< " triangles in " << runs.size() << " texture runs (" << (indirectBufferID ? "multi-draw indirect" :
+		"base vertex draws") << "), " << arenaBytes / 1024 << " KB, " << buildTimer.ElapsedMilliseconds() << " ms\n";
+	return true;
+}
+bool MeshBatch::HasAttributes(const Shader& shader) const
+{
+	unsigned int streams = shader.GetActiveAttributeMask() & ((1u << VERTEX_ATTRIBUTE_COUNT) - 1);
+	return IsBuilt() && (streams & ~attributeMask) == 0;
+}
+void MeshBatch::Draw(const Shader& shader, const unsigned char* visibleParts, DrawStatistics* statistics)
+{
+	Timer drawTimer;
+	if (handleProgramID != shader.GetProgramID())
+		ResolveShaderHandles(shader);
+
+	MaterialPool& materials = GetMaterialPool();
+	glActiveTexture(GL_TEXTURE0 + materialTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, materials.GetTextureID());
+	shader.Set(materialColorsHandle, materialTextureUnit);
+	shader.Set(materialTexelsHandle, materials.GetSlotTexels());
+	vertexFormatHandles.Set(shader, quantization);
+
+	// Culled, the commands are those of the visible parts, written to the next region of visibleCommandBuffer
+	std::size_t drawnMeshes = meshCount;
+	const DrawElementsIndirectCommand* drawCommands = commands.data();
+	GLuint drawIndirectBufferID = indirectBufferID;
+	std::size_t indirectOffset = 0;
+	if (visibleParts)
+	{
+		drawnMeshes = CollectVisibleCommands(visibleParts);
+		drawCommands = visibleCommands.data();
+		if (visibleCommandBuffer.IsCreated())
+		{
+			std::size_t bytes = visibleCommands.size() * sizeof(DrawElementsIndirectCommand);
+			std::memcpy(visibleCommandBuffer.BeginWrite(), visibleCommands.data(), bytes);
+			visibleCommandBuffer.EndWrite(0, bytes);
+			drawIndirectBufferID = visibleCommandBuffer.GetBufferID();
+			indirectOffset = visibleCommandBuffer.GetReadOffset();
+		}
+	}
+
+	std::size_t drawCalls = 0, triangles = 0;
+	glBindVertexArray(vertexArrayID);
+	if (drawIndirectBufferID)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawIndirectBufferID);
+	for (auto& run : runs)
+	{
+		std::size_t firstCommand = visibleParts ? run.firstVisibleCommand : run.firstCommand;
+		std::size_t commandCount = visibleParts ? run.visibleCommandCount : run.commandCount;
+		if (commandCount == 0)
+			continue;
+		for (std::size_t c = firstCommand; c < firstCommand + commandCount; c++)
+			triangles += drawCommands[c].count / 3;
+
+		for (std::size_t i = 0; i < run.textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+			shader.Set(run.samplerHandles[i], static_cast<int>(i));
+			glBindTexture(GL_TEXTURE_2D, run.textures[i].GetTextureID());
+		}
+
+		if (drawIndirectBufferID)
+		{
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				reinterpret_cast<void*>(indirectOffset + firstCommand * sizeof(DrawElementsIndirectCommand)),
+				static_cast<GLsizei>(commandCount), 0);
+			drawCalls++;
+			continue;
+		}
+		for (std::size_t c = firstCommand; c < firstCommand + commandCount; c++)
+		{
+			glDrawElementsBaseVertex(GL_TRIANGLES, drawCommands[c].count, GL_UNSIGNED_INT,
+				reinterpret_cast<void*>(drawCommands[c].firstIndex * sizeof(GLuint)), drawCommands[c].baseVertex);
+			drawCalls++;
+		}
+	}
+	if (drawIndirectBufferID)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+	if (visibleParts)
+		visibleCommandBuffer.FenceRead();
+
+	if (statistics)
+	{
+		statistics->meshes = drawnMeshes;
+		statistics->drawCalls = drawCalls;
+		statistics->triangles = triangles;
+		statistics->milliseconds = drawTimer.ElapsedMilliseconds();
+	}
+}
+void MeshBatch::Destroy()
+{
+	// Never built: no GL objects, and possibly no context (a Model that was only loaded)
+	if (vertexArrayID != 0)
+	{
+		glDeleteVertexArrays(1, &vertexArrayID);
+		for (auto i = 0; i != VERTEX_ATTRIBUTE_COUNT; ++i)
+		{
+			if (attributeBufferIDs[i] != 0)
+				glDeleteBuffers(1, &attributeBufferIDs[i]);
+			attributeBufferIDs[i] = 0;
+		}
+		glDeleteBuffers(1, &materialIndexBufferID);
+		glDeleteBuffers(1, &elementBufferID);
+		glDeleteBuffers(1, &indirectBufferID);
+		visibleCommandBuffer.Destroy();
+	}
+
+	vertexArrayID = 0;
+	materialIndexBufferID = 0;
+	elementBufferID = 0;
+	indirectBufferID = 0;
+	attributeMask = 0;
+	meshCount = 0;
+	commands.clear();
+	runs.clear();
+	parts.clear();
+	visibleCommands.clear();
+	handleProgramID = 0;
+}
+std::size_t MeshBatch::CollectVisibleCommands(const unsigned char* visibleParts)
+{
+	visibleCommands.clear();
+	std::size_t visibleMeshes = 0;
+	for (auto& run : runs)
+	{
+		run.firstVisibleCommand = visibleCommands.size();
+		const Part* previous = nullptr; // last visible part
+		for (std::size_t p = run.firstPart; p < run.firstPart + run.partCount; p++)
+		{
+			const Part& part = parts[p];
+			if (!visibleParts[part.item])
+				continue;
+			if (!previous || previous->mesh != part.mesh)
+				visibleMeshes++;
+			DrawElementsIndirectCommand* last = visibleCommands.empty() ? nullptr : &visibleCommands.back();
+			if (previous && previous->mesh == part.mesh && visibleCommands.size() > run.firstVisibleCommand &&
+				last->firstIndex + last->count == part.firstIndex)
+				last->count += part.count;
+			else
+				visibleCommands.push_back(DrawElementsIndirectCommand{ part.count, 1, part.firstIndex, part.baseVertex, 0 });
+			previous = &part;
+		}
+		run.visibleCommandCount = visibleCommands.size() - run.firstVisibleCommand;
+	}
+	return visibleMeshes;
+}
+void MeshBatch::ResolveShaderHandles(const Shader& shader)
+{
+	for (auto& run : runs)
+		run.samplerHandles = ResolveTextureSamplers(shader, run.textures);
+	materialColorsHandle = shader.GetUniformHandle<int>("materialColors");
+	materialTexelsHandle = shader.GetUniformHandle<int>("materialTexels");
+	vertexFormatHandles.Resolve(shader);
+	handleProgramID = shader.GetProgramID();
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include "dynamicbuffer.h"
+#include "mesh.h"
+#include "shader.h"
+#include "texture.h"
+#include "vertexformat.h"
+
+// Models are drawn through a MeshBatch when set; the renderer then uses batch.vshader
+void SetMeshBatchingEnabled(bool enabled);
+bool IsMeshBatchingEnabled();
+
+// Cost of submitting a model's surfaces, measured by Model::Draw
+struct DrawStatistics
+{
+	std::size_t meshes; // drawn, i.e. with a part in the frustum when culled
+	std::size_t drawCalls; // a glMultiDrawElementsIndirect counts once
+	std::size_t triangles; // submitted, before meshlet culling
+	double milliseconds; // CPU time of the submission
+};
+
+// All meshes of a model packed into shared vertex and index arenas, drawn with one glMultiDrawElementsIndirect
+// per texture set (GL 4.3 / ARB_multi_draw_indirect) or, without it, one glDrawElementsBaseVertex per mesh
+// with no state changes in between. Each vertex carries its mesh's material slot (ATTRIBUTE_MATERIAL), and
+// batch.vshader reads the colours from the MaterialPool's texture buffer view instead of the Mat block.
+// The arenas are filled by copying the meshes' GPU streams (in the current VertexFormat, with the quantization
+// the meshes share), so the meshes may have released their CPU data.
+// A culled Draw rebuilds the commands from the visible MeshParts into a DynamicBuffer instead.
+class MeshBatch
+{
+public:
+	MeshBatch() = default;
+	MeshBatch(const MeshBatch&) = delete;
+	MeshBatch& operator=(const MeshBatch&) = delete;
+
+	// Upload the meshes for shader and pack the streams it reads. GL thread only.
+	bool Build(std::vector<Mesh>& meshes, const Shader& shader);
+	bool IsBuilt() const { return vertexArrayID != 0; }
+	bool HasAttributes(const Shader& shader) const; // every stream the shader reads is packed
+	// Draw every mesh, or only the parts whose visibleParts entry is nonzero (indexed by the meshes' parts in
+	// order, as in Model's BVH); the shader must be in use
+	void Draw(const Shader& shader, const unsigned char* visibleParts = nullptr, DrawStatistics* statistics = nullptr);
+	void Destroy(); // GL thread only
+private:
+	// Layout of the commands read from GL_DRAW_INDIRECT_BUFFER
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+	// A mesh part placed in the arenas
+	struct Part
+	{
+		std::size_t item; // index into visibleParts
+		std::size_t mesh;
+		GLuint firstIndex;
+		GLuint count;
+		GLint baseVertex;
+	};
+	// Consecutive commands of meshes with the same textures, and their parts in the same order
+	struct Run
+	{
+		std::vector<Texture> textures;
+		std::vector<UniformHandle<int>> samplerHandles; // one per texture
+		std::size_t firstCommand;
+		std::size_t commandCount;
+		std::size_t firstPart;
+		std::size_t partCount;
+		std::size_t firstVisibleCommand; // in visibleCommands, as of the last culled Draw
+		std::size_t visibleCommandCount;
+	};
+
+	GLuint vertexArrayID = 0;
+	GLuint attributeBufferIDs[VERTEX_ATTRIBUTE_COUNT] = {};
+	GLuint materialIndexBufferID = 0;
+	GLuint elementBufferID = 0;
+	GLuint indirectBufferID = 0; // 0 without ARB_multi_draw_indirect
+	unsigned int attributeMask = 0;
+	std::size_t meshCount = 0;
+	VertexQuantization quantization; // shared by the meshes
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<Run> runs;
+	std::vector<Part> parts; // by run
+	std::vector<DrawElementsIndirectCommand> visibleCommands; // of the last culled Draw
+	DynamicBuffer visibleCommandBuffer; // visibleCommands for glMultiDrawElementsIndirect
+
+	GLuint handleProgramID = 0;
+	UniformHandle<int> materialColorsHandle;
+	UniformHandle<int> materialTexelsHandle;
+	VertexFormatHandles vertexFormatHandles;
+
+	void ResolveShaderHandles(const Shader& shader);
+	// Fill visibleCommands with the visible parts, adjacent ones merged; returns the meshes they belong to
+	std::size_t CollectVisibleCommands(const unsigned char* visibleParts);
+};
@@ -0,0 +1,511 @@
+#include "meshcache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+#include "meshsimplification.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Bump whenever the layout below or the meaning of a stored field changes
+static const std::uint32_t meshCacheVersion = 4;
+static const char meshCacheMagic[8] = { 'M', 'R', 'E', 'M', 'E', 'S', 'H', 'C' };
+// Arrays start on this boundary (relative to the start of the file) so they can be read in place
+static const std::size_t meshCacheAlignment = 16;
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be tightly packed");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "glm::vec4 must be tightly packed");
+
+struct MeshCacheFileHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t processFlags;
+	std::uint32_t optimizationKey;
+	std::uint32_t levelOfDetailKey;
+	std::uint64_t sourceSize;
+	std::int64_t sourceModifiedTime;
+	std::uint32_t sourcePathLength;
+	std::uint32_t meshCount; // entries, counting the levels of detail
+};
+
+struct MeshCacheMeshHeader
+{
+	std::uint32_t vertexCount;
+	std::uint32_t faceCount;
+	std::uint32_t indexCount;
+	std::uint32_t adjacentFaceCount; // length of the CSR face index array
+	std::uint32_t textureCount;
+	std::uint32_t validCurvatureStages;
+	std::uint32_t level;
+	float error;
+	float material[9]; // ka, kd, ks
+};
+
+static bool meshCacheEnabled = true;
+
+void SetMeshCacheEnabled(bool enabled)
+{
+	meshCacheEnabled = enabled;
+}
+bool IsMeshCacheEnabled()
+{
+	return meshCacheEnabled;
+}
+
+std::string GetMeshCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+bool GetMeshCacheKey(const std::string& sourcePath, std::uint32_t processFlags, std::uint32_t optimizationKey,
+	std::uint32_t levelOfDetailKey, MeshCacheKey& key)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(sourcePath.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(sourcePath.c_str(), &info) != 0)
+		return false;
+#endif
+	key.sourcePath = sourcePath;
+	key.sourceSize = static_cast<std::uint64_t>(info.st_size);
+	key.sourceModifiedTime = static_cast<std::int64_t>(info.st_mtime);
+	key.processFlags = processFlags;
+	key.optimizationKey = optimizationKey;
+	key.levelOfDetailKey = levelOfDetailKey;
+	return true;
+}
+
+// Read only view of a whole file
+class MappedFile
+{
+public:
+	MappedFile() : data(nullptr), size(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#endif
+	}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+			return false;
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+			return false;
+		data = static_cast<const char*>(view);
+		size = static_cast<std::size_t>(info.st_size);
+#endif
+		return data != nullptr;
+	}
+	void Close()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		if (data)
+			munmap(const_cast<char*>(data), size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	const char* GetData() const { return data; }
+	std::size_t GetSize() const { return size; }
+private:
+	const char* data;
+	std::size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+// Bounds checked sequential reads from the mapped file; every failure is sticky
+class MeshCacheReader
+{
+public:
+	MeshCacheReader(const char* data, std::size_t size) : data(data), size(size), offset(0), valid(true) {}
+
+	bool IsValid() const { return valid; }
+	std::size_t GetRemaining() const { return size - offset; }
+
+	const char* Take(std::size_t bytes)
+	{
+		if (!valid || bytes > size - offset)
+		{
+			valid = false;
+			return nullptr;
+		}
+		const char* p = data + offset;
+		offset += bytes;
+		return p;
+	}
+	template <class T>
+	bool Read(T& value)
+	{
+		const char* p = Take(sizeof(T));
+		if (p)
+			std::memcpy(&value, p, sizeof(T));
+		return p != nullptr;
+	}
+	bool ReadString(std::string& value)
+	{
+		std::uint32_t length = 0;
+		if (!Read(length))
+			return false;
+		const char* p = Take(length);
+		if (p)
+			value.assign(p, length);
+		return p != nullptr;
+	}
+	// Copies count elements of an aligned array straight out of the mapping
+	template <class T, class Vector>
+	bool ReadArray(Vector& values, std::size_t count)
+	{
+		Align();
+		if (valid && count > (size - offset) / sizeof(T))
+			valid = false;
+		const char* p = Take(count * sizeof(T));
+		if (!p)
+			return false;
+		values.resize(count);
+		if (count)
+			std::memcpy(values.data(), p, count * sizeof(T));
+		return true;
+	}
+	void Align()
+	{
+		std::size_t padding = (meshCacheAlignment - offset % meshCacheAlignment) % meshCacheAlignment;
+		Take(padding);
+	}
+private:
+	const char* data;
+	std::size_t size;
+	std::size_t offset;
+	bool valid;
+};
+
+class MeshCacheWriter
+{
+public:
+	explicit MeshCacheWriter(std::ofstream& file) : file(file), offset(0) {}
+
+	void Write(const void* data, std::size_t bytes)
+	{
+		file.write(static_cast<const char*>(data), bytes);
+		offset += bytes;
+	}
+	template <class T>
+	void Write(const T& value)
+	{
+		Write(&value, sizeof(T));
+	}
+	void WriteString(const std::string& value)
+	{
+		Write(static_cast<std::uint32_t>(value.size()));
+		Write(value.data(), value.size());
+	}
+	template <class T>
+	void WriteArray(const T* values, std::size_t count)
+	{
+		Align();
+		Write(values, count * sizeof(T));
+	}
+	void Align()
+	{
+		static const char zeros[meshCacheAlignment] = {};
+		Write(zeros, (meshCacheAlignment - offset % meshCacheAlignment) % meshCacheAlignment);
+	}
+private:
+	std::ofstream& file;
+	std::size_t offset;
+};
+
+static bool ReadMeshCacheEntry(MeshCacheReader& reader, MeshCacheEntry& entry)
+{
+	MeshCacheMeshHeader header = {};
+	if (!reader.Read(header))
+		return false;
+	// Each texture takes at least two length fields; a larger count means the file is corrupt
+	if (header.textureCount > reader.GetRemaining() / (2 * sizeof(std::uint32_t)))
+		return false;
+
+	entry.textures.resize(header.textureCount);
+	for (auto& texture : entry.textures)
+	{
+		reader.ReadString(texture.path);
+		reader.ReadString(texture.type);
+	}
+	entry.mat.ka = glm::vec3(header.material[0], header.material[1], header.material[2]);
+	entry.mat.kd = glm::vec3(header.material[3], header.material[4], header.material[5]);
+	entry.mat.ks = glm::vec3(header.material[6], header.material[7], header.material[8]);
+	entry.validCurvatureStages = header.validCurvatureStages;
+	entry.level = header.level;
+	entry.error = header.error;
+
+	std::size_t nv = header.vertexCount;
+	MeshGeometry& geometry = entry.geometry;
+	reader.ReadArray<glm::vec3>(geometry.positions, nv);
+	reader.ReadArray<glm::vec3>(geometry.normals, nv);
+	reader.ReadArray<glm::vec2>(geometry.texCoords, nv);
+	reader.ReadArray<glm::vec3>(geometry.pdir1, nv);
+	reader.ReadArray<glm::vec3>(geometry.pdir2, nv);
+	reader.ReadArray<float>(geometry.curv1, nv);
+	reader.ReadArray<float>(geometry.curv2, nv);
+	reader.ReadArray<glm::vec4>(geometry.dcurv, nv);
+	reader.ReadArray<float>(geometry.pointAreas, nv);
+
+	reader.ReadArray<std::array<unsigned int, 3>>(entry.faces, header.faceCount);
+	reader.ReadArray<glm::vec3>(entry.cornerAreas, header.faceCount);
+	reader.ReadArray<unsigned int>(entry.indices, header.indexCount);
+
+	// adjacentFaces is stored in its CSR form: nv + 1 offsets followed by the face indices
+	std::vector<unsigned int> adjacentFaceOffsets, adjacentFaces;
+	reader.ReadArray<unsigned int>(adjacentFaceOffsets, nv + 1);
+	reader.ReadArray<unsigned int>(adjacentFaces, header.adjacentFaceCount);
+	if (!reader.IsValid())
+		return false;
+	if (!entry.adjacentFaces.Assign(std::move(adjacentFaceOffsets), std::move(adjacentFaces), header.faceCount))
+		return false;
+
+	// Reject indices that would read outside the arrays
+	for (const auto& face : entry.faces)
+	{
+		if (face[0] >= nv || face[1] >= nv || face[2] >= nv)
+			return false;
+	}
+	for (auto index : entry.indices)
+	{
+		if (index >= nv)
+			return false;
+	}
+	return true;
+}
+
+bool ReadMeshCache(const std::string& cachePath, const MeshCacheKey& key, std::vector<MeshCacheEntry>& entries)
+{
+	MappedFile file;
+	if (!file.Open(cachePath))
+		return false;
+
+	MeshCacheReader reader(file.GetData(), file.GetSize());
+	MeshCacheFileHeader header = {};
+	if (!reader.Read(header))
+		return false;
+	if (std::memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 || header.version != meshCacheVersion)
+		return false;
+	if (header.processFlags != key.processFlags || header.optimizationKey != key.optimizationKey ||
+		header.levelOfDetailKey != key.levelOfDetailKey || header.sourceSize != key.sourceSize || header.sourceModifiedTime != key.sourceModifiedTime)
+		return false;
+	const char* sourcePath = reader.Take(header.sourcePathLength);
+	if (!sourcePath || key.sourcePath.compare(0, std::string::npos, sourcePath, header.sourcePathLength) != 0)
+		return false;
+
+	if (header.meshCount > reader.GetRemaining() / sizeof(MeshCacheMeshHeader))
+		return false;
+
+	entries.clear();
+	entries.resize(header.meshCount);
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		// Levels of detail follow their full resolution mesh in order
+		MeshCacheEntry& entry = entries[i];
+		if (!ReadMeshCacheEntry(reader, entry) || (entry.level != 0 && (i == 0 ||
+			entry.level != entries[i - 1].level + 1 || entry.level >= maxLevelOfDetailCount)))
+		{
+			std::cerr << "ERROR::MESHCACHE::CORRUPT_FILE: " << cachePath << '\n';
+			entries.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+static void WriteMeshCacheEntry(MeshCacheWriter& writer, const Mesh& mesh, unsigned int level, float error)
+{
+	const MeshGeometry& geometry = mesh.GetGeometry();
+	const auto& adjacentFaces = mesh.GetAdjacentFaces();
+	std::size_t nv = geometry.GetVertexCount();
+
+	// Stages that are not valid are recomputed on load
+	unsigned int validCurvatureStages = 0;
+	if (mesh.IsCurvatureStageValid(CURVATURE_POINT_AREAS))
+		validCurvatureStages |= CURVATURE_POINT_AREAS;
+	if (mesh.IsCurvatureStageValid(CURVATURE_PRINCIPAL))
+		validCurvatureStages |= CURVATURE_PRINCIPAL;
+	if (mesh.IsCurvatureStageValid(CURVATURE_DERIVATIVE))
+		validCurvatureStages |= CURVATURE_DERIVATIVE;
+
+	const Material& mat = mesh.GetMaterial();
+	MeshCacheMeshHeader header = {};
+	header.vertexCount = static_cast<std::uint32_t>(nv);
+	header.faceCount = static_cast<std::uint32_t>(mesh.GetFaces().size());
+	header.indexCount = static_cast<std::uint32_t>(mesh.GetIndices().size());
+	header.adjacentFaceCount = static_cast<std::uint32_t>(adjacentFaces.GetFaceIndices().size());
+	header.textureCount = static_cast<std::uint32_t>(mesh.GetTextures().size());
+	header.validCurvatureStages = validCurvatureStages;
+	header.level = level;
+	header.error = error;
+	const glm::vec3 colors[3] = { mat.ka, mat.kd, mat.ks };
+	for (int i = 0; i < 3; i++)
+	{
+		header.material[3 * i + 0] = colors[i].x;
+		header.material[3 * i + 1] = colors[i].y;
+		header.material[3 * i + 2] = colors[i].z;
+	}
+	writer.Write(header);
+
+	for (const auto& texture : mesh.GetTextures())
+	{
+		writer.WriteString(texture.GetPath());
+		writer.WriteString(texture.GetType());
+	}
+
+	writer.WriteArray(geometry.positions.data(), nv);
+	writer.WriteArray(geometry.normals.data(), nv);
+	writer.WriteArray(geometry.texCoords.data(), nv);
+	writer.WriteArray(geometry.pdir1.data(), nv);
+	writer.WriteArray(geometry.pdir2.data(), nv);
+	writer.WriteArray(geometry.curv1.data(), nv);
+	writer.WriteArray(geometry.curv2.data(), nv);
+	writer.WriteArray(geometry.dcurv.data(), nv);
+	writer.WriteArray(geometry.pointAreas.data(), nv);
+
+	const auto& cornerAreas = mesh.GetCornerAreas();
+	writer.WriteArray(mesh.GetFaces().data(), header.faceCount);
+	if (cornerAreas.size() == header.faceCount)
+		writer.WriteArray(cornerAreas.data(), header.faceCount);
+	else
+	{
+		// Only possible when no stage was computed; keep the layout fixed
+		std::vector<glm::vec3> zeroAreas(header.faceCount, glm::vec3(0.0f, 0.0f, 0.0f));
+		writer.WriteArray(zeroAreas.data(), header.faceCount);
+	}
+	writer.WriteArray(mesh.GetIndices().data(), header.indexCount);
+
+	writer.WriteArray(adjacentFaces.GetOffsets().data(), adjacentFaces.GetOffsets().size());
+	writer.WriteArray(adjacentFaces.GetFaceIndices().data(), adjacentFaces.GetFaceIndices().size());
+}
+
+bool WriteMeshCache(const std::string& cachePath, const MeshCacheKey& key, const std::vector<Mesh>& meshes,
+	const std::vector<std::vector<MeshCacheLevelOfDetail>>& levelsOfDetail)
+{
+	// Unique per process and thread, as batch loader threads or other processes may write the same cache at
+	// once; whichever is renamed last wins, and each of them is complete
+#ifdef _WIN32
+	unsigned long processID = static_cast<unsigned long>(_getpid());
+#else
+	unsigned long processID = static_cast<unsigned long>(getpid());
+#endif
+	std::string temporaryPath = cachePath + "." + std::to_string(processID) + "." +
+		std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cerr << "ERROR::MESHCACHE::FILE_NOT_CREATED: " << temporaryPath << '\n';
+			return false;
+		}
+
+		MeshCacheWriter writer(file);
+		MeshCacheFileHeader header = {};
+		std::memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+		header.version = meshCacheVersion;
+		header.processFlags = key.processFlags;
+		header.optimizationKey = key.optimizationKey;
+		header.levelOfDetailKey = key.levelOfDetailKey;
+		header.sourceSize = key.sourceSize;
+		header.sourceModifiedTime = key.sourceModifiedTime;
+		header.sourcePathLength = static_cast<std::uint32_t>(key.sourcePath.size());
+		std::size_t entryCount = meshes.size();
+		for (std::size_t i = 0; i < meshes.size() && i < levelsOfDetail.size(); i++)
+			entryCount += levelsOfDetail[i].size();
+		header.meshCount = static_cast<std::uint32_t>(entryCount);
+		writer.Write(header);
+		writer.Write(key.sourcePath.data(), key.sourcePath.size());
+
+		for (std::size_t i = 0; i < meshes.size(); i++)
+		{
+			WriteMeshCacheEntry(writer, meshes[i], 0, 0.0f);
+			if (i >= levelsOfDetail.size())
+				continue;
+			for (std::size_t level = 0; level < levelsOfDetail[i].size(); level++)
+			{
+				WriteMeshCacheEntry(writer, *levelsOfDetail[i][level].mesh, static_cast<unsigned int>(level + 1),
+					levelsOfDetail[i][level].error);
+			}
+		}
+
+		file.flush();
+		if (!file)
+		{
+			std::cerr << "ERROR::MESHCACHE::WRITE_FAILED: " << temporaryPath << '\n';
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	// std::rename does not replace an existing file on Windows
+	std::remove(cachePath.c_str());
+	if (std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::cerr << "ERROR::MESHCACHE::RENAME_FAILED: " << cachePath << '\n';
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
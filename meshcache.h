@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "adjacency.h"
+#include "mesh.h"
+#include "meshgeometry.h"
+
+// Binary cache of a model's processed meshes (geometry, topology, curvature and material) and their levels of
+// detail, stored next to
+// the source model as "<model path>.meshcache". It is read through a memory mapping without any parsing,
+// so a warm start skips both Assimp and the curvature computation.
+// The file is native endian and only valid on the architecture that wrote it.
+
+// Identifies the source a cache file was built from; any difference makes the cache stale
+struct MeshCacheKey
+{
+	std::string sourcePath;
+	std::uint64_t sourceSize;
+	std::int64_t sourceModifiedTime;
+	std::uint32_t processFlags; // Assimp import flags
+	std::uint32_t optimizationKey; // GetMeshOptimizationKey() of the options the meshes were optimized with
+	std::uint32_t levelOfDetailKey; // GetLevelOfDetailKey() of the options the levels of detail were built with
+};
+
+struct MeshCacheTexture
+{
+	std::string path; // relative to the model directory, as written in the material
+	std::string type;
+};
+
+// One mesh as stored in the cache: a full resolution mesh, followed by the entries of its levels of detail
+struct MeshCacheEntry
+{
+	unsigned int level; // 0 for a full resolution mesh, otherwise one more than the entry before
+	float error; // of a level of detail, summed over the simplifications (see Model::LevelOfDetail)
+	MeshGeometry geometry;
+	std::vector<std::array<unsigned int, 3>> faces;
+	std::vector<unsigned int> indices;
+	VertexFaceAdjacency adjacentFaces;
+	std::vector<glm::vec3> cornerAreas;
+	std::vector<MeshCacheTexture> textures;
+	Material mat;
+	unsigned int validCurvatureStages;
+};
+
+// The cache is used by Model::LoadModel unless disabled (e.g. to measure a cold start)
+void SetMeshCacheEnabled(bool enabled);
+bool IsMeshCacheEnabled();
+
+std::string GetMeshCachePath(const std::string& sourcePath);
+// Returns false if the source file does not exist
+bool GetMeshCacheKey(const std::string& sourcePath, std::uint32_t processFlags, std::uint32_t optimizationKey,
+	std::uint32_t levelOfDetailKey, MeshCacheKey& key);
+
+// Returns false if the file is missing, stale (key mismatch, older version) or truncated
+bool ReadMeshCache(const std::string& cachePath, const MeshCacheKey& key, std::vector<MeshCacheEntry>& entries);
+struct MeshCacheLevelOfDetail
+{
+	const Mesh* mesh;
+	float error;
+};
+// Writes to a temporary file first, so a crash never leaves a half written cache behind. levelsOfDetail[i] are
+// written after meshes[i], finest first; it may be shorter than meshes.
+bool WriteMeshCache(const std::string& cachePath, const MeshCacheKey& key, const std::vector<Mesh>& meshes,
+	const std::vector<std::vector<MeshCacheLevelOfDetail>>& levelsOfDetail);
@@ -0,0 +1,97 @@
+#include "meshgeometry.h"
+#include <algorithm>
+#include <cmath>
+
+template <class T>
+static std::size_t ArrayBytes(const AlignedVector<T>& array)
+{
+	return array.capacity() * sizeof(T);
+}
+
+void MeshGeometry::Resize(std::size_t vertexCount)
+{
+	positions.resize(vertexCount);
+	normals.resize(vertexCount);
+	texCoords.resize(vertexCount);
+
+	pdir1.assign(vertexCount, glm::vec3(0.0f, 0.0f, 0.0f));
+	pdir2.assign(vertexCount, glm::vec3(0.0f, 0.0f, 0.0f));
+	curv1.assign(vertexCount, 0.0f);
+	curv2.assign(vertexCount, 0.0f);
+	dcurv.assign(vertexCount, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+
+	pointAreas.assign(vertexCount, 0.0f);
+}
+std::size_t MeshGeometry::GetVertexCount() const
+{
+	return positions.size();
+}
+std::size_t MeshGeometry::GetMemoryUsage() const
+{
+	return ArrayBytes(positions) + ArrayBytes(normals) + ArrayBytes(texCoords) +
+		ArrayBytes(pdir1) + ArrayBytes(pdir2) + ArrayBytes(curv1) + ArrayBytes(curv2) + ArrayBytes(dcurv) +
+		ArrayBytes(pointAreas) + ArrayBytes(q1) + ArrayBytes(t1) + ArrayBytes(dt1q1);
+}
+int MeshGeometry::GetAttributeComponentCount(VertexAttribute attribute)
+{
+	switch (attribute)
+	{
+	case ATTRIBUTE_POSITION:
+	case ATTRIBUTE_NORMAL:
+	case ATTRIBUTE_PDIR1:
+	case ATTRIBUTE_PDIR2:
+		return 3;
+	case ATTRIBUTE_TEXCOORDS:
+		return 2;
+	case ATTRIBUTE_CURV1:
+	case ATTRIBUTE_CURV2:
+		return 1;
+	case ATTRIBUTE_DCURV:
+		return 4;
+	default:
+		return 0;
+	}
+}
+const void* MeshGeometry::GetAttributeData(VertexAttribute attribute) const
+{
+	switch (attribute)
+	{
+	case ATTRIBUTE_POSITION: return positions.data();
+	case ATTRIBUTE_NORMAL: return normals.data();
+	case ATTRIBUTE_TEXCOORDS: return texCoords.data();
+	case ATTRIBUTE_PDIR1: return pdir1.data();
+	case ATTRIBUTE_PDIR2: return pdir2.data();
+	case ATTRIBUTE_CURV1: return curv1.data();
+	case ATTRIBUTE_CURV2: return curv2.data();
+	case ATTRIBUTE_DCURV: return dcurv.data();
+	default: return nullptr;
+	}
+}
+std::size_t MeshGeometry::GetAttributeSize(VertexAttribute attribute) const
+{
+	return GetVertexCount() * GetAttributeComponentCount(attribute) * sizeof(float);
+}
+float ComputeFeatureSize(const MeshGeometry& geometry)
+{
+	std::size_t nv = geometry.GetVertexCount();
+	if (nv == 0 || geometry.curv1.size() != nv || geometry.curv2.size() != nv)
+		return 0.0f;
+
+	glm::vec3 low = geometry.positions[0], high = geometry.positions[0];
+	for (const auto& p : geometry.positions)
+	{
+		low = glm::min(low, p);
+		high = glm::max(high, p);
+	}
+	float radius = 0.5f * glm::length(high - low);
+
+	std::vector<float> samples(2 * nv);
+	for (std::size_t i = 0; i < nv; i++)
+	{
+		samples[2 * i] = std::fabs(geometry.curv1[i]);
+		samples[2 * i + 1] = std::fabs(geometry.curv2[i]);
+	}
+	auto median = samples.begin() + samples.size() / 2;
+	std::nth_element(samples.begin(), median, samples.end());
+	return *median > 0.0f ? std::min(1.0f / *median, radius) : radius;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <glm/glm.hpp>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Allocator that aligns attribute arrays to cache lines, so SIMD loads never split a line
+template <class T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+	using value_type = T;
+	template <class U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template <class U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		if (n == 0)
+			return nullptr;
+#ifdef _WIN32
+		void* p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0)
+			p = nullptr;
+#endif
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, std::size_t)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	template <class U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <class U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <class T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// GPU vertex attributes. The value is the attribute location used by the shaders.
+enum VertexAttribute : unsigned int
+{
+	ATTRIBUTE_POSITION = 0,
+	ATTRIBUTE_NORMAL = 1,
+	ATTRIBUTE_TEXCOORDS = 2,
+	ATTRIBUTE_PDIR1 = 3,
+	ATTRIBUTE_PDIR2 = 4,
+	ATTRIBUTE_CURV1 = 5,
+	ATTRIBUTE_CURV2 = 6,
+	ATTRIBUTE_DCURV = 7,
+
+	VERTEX_ATTRIBUTE_COUNT,
+
+	// View dependent attributes (apparent ridges), streamed by the mesh every frame instead of uploaded once
+	ATTRIBUTE_Q1 = VERTEX_ATTRIBUTE_COUNT,
+	ATTRIBUTE_T1,
+	ATTRIBUTE_DT1Q1,
+
+	// Batched draws only: index of the vertex's mesh into the material colours (see MeshBatch)
+	ATTRIBUTE_MATERIAL
+};
+
+// Per vertex data stored as one array per attribute (structure of arrays).
+// The curvature loops only touch the arrays they need, and every GPU attribute is its own stream.
+struct MeshGeometry
+{
+	// GPU attributes
+	AlignedVector<glm::vec3> positions;
+	AlignedVector<glm::vec3> normals;
+	AlignedVector<glm::vec2> texCoords;
+	AlignedVector<glm::vec3> pdir1, pdir2;
+	AlignedVector<float> curv1, curv2;
+	AlignedVector<glm::vec4> dcurv;
+
+	// CPU only
+	AlignedVector<float> pointAreas;
+
+	// View dependent (apparent ridges); empty until a stage fills them
+	AlignedVector<float> q1;
+	AlignedVector<glm::vec2> t1;
+	AlignedVector<float> dt1q1;
+
+	// Size every view independent array for vertexCount vertices; derived fields are zeroed
+	void Resize(std::size_t vertexCount);
+	std::size_t GetVertexCount() const;
+	std::size_t GetMemoryUsage() const; // bytes held by all arrays
+
+	// Upload description of one attribute stream
+	static int GetAttributeComponentCount(VertexAttribute attribute);
+	const void* GetAttributeData(VertexAttribute attribute) const;
+	std::size_t GetAttributeSize(VertexAttribute attribute) const; // bytes
+};
+
+// Length scale of the surface detail for view dependent line thresholds: the reciprocal of the median principal
+// curvature magnitude, capped at the bounding sphere radius. 0 if the principal curvatures are missing.
+float ComputeFeatureSize(const MeshGeometry& geometry);
@@ -0,0 +1,229 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include "normalcone.h"
+#include "parallel.h"
+
+// A meshlet may stop growing once the best next face is further than this from its average normal
+static const float splitAngleCosine = 0.7071f; // 45 degrees
+static const unsigned int noMeshlet = 0xFFFFFFFFu;
+static const float pi = 3.14159265f;
+
+static bool meshletCullingEnabled = false;
+
+void SetMeshletCullingEnabled(bool enabled)
+{
+	meshletCullingEnabled = enabled;
+}
+bool IsMeshletCullingEnabled()
+{
+	return meshletCullingEnabled;
+}
+
+void MeshletSet::Build(const AlignedVector<glm::vec3>& positions, const AlignedVector<glm::vec3>& normals,
+	const std::vector<std::array<unsigned int, 3>>& faces, const VertexFaceAdjacency& adjacentFaces,
+	std::vector<unsigned int>& faceOrder)
+{
+	meshlets.clear();
+	faceOrder.clear();
+	if (faces.empty())
+		return;
+
+	int nf = static_cast<int>(faces.size());
+	std::vector<glm::vec3> faceNormals(faces.size()), centroids(faces.size());
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const glm::vec3& a = positions[faces[i][0]];
+			const glm::vec3& b = positions[faces[i][1]];
+			const glm::vec3& c = positions[faces[i][2]];
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float length = glm::length(n);
+			// Oriented like the vertex normals, since the winding is not reliable; a degenerate face draws
+			// nothing and so does not count
+			if (glm::dot(n, normals[faces[i][0]] + normals[faces[i][1]] + normals[faces[i][2]]) < 0.0f)
+				n = -n;
+			faceNormals[i] = length > 0.0f ? n / length : glm::vec3(0.0f);
+			centroids[i] = (a + b + c) / 3.0f;
+		}
+	});
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (const auto& centroid : centroids)
+	{
+		boundsMin = glm::min(boundsMin, centroid);
+		boundsMax = glm::max(boundsMax, centroid);
+	}
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+	// Morton order of the centroids, for the seeds
+	std::vector<std::pair<std::uint32_t, unsigned int>> order(faces.size());
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			glm::vec3 q = (centroids[i] - boundsMin) / extent * 1023.0f;
+			order[i] = std::make_pair(GetMortonCode(static_cast<std::uint32_t>(q.x), static_cast<std::uint32_t>(q.y),
+				static_cast<std::uint32_t>(q.z)), static_cast<unsigned int>(i));
+		}
+	});
+	std::sort(order.begin(), order.end());
+
+	// Grow each meshlet from the first free face in Morton order, always taking the neighbour (a face sharing a
+	// vertex) that shares the most vertices and turns least from the meshlet's average normal
+	faceOrder.reserve(faces.size());
+	std::vector<unsigned char> assigned(faces.size(), 0);
+	std::vector<unsigned int> vertexMeshlet(positions.size(), noMeshlet); // last meshlet to use the vertex
+	std::vector<unsigned int> frontierMeshlet(faces.size(), noMeshlet); // last meshlet whose frontier had the face
+	std::vector<unsigned int> frontier;
+	for (const auto& seed : order)
+	{
+		if (assigned[seed.second])
+			continue;
+
+		unsigned int id = static_cast<unsigned int>(meshlets.size());
+		Meshlet current = Meshlet();
+		current.firstFace = static_cast<unsigned int>(faceOrder.size());
+		glm::vec3 normalSum(0.0f);
+		frontier.clear();
+		unsigned int next = seed.second;
+		while (true)
+		{
+			assigned[next] = 1;
+			faceOrder.push_back(next);
+			current.faceCount++;
+			normalSum += faceNormals[next];
+			for (unsigned int v : faces[next])
+			{
+				if (vertexMeshlet[v] == id)
+					continue;
+				vertexMeshlet[v] = id;
+				for (unsigned int neighbour : adjacentFaces[v])
+				{
+					if (!assigned[neighbour] && frontierMeshlet[neighbour] != id)
+					{
+						frontierMeshlet[neighbour] = id;
+						frontier.push_back(neighbour);
+					}
+				}
+			}
+			if (current.faceCount == maxFaces)
+				break;
+
+			float axisLength = glm::length(normalSum);
+			int best = -1;
+			float bestScore = -FLT_MAX, bestCosine = 0.0f;
+			for (std::size_t k = 0; k < frontier.size();)
+			{
+				unsigned int candidate = frontier[k];
+				if (assigned[candidate])
+				{
+					frontier[k] = frontier.back();
+					frontier.pop_back();
+					continue;
+				}
+				int shared = 0;
+				for (unsigned int v : faces[candidate])
+					shared += vertexMeshlet[v] == id;
+				float cosine = axisLength > 0.0f ? glm::dot(faceNormals[candidate], normalSum) / axisLength : 1.0f;
+				if (shared + cosine > bestScore)
+				{
+					bestScore = shared + cosine;
+					bestCosine = cosine;
+					best = static_cast<int>(candidate);
+				}
+				k++;
+			}
+			if (best < 0 || (current.faceCount >= minFaces && bestCosine < splitAngleCosine))
+				break;
+			next = static_cast<unsigned int>(best);
+		}
+		meshlets.push_back(current);
+	}
+
+	ParallelFor(static_cast<int>(meshlets.size()), [&](int begin, int end)
+	{
+		for (int m = begin; m < end; m++)
+		{
+			Meshlet& meshlet = meshlets[m];
+			const unsigned int* meshletFaces = &faceOrder[meshlet.firstFace];
+
+			glm::vec3 lo(FLT_MAX), hi(-FLT_MAX), normalSum(0.0f);
+			for (unsigned int i = 0; i < meshlet.faceCount; i++)
+			{
+				for (unsigned int v : faces[meshletFaces[i]])
+				{
+					lo = glm::min(lo, positions[v]);
+					hi = glm::max(hi, positions[v]);
+					normalSum += normals[v];
+				}
+				normalSum += faceNormals[meshletFaces[i]];
+			}
+			meshlet.center = 0.5f * (lo + hi);
+			meshlet.radius = 0.0f;
+			for (unsigned int i = 0; i < meshlet.faceCount; i++)
+			{
+				for (unsigned int v : faces[meshletFaces[i]])
+					meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+			}
+
+			float sumLength = glm::length(normalSum);
+			meshlet.coneAxis = sumLength > 1e-6f ? normalSum / sumLength : glm::vec3(0.0f, 0.0f, 1.0f);
+			meshlet.coneAngle = sumLength > 1e-6f ? 0.0f : pi;
+			auto widen = [&](const glm::vec3& normal)
+			{
+				// A vertex without a normal could face anywhere
+				float length = glm::length(normal);
+				if (length == 0.0f)
+					meshlet.coneAngle = pi;
+				else
+					meshlet.coneAngle = std::max(meshlet.coneAngle, AngleBetween(meshlet.coneAxis, normal / length));
+			};
+			for (unsigned int i = 0; i < meshlet.faceCount && meshlet.coneAngle < pi; i++)
+			{
+				if (faceNormals[meshletFaces[i]] != glm::vec3(0.0f))
+					widen(faceNormals[meshletFaces[i]]);
+				for (unsigned int v : faces[meshletFaces[i]])
+					widen(normals[v]);
+			}
+		}
+	}, 64);
+}
+MeshletFacing MeshletSet::GetFacing(const Meshlet& meshlet, const glm::vec3& eye)
+{
+	switch (GetConeFacing(meshlet.center, meshlet.radius, meshlet.coneAxis, meshlet.coneAngle, eye))
+	{
+	case CONE_FRONT_FACING:
+		return MESHLET_FRONT_FACING;
+	case CONE_BACK_FACING:
+		return MESHLET_BACK_FACING;
+	default:
+		return MESHLET_MIXED;
+	}
+}
+void MeshletSet::Classify(const glm::vec3& eye, std::vector<unsigned char>& facing, MeshletStatistics* statistics) const
+{
+	facing.resize(meshlets.size());
+	for (std::size_t m = 0; m < meshlets.size(); m++)
+		facing[m] = GetFacing(meshlets[m], eye);
+
+	if (statistics)
+	{
+		*statistics = MeshletStatistics();
+		statistics->meshletCount = meshlets.size();
+		for (std::size_t m = 0; m < meshlets.size(); m++)
+		{
+			statistics->triangleCount += meshlets[m].faceCount;
+			statistics->frontFacing += facing[m] == MESHLET_FRONT_FACING;
+			statistics->backFacing += facing[m] == MESHLET_BACK_FACING;
+			if (facing[m] != MESHLET_BACK_FACING)
+				statistics->trianglesKept += meshlets[m].faceCount;
+		}
+	}
+}
+std::size_t MeshletSet::GetMemoryUsage() const
+{
+	return meshlets.capacity() * sizeof(Meshlet);
+}
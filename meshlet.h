@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "adjacency.h"
+#include "meshgeometry.h"
+
+// Meshes split their faces into meshlets as they are created, and Mesh::CullMeshlets then lets the surface, the
+// suggestive contours and the apparent ridges skip the meshlets that face away from the eye; set before the
+// meshes are loaded. The surface then relies on back faces being hidden, so what an open mesh shows through
+// its holes (e.g. the inside of the teapot's spout) goes missing.
+void SetMeshletCullingEnabled(bool enabled);
+bool IsMeshletCullingEnabled();
+
+// Faces [firstFace, firstFace + faceCount) of a mesh in meshlet order with a bounding sphere of their vertices
+// and a normal cone around both their face normals (oriented like the vertex normals) and their vertex normals
+struct Meshlet
+{
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneAngle; // half angle in radians; pi when the normals point everywhere
+	unsigned int firstFace;
+	unsigned int faceCount;
+};
+
+enum MeshletFacing : unsigned char
+{
+	MESHLET_MIXED,
+	MESHLET_FRONT_FACING, // every face and vertex normal points towards the eye: no silhouette inside
+	MESHLET_BACK_FACING // every normal points away: nothing on it is drawn or has lines
+};
+
+struct MeshletStatistics
+{
+	std::size_t meshletCount;
+	std::size_t frontFacing;
+	std::size_t backFacing;
+	std::size_t triangleCount;
+	std::size_t trianglesKept; // in meshlets that are not back facing
+};
+
+// Spatially coherent clusters of up to maxFaces connected faces. Each meshlet grows from a seed face across
+// shared vertices, preferring compact and flat growth, and stops early once it has minFaces faces and every
+// face it could take turns too far from its average normal. Seeds are taken along a Morton curve of the face
+// centroids, so consecutive meshlets are close too.
+class MeshletSet
+{
+public:
+	MeshletSet() = default;
+
+	// faceOrder receives the faces meshlet by meshlet; the meshlets refer to the faces in that order, so the
+	// caller must reorder its faces (and everything per face) accordingly
+	void Build(const AlignedVector<glm::vec3>& positions, const AlignedVector<glm::vec3>& normals,
+		const std::vector<std::array<unsigned int, 3>>& faces, const VertexFaceAdjacency& adjacentFaces,
+		std::vector<unsigned int>& faceOrder);
+	bool IsBuilt() const { return !meshlets.empty(); }
+	const std::vector<Meshlet>& GetMeshlets() const { return meshlets; }
+
+	// facing[i] is the MeshletFacing of meshlet i seen from eye (object space)
+	void Classify(const glm::vec3& eye, std::vector<unsigned char>& facing, MeshletStatistics* statistics = nullptr) const;
+	static MeshletFacing GetFacing(const Meshlet& meshlet, const glm::vec3& eye);
+
+	std::size_t GetMemoryUsage() const;
+
+	static const unsigned int minFaces = 64;
+	static const unsigned int maxFaces = 128;
+private:
+	std::vector<Meshlet> meshlets;
+};
@@ -0,0 +1,394 @@
+#include "meshoptimization.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "timer.h"
+
+static const unsigned int noVertex = 0xFFFFFFFFu;
+// Forsyth's vertex cache model: an LRU cache of this many entries, where the three vertices of the last
+// triangle score the same so the next triangle does not prefer any of its edges
+static const unsigned int forsythCacheSize = 32;
+static const float forsythLastTriangleScore = 0.75f;
+static const float forsythCacheDecayPower = 1.5f;
+// Vertices with few triangles left get a boost, so no lonely triangles are left behind
+static const float forsythValenceBoostScale = 2.0f;
+static const float forsythValenceBoostPower = 0.5f;
+static const unsigned int forsythValenceTableSize = 32;
+
+static MeshOptimizationOptions meshOptimizationOptions;
+
+void SetMeshOptimizationOptions(const MeshOptimizationOptions& options)
+{
+	meshOptimizationOptions = options;
+}
+const MeshOptimizationOptions& GetMeshOptimizationOptions()
+{
+	return meshOptimizationOptions;
+}
+std::uint32_t GetMeshOptimizationKey()
+{
+	if (!meshOptimizationOptions.enabled)
+		return 0;
+	std::uint32_t toleranceBits;
+	std::memcpy(&toleranceBits, &meshOptimizationOptions.weldTolerance, sizeof(toleranceBits));
+	std::uint32_t key = 0x9E3779B9u ^ (toleranceBits * 0x85EBCA6Bu);
+	key ^= meshOptimizationOptions.keepTextureSeams ? 0xC2B2AE35u : 0u;
+	return key != 0 ? key : 1u;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount,
+	unsigned int cacheSize)
+{
+	// A vertex is in the FIFO while fewer than cacheSize misses came after the miss that loaded it; loadedAt is
+	// offset by cacheSize so that 0 means never loaded
+	std::vector<unsigned int> loadedAt(vertexCount, 0);
+	std::vector<unsigned char> referenced(vertexCount, 0);
+	unsigned int misses = 0;
+	std::size_t referencedCount = 0;
+	for (const auto& face : faces)
+	{
+		for (unsigned int v : face)
+		{
+			if (!referenced[v])
+			{
+				referenced[v] = 1;
+				referencedCount++;
+			}
+			if (misses + cacheSize - loadedAt[v] >= cacheSize)
+				loadedAt[v] = ++misses + cacheSize;
+		}
+	}
+
+	VertexCacheStatistics statistics;
+	statistics.acmr = faces.empty() ? 0.0f : static_cast<float>(misses) / faces.size();
+	statistics.atvr = referencedCount == 0 ? 0.0f : static_cast<float>(misses) / referencedCount;
+	return statistics;
+}
+
+// Vertex v moves to remap[v] (noVertex drops it). Several vertices may share a target: the first one gives the
+// position and texture coordinates, and the normals are averaged.
+static void RemapVertices(MeshGeometry& geometry, const std::vector<unsigned int>& remap, std::size_t vertexCount)
+{
+	MeshGeometry remapped;
+	remapped.Resize(vertexCount);
+	std::vector<unsigned char> filled(vertexCount, 0);
+	for (std::size_t v = 0; v < remap.size(); v++)
+	{
+		unsigned int target = remap[v];
+		if (target == noVertex)
+			continue;
+		if (!filled[target])
+		{
+			filled[target] = 1;
+			remapped.positions[target] = geometry.positions[v];
+			remapped.texCoords[target] = geometry.texCoords[v];
+			remapped.normals[target] = glm::vec3(0.0f);
+		}
+		remapped.normals[target] += geometry.normals[v];
+	}
+	for (auto& normal : remapped.normals)
+	{
+		float length = glm::length(normal);
+		if (length > 0.0f)
+			normal /= length;
+	}
+	geometry = std::move(remapped);
+}
+
+std::size_t WeldVertices(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces, float tolerance,
+	bool keepTextureSeams)
+{
+	std::size_t nv = geometry.GetVertexCount();
+	if (nv == 0)
+		return 0;
+
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (const auto& position : geometry.positions)
+	{
+		lo = glm::min(lo, position);
+		hi = glm::max(hi, position);
+	}
+	// Cells at least twice the tolerance, so the box around a vertex overlaps at most two per axis
+	tolerance = std::max(tolerance, 0.0f);
+	float cellSize = std::max(2.0f * tolerance, 1e-6f * glm::length(hi - lo));
+	if (cellSize <= 0.0f)
+		cellSize = 1.0f;
+	auto getCell = [&](float coordinate, float minimum)
+	{
+		return static_cast<long long>(std::floor((coordinate - minimum) / cellSize));
+	};
+
+	// Open hash of the cells, each bucket chaining the representatives (the vertices kept) that hash to it
+	std::size_t bucketCount = 1;
+	while (bucketCount < 2 * nv)
+		bucketCount *= 2;
+	std::vector<unsigned int> buckets(bucketCount, noVertex), next(nv, noVertex);
+	auto getBucket = [&](long long x, long long y, long long z)
+	{
+		std::uint64_t hash = static_cast<std::uint64_t>(x) * 73856093u ^ static_cast<std::uint64_t>(y) * 19349663u ^
+			static_cast<std::uint64_t>(z) * 83492791u;
+		return static_cast<std::size_t>(hash & (bucketCount - 1));
+	};
+
+	std::vector<unsigned int> remap(nv, noVertex);
+	unsigned int kept = 0;
+	float toleranceSquared = tolerance * tolerance;
+	for (std::size_t v = 0; v < nv; v++)
+	{
+		const glm::vec3& position = geometry.positions[v];
+		long long cellMin[3], cellMax[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cellMin[axis] = getCell(position[axis] - tolerance, lo[axis]);
+			cellMax[axis] = getCell(position[axis] + tolerance, lo[axis]);
+		}
+
+		unsigned int match = noVertex;
+		for (long long x = cellMin[0]; x <= cellMax[0] && match == noVertex; x++)
+			for (long long y = cellMin[1]; y <= cellMax[1] && match == noVertex; y++)
+				for (long long z = cellMin[2]; z <= cellMax[2] && match == noVertex; z++)
+				{
+					for (unsigned int r = buckets[getBucket(x, y, z)]; r != noVertex; r = next[r])
+					{
+						glm::vec3 offset = geometry.positions[r] - position;
+						if (glm::dot(offset, offset) <= toleranceSquared &&
+							(!keepTextureSeams || geometry.texCoords[r] == geometry.texCoords[v]))
+						{
+							match = r;
+							break;
+						}
+					}
+				}
+
+		if (match != noVertex)
+		{
+			remap[v] = remap[match];
+			continue;
+		}
+		remap[v] = kept++;
+		std::size_t bucket = getBucket(getCell(position.x, lo.x), getCell(position.y, lo.y), getCell(position.z, lo.z));
+		next[v] = buckets[bucket];
+		buckets[bucket] = static_cast<unsigned int>(v);
+	}
+	if (kept == nv)
+		return 0;
+
+	// Faces with two corners welded together have no area left
+	std::size_t faceCount = 0;
+	for (const auto& face : faces)
+	{
+		std::array<unsigned int, 3> welded = { remap[face[0]], remap[face[1]], remap[face[2]] };
+		if (welded[0] != welded[1] && welded[1] != welded[2] && welded[2] != welded[0])
+			faces[faceCount++] = welded;
+	}
+	faces.resize(faceCount);
+	RemapVertices(geometry, remap, kept);
+	return nv - kept;
+}
+
+namespace
+{
+	struct ForsythScoreTables
+	{
+		float cache[forsythCacheSize];
+		float valence[forsythValenceTableSize];
+
+		ForsythScoreTables()
+		{
+			for (unsigned int i = 0; i < forsythCacheSize; i++)
+			{
+				cache[i] = i < 3 ? forsythLastTriangleScore :
+					std::pow(1.0f - static_cast<float>(i - 3) / (forsythCacheSize - 3), forsythCacheDecayPower);
+			}
+			valence[0] = 0.0f;
+			for (unsigned int i = 1; i < forsythValenceTableSize; i++)
+				valence[i] = forsythValenceBoostScale * std::pow(static_cast<float>(i), -forsythValenceBoostPower);
+		}
+	};
+}
+
+// cachePosition is -1 outside the cache; a vertex without triangles left is never wanted
+static float GetForsythVertexScore(int cachePosition, unsigned int remainingFaces)
+{
+	static const ForsythScoreTables tables;
+	if (remainingFaces == 0)
+		return -1.0f;
+	float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+	if (remainingFaces < forsythValenceTableSize)
+		return score + tables.valence[remainingFaces];
+	return score + forsythValenceBoostScale * std::pow(static_cast<float>(remainingFaces), -forsythValenceBoostPower);
+}
+
+void OptimizeVertexCache(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount,
+	std::vector<unsigned int>& order, const std::vector<unsigned int>* rangeEnds)
+{
+	order.clear();
+	order.reserve(faces.size());
+	if (faces.empty())
+		return;
+
+	// Faces of each vertex, as offsets into one array
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (const auto& face : faces)
+	{
+		for (unsigned int v : face)
+			offsets[v + 1]++;
+	}
+	for (std::size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> vertexFaces(offsets.back()), fill(offsets.begin(), offsets.end() - 1);
+	for (std::size_t f = 0; f < faces.size(); f++)
+	{
+		for (unsigned int v : faces[f])
+			vertexFaces[fill[v]++] = static_cast<unsigned int>(f);
+	}
+
+	std::vector<unsigned int> remainingFaces(vertexCount, 0);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount, 0.0f);
+	std::vector<unsigned char> emitted(faces.size(), 0);
+	unsigned int cache[forsythCacheSize + 3], grownCache[forsythCacheSize + 3];
+	auto getFaceScore = [&](unsigned int f)
+	{
+		return vertexScores[faces[f][0]] + vertexScores[faces[f][1]] + vertexScores[faces[f][2]];
+	};
+
+	std::size_t rangeCount = rangeEnds ? rangeEnds->size() : 1;
+	unsigned int begin = 0;
+	for (std::size_t r = 0; r < rangeCount; r++)
+	{
+		unsigned int end = rangeEnds ? (*rangeEnds)[r] : static_cast<unsigned int>(faces.size());
+		for (unsigned int f = begin; f < end; f++)
+		{
+			for (unsigned int v : faces[f])
+				remainingFaces[v]++;
+		}
+		int best = -1;
+		float bestScore = -FLT_MAX;
+		for (unsigned int f = begin; f < end; f++)
+		{
+			for (unsigned int v : faces[f])
+				vertexScores[v] = GetForsythVertexScore(-1, remainingFaces[v]);
+		}
+		for (unsigned int f = begin; f < end; f++)
+		{
+			float score = getFaceScore(f);
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = static_cast<int>(f);
+			}
+		}
+
+		unsigned int cacheCount = 0, cursor = begin;
+		for (unsigned int emittedCount = begin; emittedCount < end; emittedCount++)
+		{
+			// Nothing in the cache has faces left: continue from the first face not emitted yet
+			if (best < 0)
+			{
+				while (emitted[cursor])
+					cursor++;
+				best = static_cast<int>(cursor);
+			}
+			const std::array<unsigned int, 3>& face = faces[best];
+			order.push_back(static_cast<unsigned int>(best));
+			emitted[best] = 1;
+
+			// The face's vertices move to the front of the cache; whatever falls off the end leaves it
+			unsigned int grownCount = 0;
+			for (unsigned int v : face)
+			{
+				remainingFaces[v]--;
+				if (std::find(grownCache, grownCache + grownCount, v) == grownCache + grownCount)
+					grownCache[grownCount++] = v;
+			}
+			for (unsigned int i = 0; i < cacheCount; i++)
+			{
+				if (cache[i] != face[0] && cache[i] != face[1] && cache[i] != face[2])
+					grownCache[grownCount++] = cache[i];
+			}
+			for (unsigned int i = 0; i < grownCount; i++)
+			{
+				unsigned int v = grownCache[i];
+				cachePosition[v] = i < forsythCacheSize ? static_cast<int>(i) : -1;
+				vertexScores[v] = GetForsythVertexScore(cachePosition[v], remainingFaces[v]);
+			}
+			cacheCount = std::min(grownCount, forsythCacheSize);
+			std::copy(grownCache, grownCache + cacheCount, cache);
+
+			// Only the faces around the vertices whose scores changed can be the best next
+			best = -1;
+			bestScore = -FLT_MAX;
+			for (unsigned int i = 0; i < grownCount; i++)
+			{
+				unsigned int v = grownCache[i];
+				for (unsigned int k = offsets[v]; k < offsets[v + 1]; k++)
+				{
+					unsigned int f = vertexFaces[k];
+					if (f < begin || f >= end || emitted[f])
+						continue;
+					float score = getFaceScore(f);
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = static_cast<int>(f);
+					}
+				}
+			}
+		}
+		for (unsigned int i = 0; i < cacheCount; i++)
+			cachePosition[cache[i]] = -1;
+		begin = end;
+	}
+}
+
+void OptimizeVertexFetch(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces)
+{
+	std::vector<unsigned int> remap(geometry.GetVertexCount(), noVertex);
+	unsigned int used = 0;
+	for (auto& face : faces)
+	{
+		for (unsigned int& v : face)
+		{
+			if (remap[v] == noVertex)
+				remap[v] = used++;
+			v = remap[v];
+		}
+	}
+	RemapVertices(geometry, remap, used);
+}
+
+MeshOptimizationStatistics OptimizeMesh(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces,
+	const MeshOptimizationOptions& options)
+{
+	Timer optimizeTimer;
+	MeshOptimizationStatistics statistics;
+	statistics.verticesBefore = geometry.GetVertexCount();
+	statistics.facesBefore = faces.size();
+	statistics.before = AnalyzeVertexCache(faces, geometry.GetVertexCount());
+
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (const auto& position : geometry.positions)
+	{
+		lo = glm::min(lo, position);
+		hi = glm::max(hi, position);
+	}
+	float diagonal = geometry.GetVertexCount() > 0 ? glm::length(hi - lo) : 0.0f;
+	WeldVertices(geometry, faces, options.weldTolerance * diagonal, options.keepTextureSeams);
+	statistics.welded = AnalyzeVertexCache(faces, geometry.GetVertexCount());
+
+	std::vector<unsigned int> order;
+	OptimizeVertexCache(faces, geometry.GetVertexCount(), order);
+	std::vector<std::array<unsigned int, 3>> orderedFaces(faces.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		orderedFaces[i] = faces[order[i]];
+	faces.swap(orderedFaces);
+	OptimizeVertexFetch(geometry, faces);
+
+	statistics.verticesAfter = geometry.GetVertexCount();
+	statistics.facesAfter = faces.size();
+	statistics.after = AnalyzeVertexCache(faces, geometry.GetVertexCount());
+	statistics.milliseconds = optimizeTimer.ElapsedMilliseconds();
+	return statistics;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "meshgeometry.h"
+
+// Geometry optimization applied to every mesh Model imports (see OptimizeMesh); set before the models are loaded
+struct MeshOptimizationOptions
+{
+	bool enabled = false;
+	float weldTolerance = 1e-6f; // vertices this close are welded, relative to the bounding box diagonal; 0 welds equal positions only
+	bool keepTextureSeams = false; // only weld vertices with the same texture coordinates (leaves the surface cut along UV seams)
+};
+void SetMeshOptimizationOptions(const MeshOptimizationOptions& options);
+const MeshOptimizationOptions& GetMeshOptimizationOptions();
+// Changes whenever the options change what OptimizeMesh produces; 0 when disabled. Part of the mesh cache key.
+std::uint32_t GetMeshOptimizationKey();
+
+// Post transform vertex cache efficiency of an index order, simulated with a FIFO cache
+struct VertexCacheStatistics
+{
+	float acmr; // average cache miss ratio: vertex shader invocations per triangle (0.5 at best, 3 at worst)
+	float atvr; // average transformed vertex ratio: invocations per referenced vertex (1 at best)
+};
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount,
+	unsigned int cacheSize = 16);
+
+// Merge the vertices within tolerance (object space) of each other into the first of them, found through a spatial
+// hash, and drop the faces that collapse. Merged normals are averaged, and the first vertex's texture coordinates
+// are kept (so textures smear across welded UV seams) unless keepTextureSeams only merges equal ones. Every
+// other attribute is derived later, so it is sized but not kept.
+// Returns the number of vertices removed.
+std::size_t WeldVertices(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces, float tolerance,
+	bool keepTextureSeams);
+
+// Reorder faces for the post transform vertex cache with Forsyth's linear speed algorithm (an LRU cache of 32).
+// order receives the face indices in the new order. Faces never move across the range ends given (ascending,
+// the last one faces.size(), e.g. meshlets); without them the mesh is one range.
+void OptimizeVertexCache(const std::vector<std::array<unsigned int, 3>>& faces, std::size_t vertexCount,
+	std::vector<unsigned int>& order, const std::vector<unsigned int>* rangeEnds = nullptr);
+
+// Renumber the vertices in the order the faces first use them, so the vertex fetches walk memory forwards;
+// unreferenced vertices are dropped
+void OptimizeVertexFetch(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces);
+
+struct MeshOptimizationStatistics
+{
+	std::size_t verticesBefore, verticesAfter;
+	std::size_t facesBefore, facesAfter;
+	VertexCacheStatistics before, welded, after; // as imported, welded in the imported order, and optimized
+	double milliseconds;
+};
+
+// Weld (with the tolerance scaled by the bounding box diagonal), then optimize the face order for the vertex
+// cache and the vertex order for fetching. Needs positions, normals and texture coordinates only.
+MeshOptimizationStatistics OptimizeMesh(MeshGeometry& geometry, std::vector<std::array<unsigned int, 3>>& faces,
+	const MeshOptimizationOptions& options);
@@ -0,0 +1,439 @@
+#include "meshsimplification.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include "timer.h"
+
+static const unsigned int noVertex = 0xFFFFFFFFu;
+// Per squared edge length, a boundary edge's perpendicular plane weighs this much against the faces' areas
+static const double boundaryWeight = 10.0;
+// A collapse may not turn any remaining face further than this from its old normal (cosine of the angle)
+static const float minFaceTurnCosine = 0.2f;
+// The quadric's optimal point is used only if it lies this close to the edge's midpoint, in edge lengths;
+// farther ones come from nearly singular quadrics
+static const float maxOptimalOffset = 2.0f;
+
+static LevelOfDetailOptions levelOfDetailOptions;
+
+void SetLevelOfDetailOptions(const LevelOfDetailOptions& options)
+{
+	levelOfDetailOptions = options;
+}
+const LevelOfDetailOptions& GetLevelOfDetailOptions()
+{
+	return levelOfDetailOptions;
+}
+std::uint32_t GetLevelOfDetailKey()
+{
+	if (!levelOfDetailOptions.enabled)
+		return 0;
+	std::uint32_t reductionBits, curvatureWeightBits;
+	std::memcpy(&reductionBits, &levelOfDetailOptions.reduction, sizeof(reductionBits));
+	std::memcpy(&curvatureWeightBits, &levelOfDetailOptions.curvatureWeight, sizeof(curvatureWeightBits));
+	std::uint32_t key = 0x9E3779B9u ^ (reductionBits * 0x85EBCA6Bu);
+	key ^= curvatureWeightBits * 0xC2B2AE35u;
+	key ^= std::min(std::max(levelOfDetailOptions.levelCount, 1u), maxLevelOfDetailCount) * 0x27D4EB2Fu;
+	return key != 0 ? key : 1u;
+}
+
+// Sum of weighted squared distances to planes, as the upper triangle of a symmetric 4x4 matrix:
+// xx xy xz xw yy yz yw zz zw ww
+struct Quadric
+{
+	double a[10];
+};
+
+static Quadric GetPlaneQuadric(const glm::vec3& normal, const glm::vec3& point, double weight)
+{
+	double n[4] = { normal.x, normal.y, normal.z, 0.0 };
+	n[3] = -(n[0] * point.x + n[1] * point.y + n[2] * point.z);
+	Quadric q;
+	int k = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = i; j < 4; j++)
+			q.a[k++] = weight * n[i] * n[j];
+	}
+	return q;
+}
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+	for (int i = 0; i < 10; i++)
+		q.a[i] += other.a[i];
+}
+static double EvaluateQuadric(const Quadric& q, const glm::vec3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	const double* a = q.a;
+	return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+		a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y +
+		a[7] * z * z + 2.0 * a[8] * z + a[9];
+}
+// Point of least error, unless the 3x3 part is close to singular (flat or straight neighbourhoods)
+static bool MinimizeQuadric(const Quadric& q, glm::vec3& p)
+{
+	const double* a = q.a;
+	double c00 = a[4] * a[7] - a[5] * a[5];
+	double c01 = a[2] * a[5] - a[1] * a[7];
+	double c02 = a[1] * a[5] - a[2] * a[4];
+	double det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+	double trace = (a[0] + a[4] + a[7]) / 3.0;
+	if (!(std::fabs(det) > 1e-6 * trace * trace * trace))
+		return false;
+	double c11 = a[0] * a[7] - a[2] * a[2];
+	double c12 = a[1] * a[2] - a[0] * a[5];
+	double c22 = a[0] * a[4] - a[1] * a[1];
+	double b[3] = { -a[3], -a[6], -a[8] };
+	p.x = static_cast<float>((c00 * b[0] + c01 * b[1] + c02 * b[2]) / det);
+	p.y = static_cast<float>((c01 * b[0] + c11 * b[1] + c12 * b[2]) / det);
+	p.z = static_cast<float>((c02 * b[0] + c12 * b[1] + c22 * b[2]) / det);
+	return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z);
+}
+
+static std::uint64_t GetEdgeKey(unsigned int a, unsigned int b)
+{
+	return a < b ? (static_cast<std::uint64_t>(a) << 32) | b : (static_cast<std::uint64_t>(b) << 32) | a;
+}
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static glm::vec3 GetClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return a;
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return b;
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return a + ab * (d1 / (d1 - d3));
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return c;
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return a + ac * (d2 / (d2 - d6));
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	float denominator = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Quadric scale per vertex: 1 where the surface is flat, up to 1 + curvatureWeight where its largest principal
+// curvature magnitude is far above the median
+static std::vector<double> GetCurvatureWeights(const MeshGeometry& geometry, float curvatureWeight)
+{
+	std::size_t nv = geometry.GetVertexCount();
+	std::vector<double> weights(nv, 1.0);
+	if (curvatureWeight <= 0.0f || geometry.curv1.size() != nv || geometry.curv2.size() != nv || nv == 0)
+		return weights;
+
+	std::vector<float> magnitudes(nv);
+	for (std::size_t v = 0; v < nv; v++)
+	{
+		float magnitude = std::max(std::fabs(geometry.curv1[v]), std::fabs(geometry.curv2[v]));
+		magnitudes[v] = std::isfinite(magnitude) ? magnitude : 0.0f;
+	}
+	// The median rather than the mean, which a few degenerate vertices can make arbitrarily large
+	std::vector<float> sorted = magnitudes;
+	std::nth_element(sorted.begin(), sorted.begin() + nv / 2, sorted.end());
+	double median = sorted[nv / 2];
+	if (median <= 0.0)
+		return weights;
+	for (std::size_t v = 0; v < nv; v++)
+		weights[v] = 1.0 + curvatureWeight * magnitudes[v] / (magnitudes[v] + median);
+	return weights;
+}
+
+SimplificationStatistics SimplifyMesh(const MeshGeometry& geometry, const std::vector<std::array<unsigned int, 3>>& faces,
+	std::size_t targetFaceCount, float curvatureWeight, MeshGeometry& simplified,
+	std::vector<std::array<unsigned int, 3>>& simplifiedFaces)
+{
+	Timer simplifyTimer;
+	std::size_t nv = geometry.GetVertexCount(), nf = faces.size();
+	SimplificationStatistics statistics;
+	statistics.verticesBefore = nv;
+	statistics.facesBefore = nf;
+
+	std::vector<glm::vec3> positions(geometry.positions.begin(), geometry.positions.end());
+	std::vector<glm::vec3> normals(geometry.normals.begin(), geometry.normals.end());
+	std::vector<glm::vec2> texCoords(geometry.texCoords.begin(), geometry.texCoords.end());
+	std::vector<std::array<unsigned int, 3>> workFaces = faces;
+	std::vector<double> weights = GetCurvatureWeights(geometry, curvatureWeight);
+
+	// Face plane quadrics weighted by area, and the faces around each vertex
+	std::vector<Quadric> quadrics(nv, Quadric());
+	std::vector<std::vector<unsigned int>> vertexFaces(nv);
+	std::unordered_map<std::uint64_t, unsigned int> edgeFaceCounts;
+	edgeFaceCounts.reserve(nf * 3 / 2 + 1);
+	std::vector<glm::vec3> faceNormals(nf);
+	for (std::size_t f = 0; f < nf; f++)
+	{
+		const auto& face = workFaces[f];
+		for (int k = 0; k < 3; k++)
+		{
+			vertexFaces[face[k]].push_back(static_cast<unsigned int>(f));
+			edgeFaceCounts[GetEdgeKey(face[k], face[(k + 1) % 3])]++;
+		}
+		glm::vec3 normal = glm::cross(positions[face[1]] - positions[face[0]], positions[face[2]] - positions[face[0]]);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		faceNormals[f] = normal / length;
+		for (int k = 0; k < 3; k++)
+			AddQuadric(quadrics[face[k]], GetPlaneQuadric(faceNormals[f], positions[face[0]], 0.5 * length * weights[face[k]]));
+	}
+	// Boundary edges: a plane through the edge, perpendicular to its face
+	for (std::size_t f = 0; f < nf; f++)
+	{
+		const auto& face = workFaces[f];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = face[k], b = face[(k + 1) % 3];
+			if (edgeFaceCounts[GetEdgeKey(a, b)] != 1)
+				continue;
+			glm::vec3 edge = positions[b] - positions[a];
+			glm::vec3 normal = glm::cross(edge, faceNormals[f]);
+			float length = glm::length(normal);
+			if (length == 0.0f)
+				continue;
+			double weight = boundaryWeight * glm::dot(edge, edge);
+			AddQuadric(quadrics[a], GetPlaneQuadric(normal / length, positions[a], weight * weights[a]));
+			AddQuadric(quadrics[b], GetPlaneQuadric(normal / length, positions[a], weight * weights[b]));
+		}
+	}
+
+	// Candidate collapses, least error first; a collapse is stale once either vertex has changed since (stamps)
+	struct Collapse
+	{
+		double cost;
+		unsigned int kept, removed;
+		unsigned int keptStamp, removedStamp;
+		glm::vec3 target;
+		bool operator<(const Collapse& other) const { return cost > other.cost; }
+	};
+	std::vector<unsigned int> stamps(nv, 0);
+	auto evaluate = [&](unsigned int kept, unsigned int removed)
+	{
+		Quadric q = quadrics[kept];
+		AddQuadric(q, quadrics[removed]);
+		glm::vec3 a = positions[kept], b = positions[removed];
+		glm::vec3 candidates[4] = { a, b, 0.5f * (a + b), glm::vec3(0.0f) };
+		int candidateCount = 3;
+		if (MinimizeQuadric(q, candidates[3]) &&
+			glm::length(candidates[3] - candidates[2]) <= maxOptimalOffset * glm::length(b - a))
+			candidateCount = 4;
+		Collapse collapse{ 0.0, kept, removed, stamps[kept], stamps[removed], a };
+		double best = EvaluateQuadric(q, a);
+		for (int i = 1; i < candidateCount; i++)
+		{
+			double cost = EvaluateQuadric(q, candidates[i]);
+			if (cost < best)
+			{
+				best = cost;
+				collapse.target = candidates[i];
+			}
+		}
+		collapse.cost = std::max(best, 0.0);
+		return collapse;
+	};
+	std::priority_queue<Collapse> collapses;
+	for (const auto& edge : edgeFaceCounts)
+		collapses.push(evaluate(static_cast<unsigned int>(edge.first >> 32), static_cast<unsigned int>(edge.first)));
+
+	std::vector<unsigned char> faceRemoved(nf, 0), vertexRemoved(nv, 0);
+	std::vector<unsigned int> collapsedInto(nv, noVertex);
+	std::vector<unsigned int> marks(nv, 0);
+	unsigned int mark = 0;
+	std::size_t liveFaces = nf;
+
+	// The edge must have as many common neighbours as faces (the link condition, keeping the surface manifold),
+	// and no face may flip or turn sharply as its vertex moves to the target
+	auto canCollapse = [&](const Collapse& collapse)
+	{
+		unsigned int a = collapse.kept, b = collapse.removed;
+		mark++;
+		unsigned int sharedFaces = 0;
+		for (unsigned int f : vertexFaces[a])
+		{
+			if (faceRemoved[f])
+				continue;
+			const auto& face = workFaces[f];
+			for (unsigned int v : face)
+			{
+				if (v != a)
+					marks[v] = mark;
+			}
+			sharedFaces += face[0] == b || face[1] == b || face[2] == b;
+		}
+		if (sharedFaces == 0)
+			return false;
+		unsigned int commonNeighbours = 0;
+		for (unsigned int f : vertexFaces[b])
+		{
+			if (faceRemoved[f])
+				continue;
+			for (unsigned int v : workFaces[f])
+			{
+				if (v != a && v != b && marks[v] == mark)
+				{
+					commonNeighbours++;
+					marks[v] = 0;
+				}
+			}
+		}
+		if (commonNeighbours != sharedFaces)
+			return false;
+
+		for (unsigned int moved : { a, b })
+		{
+			for (unsigned int f : vertexFaces[moved])
+			{
+				const auto& face = workFaces[f];
+				if (faceRemoved[f] || ((face[0] == a || face[1] == a || face[2] == a) && (face[0] == b || face[1] == b || face[2] == b)))
+					continue;
+				glm::vec3 p[3];
+				for (int k = 0; k < 3; k++)
+					p[k] = face[k] == moved ? collapse.target : positions[face[k]];
+				glm::vec3 before = glm::cross(positions[face[1]] - positions[face[0]], positions[face[2]] - positions[face[0]]);
+				glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				float lengths = glm::length(before) * glm::length(after);
+				if (!(lengths > 0.0f) || glm::dot(before, after) < minFaceTurnCosine * lengths)
+					return false;
+			}
+		}
+		return true;
+	};
+
+	while (liveFaces > targetFaceCount && !collapses.empty())
+	{
+		Collapse collapse = collapses.top();
+		collapses.pop();
+		unsigned int a = collapse.kept, b = collapse.removed;
+		if (vertexRemoved[a] || vertexRemoved[b] || stamps[a] != collapse.keptStamp || stamps[b] != collapse.removedStamp)
+			continue;
+		if (!canCollapse(collapse))
+			continue;
+
+		// Attributes at the target's place along the edge
+		glm::vec3 edge = positions[b] - positions[a];
+		float edgeLength2 = glm::dot(edge, edge);
+		float t = edgeLength2 > 0.0f ? glm::clamp(glm::dot(collapse.target - positions[a], edge) / edgeLength2, 0.0f, 1.0f) : 0.0f;
+		glm::vec3 normal = normals[a] * (1.0f - t) + normals[b] * t;
+		if (glm::length(normal) > 0.0f)
+			normals[a] = glm::normalize(normal);
+		texCoords[a] = texCoords[a] * (1.0f - t) + texCoords[b] * t;
+		positions[a] = collapse.target;
+		AddQuadric(quadrics[a], quadrics[b]);
+		vertexRemoved[b] = 1;
+		collapsedInto[b] = a;
+
+		for (unsigned int f : vertexFaces[b])
+		{
+			if (faceRemoved[f])
+				continue;
+			auto& face = workFaces[f];
+			if (face[0] == a || face[1] == a || face[2] == a)
+			{
+				faceRemoved[f] = 1;
+				liveFaces--;
+				continue;
+			}
+			for (unsigned int& v : face)
+			{
+				if (v == b)
+					v = a;
+			}
+			vertexFaces[a].push_back(f);
+		}
+		std::vector<unsigned int>().swap(vertexFaces[b]);
+		auto& facesOfA = vertexFaces[a];
+		facesOfA.erase(std::remove_if(facesOfA.begin(), facesOfA.end(), [&](unsigned int f) { return faceRemoved[f] != 0; }),
+			facesOfA.end());
+		stamps[a]++;
+
+		mark++;
+		for (unsigned int f : facesOfA)
+		{
+			for (unsigned int v : workFaces[f])
+			{
+				if (v != a && marks[v] != mark)
+				{
+					marks[v] = mark;
+					collapses.push(evaluate(a, v));
+				}
+			}
+		}
+	}
+
+	// Error: each input vertex against the faces around the vertex it ended up in
+	float error = 0.0f;
+	for (std::size_t v = 0; v < nv; v++)
+	{
+		unsigned int root = static_cast<unsigned int>(v);
+		while (collapsedInto[root] != noVertex)
+			root = collapsedInto[root];
+		for (unsigned int u = static_cast<unsigned int>(v); collapsedInto[u] != noVertex && collapsedInto[u] != root;)
+		{
+			unsigned int next = collapsedInto[u];
+			collapsedInto[u] = root;
+			u = next;
+		}
+
+		float distance = -1.0f;
+		for (unsigned int f : vertexFaces[root])
+		{
+			if (faceRemoved[f])
+				continue;
+			const auto& face = workFaces[f];
+			glm::vec3 closest = GetClosestPointOnTriangle(geometry.positions[v], positions[face[0]], positions[face[1]],
+				positions[face[2]]);
+			float d = glm::length(geometry.positions[v] - closest);
+			distance = distance < 0.0f ? d : std::min(distance, d);
+		}
+		error = std::max(error, distance);
+	}
+
+	// The remaining vertices in the order the faces first use them
+	std::vector<unsigned int> remap(nv, noVertex);
+	unsigned int used = 0;
+	simplifiedFaces.clear();
+	simplifiedFaces.reserve(liveFaces);
+	for (std::size_t f = 0; f < nf; f++)
+	{
+		if (faceRemoved[f])
+			continue;
+		std::array<unsigned int, 3> face;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = workFaces[f][k];
+			if (remap[v] == noVertex)
+				remap[v] = used++;
+			face[k] = remap[v];
+		}
+		simplifiedFaces.push_back(face);
+	}
+	simplified = MeshGeometry();
+	simplified.Resize(used);
+	for (std::size_t v = 0; v < nv; v++)
+	{
+		if (remap[v] == noVertex)
+			continue;
+		simplified.positions[remap[v]] = positions[v];
+		simplified.normals[remap[v]] = normals[v];
+		simplified.texCoords[remap[v]] = texCoords[v];
+	}
+
+	statistics.verticesAfter = used;
+	statistics.facesAfter = simplifiedFaces.size();
+	statistics.error = error;
+	statistics.milliseconds = simplifyTimer.ElapsedMilliseconds();
+	return statistics;
+}
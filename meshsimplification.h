@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "meshgeometry.h"
+
+// Coarser levels of detail built for every mesh Model loads (see Model::SelectLevelsOfDetail); set before the
+// models are loaded
+struct LevelOfDetailOptions
+{
+	bool enabled = false;
+	unsigned int levelCount = 5; // including the full resolution; at most maxLevelOfDetailCount
+	float reduction = 0.5f; // faces of each level relative to the level before
+	// How much more a collapse costs where the surface is most curved than where it is flat, so ridges and
+	// valleys (and the lines drawn along them) survive longer; 0 is plain quadric error
+	float curvatureWeight = 8.0f;
+	float pixelError = 1.0f; // largest error a level may show on screen, in pixels
+};
+static const unsigned int maxLevelOfDetailCount = 6;
+void SetLevelOfDetailOptions(const LevelOfDetailOptions& options);
+const LevelOfDetailOptions& GetLevelOfDetailOptions();
+// Changes whenever the options change the levels Model builds (pixelError only picks among them); 0 when
+// disabled. Part of the mesh cache key.
+std::uint32_t GetLevelOfDetailKey();
+
+struct SimplificationStatistics
+{
+	std::size_t verticesBefore, verticesAfter;
+	std::size_t facesBefore, facesAfter;
+	// Largest distance from a vertex of the input to the faces its vertex was collapsed into (object space), an
+	// estimate of the one sided Hausdorff distance
+	float error;
+	double milliseconds;
+};
+
+// Collapse edges in order of their quadric error (Garland and Heckbert) until at most targetFaceCount faces are
+// left or no collapse keeps the surface manifold and unflipped. Each vertex's quadric is scaled by its largest
+// principal curvature magnitude (curv1, curv2; unscaled if they are missing) against the mesh's median, by up to
+// 1 + curvatureWeight, and boundary edges are held in place by perpendicular planes. Vertices split along
+// texture seams are boundaries on either side, so they stay where they are (weld them first to simplify across).
+// simplified receives positions, normals and texture coordinates interpolated along the collapsed edges; every
+// other attribute is sized but left to be derived.
+SimplificationStatistics SimplifyMesh(const MeshGeometry& geometry, const std::vector<std::array<unsigned int, 3>>& faces,
+	std::size_t targetFaceCount, float curvatureWeight, MeshGeometry& simplified,
+	std::vector<std::array<unsigned int, 3>>& simplifiedFaces);
@@ -1,29 +1,430 @@
 #include "model.h"
 
-void Model::Draw(const Shader& shader)
+Model::~Model()
+{
+	batch.Destroy();
+	for (auto& i : meshes)
+		i.DeleteGpuObjects();
+	for (auto& levels : levelsOfDetail)
+	{
+		for (auto& level : levels)
+			level.mesh.DeleteGpuObjects();
+	}
+}
+void Model::Upload(const Shader& shader)
 {
+	if (IsMeshBatchingEnabled())
+	{
+		batch.Build(meshes, shader);
+		return;
+	}
 	for (auto& i : meshes)
-		i.Draw(shader);
+		i.Upload(shader);
+	for (auto& levels : levelsOfDetail)
+	{
+		for (auto& level : levels)
+			level.mesh.Upload(shader);
+	}
+}
+void Model::Draw(const Shader& shader)
+{
+	// Every slot the draws below bind is uploaded here, once; the draws only bind ranges
+	for (auto& mesh : meshes)
+		mesh.UpdateMaterialSlot();
+	for (auto& levels : levelsOfDetail)
+	{
+		for (auto& level : levels)
+			level.mesh.UpdateMaterialSlot();
+	}
+	GetMaterialPool().Upload();
+
+	const unsigned char* visible = IsFrustumCullingEnabled() && !visibleParts.empty() ? visibleParts.data() : nullptr;
+	if (IsMeshBatchingEnabled() && (batch.HasAttributes(shader) || batch.Build(meshes, shader)))
+	{
+		batch.Draw(shader, visible, &drawStatistics);
+		return;
+	}
+
+	Timer drawTimer;
+	std::size_t drawn = 0, triangles = 0;
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		if (visible && std::find(visible + partOffsets[i], visible + partOffsets[i + 1], 1) == visible + partOffsets[i + 1])
+			continue;
+		// The BVH holds the parts of the full resolution only, so a coarser level is drawn whole
+		Mesh& mesh = GetSelectedMesh(i);
+		mesh.Draw(shader, visible && &mesh == &meshes[i] ? visible + partOffsets[i] : nullptr);
+		triangles += mesh.GetIndexCount() / 3;
+		drawn++;
+	}
+	drawStatistics.meshes = drawn;
+	drawStatistics.drawCalls = drawn;
+	drawStatistics.triangles = triangles;
+	drawStatistics.milliseconds = drawTimer.ElapsedMilliseconds();
+}
+const DrawStatistics& Model::GetDrawStatistics() const
+{
+	return drawStatistics;
+}
+void Model::Cull(const glm::mat4& clipFromObject, const glm::vec3& eye)
+{
+	if (IsFrustumCullingEnabled())
+		bvh.Cull(Frustum(clipFromObject), visibleParts, &cullStatistics);
+	if (IsMeshletCullingEnabled())
+	{
+		for (std::size_t i = 0; i < meshes.size(); i++)
+			GetSelectedMesh(i).CullMeshlets(eye);
+	}
+}
+const CullStatistics& Model::GetCullStatistics() const
+{
+	return cullStatistics;
 }
+void Model::SelectLevelsOfDetail(const glm::mat4& projection, const glm::mat4& viewFromObject, float viewportHeight)
+{
+	const LevelOfDetailOptions& options = GetLevelOfDetailOptions();
+	// The batch holds the full resolution only, and the line passes must lie on the surface it draws
+	if (IsMeshBatchingEnabled())
+	{
+		selectedLevels.assign(selectedLevels.size(), 0);
+		return;
+	}
+	// Pixels per view space unit at distance 1
+	float pixelsPerUnit = 0.5f * viewportHeight * projection[1][1];
+	float scale = glm::length(glm::vec3(viewFromObject[0]));
+	for (std::size_t i = 0; i < selectedLevels.size(); i++)
+	{
+		selectedLevels[i] = 0;
+		const auto& levels = levelsOfDetail[i];
+		if (levels.empty())
+			continue;
+		const BoundingBox& bounds = meshes[i].GetBounds();
+		glm::vec3 center = glm::vec3(viewFromObject * glm::vec4(bounds.GetCenter(), 1.0f));
+		float distance = glm::length(center) - 0.5f * scale * glm::length(bounds.max - bounds.min);
+		if (distance <= 0.0f)
+			continue; // the eye is within the bounding sphere
+		// The errors grow with the level, so the first level that fits from the coarsest end is the coarsest one
+		for (std::size_t level = levels.size(); level > 0; level--)
+		{
+			if (levels[level - 1].error * scale * pixelsPerUnit / distance <= options.pixelError)
+			{
+				selectedLevels[i] = static_cast<unsigned int>(level);
+				break;
+			}
+		}
+	}
+}
+Mesh& Model::GetSelectedMesh(std::size_t i)
+{
+	unsigned int level = i < selectedLevels.size() ? selectedLevels[i] : 0;
+	return level > 0 ? levelsOfDetail[i][level - 1].mesh : meshes[i];
+}
+const Mesh& Model::GetSelectedMesh(std::size_t i) const
+{
+	unsigned int level = i < selectedLevels.size() ? selectedLevels[i] : 0;
+	return level > 0 ? levelsOfDetail[i][level - 1].mesh : meshes[i];
+}
+MeshletStatistics Model::GetMeshletStatistics() const
+{
+	MeshletStatistics total = MeshletStatistics();
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		const MeshletStatistics& statistics = GetSelectedMesh(i).GetMeshletStatistics();
+		total.meshletCount += statistics.meshletCount;
+		total.frontFacing += statistics.frontFacing;
+		total.backFacing += statistics.backFacing;
+		total.triangleCount += statistics.triangleCount;
+		total.trianglesKept += statistics.trianglesKept;
+	}
+	return total;
+}
+const BoundingBox& Model::GetBounds() const
+{
+	return bvh.GetBounds();
+}
+const std::vector<Mesh>& Model::GetMeshes() const
+{
+	return meshes;
+}
+void Model::DrawSilhouettes(const Shader& shader, const glm::vec3& eye)
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+		GetSelectedMesh(i).DrawSilhouettes(shader, eye);
+}
+void Model::DrawSuggestiveContours(const glm::vec3& eye, const SuggestiveContourOptions& options)
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+		GetSelectedMesh(i).DrawSuggestiveContours(eye, options);
+}
+void Model::DrawSuggestiveContoursGpu(const Shader& shader)
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+		GetSelectedMesh(i).DrawSuggestiveContoursGpu(shader);
+}
+SuggestiveContourStatistics Model::GetSuggestiveContourStatistics() const
+{
+	SuggestiveContourStatistics total = SuggestiveContourStatistics();
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		const SuggestiveContourStatistics& statistics = GetSelectedMesh(i).GetSuggestiveContourStatistics();
+		total.facesTested += statistics.facesTested;
+		total.zeroCrossings += statistics.zeroCrossings;
+		total.segments += statistics.segments;
+		total.milliseconds += statistics.milliseconds;
+	}
+	return total;
+}
+void Model::UpdateApparentRidges(const glm::vec3& eye, float viewTolerance)
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+		GetSelectedMesh(i).UpdateApparentRidges(eye, viewTolerance);
+}
+void Model::DrawApparentRidges(const Shader& shader)
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+		GetSelectedMesh(i).DrawApparentRidges(shader);
+}
+ApparentRidgeStatistics Model::GetApparentRidgeStatistics() const
+{
+	ApparentRidgeStatistics total = ApparentRidgeStatistics();
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		const ApparentRidgeStatistics& statistics = GetSelectedMesh(i).GetApparentRidgeStatistics();
+		total.updatedVertices += statistics.updatedVertices;
+		total.updatedDerivatives += statistics.updatedDerivatives;
+		total.streamedBytes += statistics.streamedBytes;
+		total.milliseconds += statistics.milliseconds;
+	}
+	return total;
+}
+void Model::RecomputeCurvatures()
+{
+	for (auto& mesh : meshes)
+	{
+		mesh.InvalidateGeometry();
+		mesh.UpdateCurvatureStages();
+	}
+}
+// Assimp post processing used for every model; part of the mesh cache key
+static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenNormals; // aiProcess_FlipUVs if need
+
+static void LogLoadStatistics(const std::string& path, const char* source, const Timer& loadTimer,
+	std::size_t residentBefore)
+{
+	const double megabyte = 1024.0 * 1024.0;
+	std::cout << "Model: " << path << " " << source << " in " << loadTimer.ElapsedMilliseconds() << " ms, resident "
+		<< (static_cast<double>(GetCurrentResidentSetSize()) - static_cast<double>(residentBefore)) / megabyte
+		<< " MB more than before, peak resident " << GetPeakResidentSetSize() / megabyte << " MB\n";
+}
+
 void Model::LoadModel(const std::string& path)
 {
+	if (LoadGeometry(path))
+		CreateTextures();
+}
+bool Model::LoadGeometry(const std::string& path)
+{
+	Timer loadTimer;
+	std::size_t residentBefore = GetCurrentResidentSetSize();
+	directory = path.substr(0, path.find_last_of('/'));
+
+	MeshCacheKey cacheKey;
+	bool cacheable = IsMeshCacheEnabled() && GetMeshCacheKey(path, importFlags, GetMeshOptimizationKey(),
+		GetLevelOfDetailKey(), cacheKey);
+	std::string cachePath = GetMeshCachePath(path);
+	if (cacheable && LoadCachedModel(cachePath, cacheKey))
+	{
+		// The levels of detail came from the cache as well
+		ShareVertexQuantization();
+		BuildBoundingVolumes();
+		RecordLoadTimes(loadTimer);
+		LogLoadStatistics(path, "loaded from cache", loadTimer, residentBefore);
+		return true;
+	}
+
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenNormals); // aiProcess_FlipUVs if need
+	const aiScene* scene = importer.ReadFile(path, importFlags);
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
 		std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << '\n';
-		return;
+		return false;
 	}
-	directory = path.substr(0, path.find_last_of('/'));
 
+	meshes.reserve(meshes.size() + scene->mNumMeshes);
 	ProcessNode(scene->mRootNode, scene);
+	ShareVertexQuantization();
+	BuildBoundingVolumes();
+	BuildLevelsOfDetail();
+	RecordLoadTimes(loadTimer);
+	LogLoadStatistics(path, "imported", loadTimer, residentBefore);
+
+	if (cacheable)
+	{
+		std::vector<std::vector<MeshCacheLevelOfDetail>> cachedLevels(levelsOfDetail.size());
+		for (std::size_t i = 0; i < levelsOfDetail.size(); i++)
+		{
+			for (const auto& level : levelsOfDetail[i])
+				cachedLevels[i].push_back(MeshCacheLevelOfDetail{ &level.mesh, level.error });
+		}
+		WriteMeshCache(cachePath, cacheKey, meshes, cachedLevels);
+	}
+	return true;
+}
+void Model::CreateTextures()
+{
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		std::vector<Texture> textures;
+		for (const auto& texture : meshes[i].GetTextures())
+			textures.push_back(GetTextureLoader().Load(texture.GetPath(), directory, texture.GetType()));
+		// Copies share the texture objects
+		for (auto& level : levelsOfDetail[i])
+			level.mesh.SetTextures(textures);
+		meshes[i].SetTextures(std::move(textures));
+	}
+}
+void Model::RecordLoadTimes(const Timer& loadTimer)
+{
+	curvatureMilliseconds = 0.0;
+	for (const auto& mesh : meshes)
+		curvatureMilliseconds += mesh.GetCurvatureMilliseconds();
+	loadMilliseconds = loadTimer.ElapsedMilliseconds() - curvatureMilliseconds;
+}
+void Model::BuildBoundingVolumes()
+{
+	Timer buildTimer;
+	std::vector<BoundingBox> partBounds;
+	partOffsets.assign(1, 0);
+	for (const auto& mesh : meshes)
+	{
+		for (const auto& part : mesh.GetParts())
+			partBounds.push_back(part.bounds);
+		partOffsets.push_back(partBounds.size());
+	}
+	bvh.Build(partBounds);
+	visibleParts.clear();
+	std::cout << "BVH: " << partBounds.size() << " parts of " << meshes.size() << " meshes, " << bvh.GetNodeCount()
+		<< " nodes, " << buildTimer.ElapsedMilliseconds() << " ms, " << bvh.GetMemoryUsage() / 1024 << " KB\n";
+}
+void Model::ShareVertexQuantization()
+{
+	VertexQuantization quantization;
+	for (const auto& mesh : meshes)
+		quantization.Expand(mesh.GetVertexQuantization());
+	for (auto& mesh : meshes)
+		mesh.SetVertexQuantization(quantization);
+}
+// Bytes of the streams a surface shader like teapot.vshader reads, in the current vertex format, and the indices
+static std::size_t GetSurfaceMemoryUsage(const Mesh& mesh)
+{
+	std::size_t bytes = mesh.GetIndexCount() * sizeof(GLuint);
+	for (VertexAttribute attribute : { ATTRIBUTE_POSITION, ATTRIBUTE_NORMAL, ATTRIBUTE_TEXCOORDS })
+		bytes += mesh.GetVertexCount() * GetVertexStreamFormat(GetVertexFormat(), attribute).stride;
+	return bytes;
+}
+static void LogLevelOfDetail(std::size_t meshIndex, std::size_t level, const Mesh& mesh, float error, double milliseconds)
+{
+	float diagonal = glm::length(mesh.GetBounds().max - mesh.GetBounds().min);
+	std::cout << "LOD: mesh " << meshIndex << " level " << level << ", " << mesh.GetIndexCount() / 3 << " faces, "
+		<< mesh.GetVertexCount() << " vertices, error " << error << " (" << 100.0f * error / (diagonal + 1e-30f)
+		<< "% of the diagonal), surface streams " << GetSurfaceMemoryUsage(mesh) / 1024 << " KB, geometry "
+		<< mesh.GetGeometry().GetMemoryUsage() / 1024 << " KB, " << milliseconds << " ms\n";
+}
+void Model::BuildLevelsOfDetail()
+{
+	const LevelOfDetailOptions& options = GetLevelOfDetailOptions();
+	levelsOfDetail.resize(meshes.size());
+	selectedLevels.assign(meshes.size(), 0);
+	if (!options.enabled)
+		return;
+
+	unsigned int levelCount = std::min(std::max(options.levelCount, 1u), maxLevelOfDetailCount);
+	for (std::size_t i = 0; i < meshes.size(); i++)
+	{
+		auto& levels = levelsOfDetail[i];
+		if (!levels.empty() || meshes[i].GetIndices().size() != 3 * meshes[i].GetFaces().size())
+			continue;
+		levels.reserve(levelCount - 1); // source must stay valid as levels grows
+		LogLevelOfDetail(i, 0, meshes[i], 0.0f, 0.0);
+
+		const Mesh* source = &meshes[i];
+		float error = 0.0f;
+		for (unsigned int level = 1; level < levelCount; level++)
+		{
+			Timer levelTimer;
+			std::size_t sourceFaces = source->GetFaces().size();
+			std::size_t targetFaces = static_cast<std::size_t>(sourceFaces * options.reduction);
+			MeshGeometry geometry;
+			std::vector<std::array<unsigned int, 3>> faces;
+			SimplificationStatistics statistics = SimplifyMesh(source->GetGeometry(), source->GetFaces(), targetFaces,
+				options.curvatureWeight, geometry, faces);
+			// Less than half way to the target: the remaining collapses would fold the surface, so a further
+			// level would not be any coarser
+			if (faces.empty() || 2 * statistics.facesAfter > sourceFaces + targetFaces)
+				break;
+
+			if (GetMeshOptimizationOptions().enabled)
+			{
+				std::vector<unsigned int> order;
+				OptimizeVertexCache(faces, geometry.GetVertexCount(), order);
+				std::vector<std::array<unsigned int, 3>> orderedFaces(faces.size());
+				for (std::size_t f = 0; f < order.size(); f++)
+					orderedFaces[f] = faces[order[f]];
+				faces.swap(orderedFaces);
+				OptimizeVertexFetch(geometry, faces);
+			}
+			std::vector<unsigned int> indices;
+			indices.reserve(3 * faces.size());
+			for (const auto& face : faces)
+				indices.insert(indices.end(), face.begin(), face.end());
+			VertexFaceAdjacency adjacentFaces;
+			adjacentFaces.Build(faces, geometry.GetVertexCount());
+
+			// The errors add up, as each level is simplified from the one before
+			error += statistics.error;
+			levels.push_back(LevelOfDetail{ Mesh(std::move(geometry), std::move(faces), std::move(indices),
+				std::move(adjacentFaces), source->GetTextures(), source->GetMaterial()), error });
+			source = &levels.back().mesh;
+			LogLevelOfDetail(i, level, *source, error, levelTimer.ElapsedMilliseconds());
+		}
+	}
+}
+double Model::GetCurvatureMilliseconds() const { return curvatureMilliseconds; }
+double Model::GetLoadMilliseconds() const { return loadMilliseconds; }
+bool Model::LoadCachedModel(const std::string& cachePath, const MeshCacheKey& key)
+{
+	std::vector<MeshCacheEntry> entries;
+	if (!ReadMeshCache(cachePath, key, entries))
+		return false;
+
+	meshes.reserve(meshes.size() + entries.size());
+	levelsOfDetail.resize(meshes.size());
+	for (auto& entry : entries)
+	{
+		std::vector<Texture> textures;
+		for (const auto& texture : entry.textures)
+			textures.push_back(LoadTexture(texture.path, texture.type));
+
+		Mesh mesh(std::move(entry.geometry), std::move(entry.faces), std::move(entry.indices),
+			std::move(entry.adjacentFaces), std::move(textures), entry.mat, std::move(entry.cornerAreas),
+			entry.validCurvatureStages);
+		if (entry.level == 0)
+		{
+			meshes.push_back(std::move(mesh));
+			levelsOfDetail.emplace_back();
+		}
+		else
+			levelsOfDetail.back().push_back(LevelOfDetail{ std::move(mesh), entry.error });
+	}
+	selectedLevels.assign(meshes.size(), 0);
+	return true;
 }
 void Model::ProcessNode(aiNode* node, const aiScene* scene)
 {
 	for (auto i = 0; i != node->mNumMeshes; ++i)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(ProcessMesh(mesh, scene));
+		ProcessMesh(mesh, scene);
 	}
 
 	for (auto i = 0; i != node->mNumChildren; ++i)
@@ -31,55 +432,24 @@ void Model::ProcessNode(aiNode* node, const aiScene* scene)
 		ProcessNode(node->mChildren[i], scene);
 	}
 }
-Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 {
-	std::vector<Vertex> vertices;
+	MeshGeometry geometry;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 
-	vertices.reserve(mesh->mNumVertices);
+	geometry.Resize(mesh->mNumVertices);
 	indices.reserve(mesh->mNumVertices);
 
 	for (auto i = 0; i != mesh->mNumVertices; ++i)
 	{
-		Vertex vertex;
-		
-		glm::vec3 vector;
-		std::array<float, 3> position;
-		vector.x = mesh->mVertices[i].x;
-		vector.y = mesh->mVertices[i].y;
-		vector.z = mesh->mVertices[i].z;
-		vertex.position = vector;
-
-		vector.x = mesh->mNormals[i].x;
-		vector.y = mesh->mNormals[i].y;
-		vector.z = mesh->mNormals[i].z;
-		vertex.normal = vector;
+		geometry.positions[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		geometry.normals[i] = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
 
 		if (mesh->mTextureCoords[0])
-		{
-			glm::vec2 vec;
-			vec.x = mesh->mTextureCoords[0][i].x;
-			vec.y = mesh->mTextureCoords[0][i].y;
-			vertex.texCoords = vec;
-		}
+			geometry.texCoords[i] = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 		else
-			vertex.texCoords = glm::vec2(0.0f, 0.0f);
-
-		vertex.cornerArea = glm::vec3(0.0f, 0.0f, 0.0f);
-		vertex.pointArea = 0.0f;
-
-		vertex.pdir1 = glm::vec3(0.0f, 0.0f, 0.0f);
-		vertex.pdir2 = glm::vec3(0.0f, 0.0f, 0.0f);
-		vertex.curv1 = 0.0f;
-		vertex.curv2 = 0.0f;
-		vertex.dcurv = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
-
-		vertex.q1 = 0.0f;
-		vertex.t1 = glm::vec2(0.0f, 0.0f);
-		vertex.dt1q1 = 0.0f;
-
-		vertices.push_back(vertex);
+			geometry.texCoords[i] = glm::vec2(0.0f, 0.0f);
 	}
 
 	/* for (auto i = 0; i != mesh->mNumFaces; ++i)
@@ -107,32 +477,22 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 		faces.push_back(faceIndex);
 	}
 
-	std::vector<std::vector<unsigned int>> adjacentFaces;
-	int nv = vertices.size(), nf = faces.size();
-	std::vector<unsigned int> numAdjacentFaces(nv);
-	std::array<unsigned int, 3> face;
-	for (int i = 0; i < nf; i++)
-	{
-		face = faces[i];
-		numAdjacentFaces[face[0]]++;
-		numAdjacentFaces[face[1]]++;
-		numAdjacentFaces[face[2]]++;
-	}
-
-	adjacentFaces.resize(vertices.size());
-	for (int i = 0; i < nv; i++)
+	const MeshOptimizationOptions& optimizationOptions = GetMeshOptimizationOptions();
+	if (optimizationOptions.enabled && indices.size() == 3 * faces.size())
 	{
-		adjacentFaces[i].reserve(numAdjacentFaces[i]);
+		MeshOptimizationStatistics statistics = OptimizeMesh(geometry, faces, optimizationOptions);
+		indices.clear();
+		for (const auto& face : faces)
+			indices.insert(indices.end(), face.begin(), face.end());
+		std::cout << "Optimize: " << statistics.verticesBefore << " -> " << statistics.verticesAfter << " vertices, "
+			<< statistics.facesBefore << " -> " << statistics.facesAfter << " faces, ACMR " << statistics.before.acmr
+			<< " -> " << statistics.welded.acmr << " (welded) -> " << statistics.after.acmr << ", ATVR "
+			<< statistics.before.atvr << " -> " << statistics.welded.atvr << " (welded) -> " << statistics.after.atvr
+			<< ", " << statistics.milliseconds << " ms\n";
 	}
 
-	for (int i = 0; i < nf; i++)
-	{
-		face = faces[i];
-		for (int j = 0; j < 3; j++)
-		{
-			adjacentFaces[face[j]].push_back(i);
-		}
-	}
+	VertexFaceAdjacency adjacentFaces;
+	adjacentFaces.Build(faces, geometry.GetVertexCount());
 
 	Material mat;
 	if (mesh->mMaterialIndex >= 0)
@@ -161,7 +521,8 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 		mat.ks = glm::vec3(0.4f, 0.4f, 0.0f);
 	}
 
-	return Mesh{ vertices, faces, indices, adjacentFaces, textures, mat };
+	meshes.emplace_back(std::move(geometry), std::move(faces), std::move(indices), std::move(adjacentFaces),
+		std::move(textures), mat);
 }
 void Model::LoadMaterialTextures(std::vector<Texture>& textures, aiMaterial* mat, aiTextureType type, const std::string& typeName)
 {
@@ -170,23 +531,12 @@ void Model::LoadMaterialTextures(std::vector<Texture>& textures, aiMaterial* mat
 		aiString str;
 		mat->GetTexture(type, i, &str);
 
-		bool skip = false;
-		auto texturesLoadedSize = textures_loaded.size();
-		for (auto j = 0; j != texturesLoadedSize; ++j)
-		{
-			if (std::strcmp(textures_loaded[j].GetPath().data(), str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true;
-				break;
-			}
-		}
-		if (!skip)
-		{
-			Texture texture;
-			texture.LoadTextureUsingDirectory(str.C_Str(), this->directory, typeName);
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
-		}
+		textures.push_back(LoadTexture(str.C_Str(), typeName));
 	}
+}
+Texture Model::LoadTexture(const std::string& path, const std::string& typeName)
+{
+	Texture texture;
+	texture.SetSource(path, typeName);
+	return texture;
 }
\ No newline at end of file
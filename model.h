@@ -12,23 +12,104 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include "bvh.h"
+#include "memorystats.h"
 #include "mesh.h"
+#include "meshbatch.h"
+#include "meshcache.h"
+#include "meshsimplification.h"
 #include "shader.h"
 #include "texture.h"
+#include "textureloader.h"
+#include "timer.h"
 
 class Model
 {
 public:
 	Model() = default;
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	~Model(); // deletes the meshes' GPU objects, so it must run on the GL thread
+
+	// LoadGeometry followed by CreateTextures
 	void LoadModel(const std::string& path);
+	// Import (or read from the mesh cache) and compute curvature. Makes no GL calls, so it can run
+	// on a worker thread; the textures are only named until CreateTextures is called.
+	bool LoadGeometry(const std::string& path);
+	// Request the textures named by LoadGeometry from the TextureLoader. GL thread only.
+	void CreateTextures();
+	// Create every mesh's GPU objects now instead of on the first Draw. GL thread only.
+	void Upload(const Shader& shader);
+	// Every mesh with its own draw call, or all of them through the MeshBatch if batching is enabled
+	// (the shader must then read the material colours the way batch.vshader does). With frustum culling
+	// enabled only the mesh parts found visible by the last Cull are drawn, and with meshlet culling meshes
+	// drawn one by one leave out their back facing meshlets. Meshes drawn one by one use the level of detail
+	// picked by the last SelectLevelsOfDetail.
 	void Draw(const Shader& shader);
+	const DrawStatistics& GetDrawStatistics() const; // of the last Draw
+	// Test the mesh parts against the clip volume of clipFromObject (projection * view * model) if frustum
+	// culling is enabled, and the meshlets against eye (model space) if meshlet culling is
+	void Cull(const glm::mat4& clipFromObject, const glm::vec3& eye);
+	const CullStatistics& GetCullStatistics() const; // of the last Cull
+	MeshletStatistics GetMeshletStatistics() const; // summed over the meshes
+	const BoundingBox& GetBounds() const; // of every mesh, in model space
+	const std::vector<Mesh>& GetMeshes() const; // at full resolution
+	// Pick for every mesh the coarsest level of detail whose error, projected at the distance of the mesh's bounding
+	// sphere, stays within LevelOfDetailOptions::pixelError. Cull, Draw and the line passes use it until the next
+	// call. viewFromObject is view * model (scaling uniformly); viewportHeight is in pixels. While mesh batching is
+	// enabled every mesh stays at full resolution, as the batch holds no other level.
+	void SelectLevelsOfDetail(const glm::mat4& projection, const glm::mat4& viewFromObject, float viewportHeight);
+	// Silhouette and boundary lines of every mesh for an eye position in model space (see Mesh::DrawSilhouettes)
+	void DrawSilhouettes(const Shader& shader, const glm::vec3& eye);
+	// Suggestive contours of every mesh, extracted on the CPU or by the shader (see Mesh::DrawSuggestiveContours)
+	void DrawSuggestiveContours(const glm::vec3& eye, const SuggestiveContourOptions& options);
+	void DrawSuggestiveContoursGpu(const Shader& shader);
+	SuggestiveContourStatistics GetSuggestiveContourStatistics() const; // summed over the meshes
+	// View dependent curvature and apparent ridges of every mesh (see Mesh::UpdateApparentRidges)
+	void UpdateApparentRidges(const glm::vec3& eye, float viewTolerance);
+	void DrawApparentRidges(const Shader& shader);
+	ApparentRidgeStatistics GetApparentRidgeStatistics() const; // summed over the meshes
+	// Recompute the curvature stages of every full resolution mesh from scratch (Mesh::InvalidateGeometry, then
+	// UpdateCurvatureStages), e.g. to time them with other worker thread counts. The geometry is unchanged, so
+	// the line stages are not rebuilt. Needs the CPU geometry.
+	void RecomputeCurvatures();
+
+	double GetCurvatureMilliseconds() const; // spent in LoadGeometry
+	double GetLoadMilliseconds() const; // spent in LoadGeometry apart from the curvature
 private:
-	std::vector<Texture> textures_loaded;
 	std::vector<Mesh> meshes;
+	MeshBatch batch; // built by the first batched Draw
+	DrawStatistics drawStatistics = DrawStatistics();
+	// The parts of every mesh in order; mesh i has items [partOffsets[i], partOffsets[i + 1]) of the BVH
+	BoundingVolumeHierarchy bvh;
+	std::vector<std::size_t> partOffsets;
+	std::vector<unsigned char> visibleParts; // by BVH item, from the last Cull
+	CullStatistics cullStatistics = CullStatistics();
+	// Coarser versions of each mesh, if levels of detail are enabled: levelsOfDetail[i][l] is level l + 1 of
+	// meshes[i], simplified from level l. Each is a Mesh of its own, with its own curvature and line structures.
+	struct LevelOfDetail
+	{
+		Mesh mesh;
+		float error; // largest distance from meshes[i] (object space), summed over the simplifications
+	};
+	std::vector<std::vector<LevelOfDetail>> levelsOfDetail;
+	std::vector<unsigned int> selectedLevels; // by mesh, from the last SelectLevelsOfDetail; 0 is meshes[i] itself
 	std::string directory;
+	double loadMilliseconds = 0.0;
+	double curvatureMilliseconds = 0.0;
 
+	// Rebuilds meshes and their levels of detail from the mesh cache; returns false if there is no valid cache for
+	// the key
+	bool LoadCachedModel(const std::string& cachePath, const MeshCacheKey& key);
+	void RecordLoadTimes(const Timer& loadTimer);
+	void BuildBoundingVolumes(); // once the meshes are loaded
+	void ShareVertexQuantization(); // likewise: one range over every mesh, so they can be batched
+	void BuildLevelsOfDetail(); // likewise, for the meshes that have none yet
+	Mesh& GetSelectedMesh(std::size_t i); // the level of mesh i picked by the last SelectLevelsOfDetail
+	const Mesh& GetSelectedMesh(std::size_t i) const;
 	void ProcessNode(aiNode* node, const aiScene* scene);
-	Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
+	void ProcessMesh(aiMesh* mesh, const aiScene* scene); // appends the converted mesh to meshes
 	void LoadMaterialTextures(std::vector<Texture>& textures, aiMaterial* mat, aiTextureType type,
 		const std::string& typeName);
+	Texture LoadTexture(const std::string& path, const std::string& typeName); // named only, see CreateTextures
 };
\ No newline at end of file
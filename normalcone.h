@@ -0,0 +1,58 @@
+#pragma once
+// Spatial ordering and normal cone tests shared by the clustered structures that skip geometry facing away from
+// the eye (MeshletSet, SilhouetteExtractor)
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Interleave the low 10 bits of x, y and z
+inline std::uint32_t GetMortonCode(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+{
+	auto spread = [](std::uint32_t v)
+	{
+		v &= 0x3FF;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+// Of unit vectors, in radians
+inline float AngleBetween(const glm::vec3& a, const glm::vec3& b)
+{
+	return std::acos(glm::clamp(glm::dot(a, b), -1.0f, 1.0f));
+}
+
+enum ConeFacing : unsigned char
+{
+	CONE_MIXED,
+	CONE_FRONT_FACING, // every normal points towards the eye
+	CONE_BACK_FACING // every normal points away from it
+};
+
+// How the normals within the cone (coneAngle is the half angle, pi when they point everywhere) face the eye, for
+// every point within the sphere
+inline ConeFacing GetConeFacing(const glm::vec3& center, float radius, const glm::vec3& coneAxis, float coneAngle,
+	const glm::vec3& eye)
+{
+	const float pi = 3.14159265f;
+	if (coneAngle >= 0.5f * pi)
+		return CONE_MIXED;
+
+	// For every point p = center + d (|d| <= radius) and normal n within the cone, the sign of dot(n, p - eye)
+	// is fixed when the cone, seen from the eye, stays clear of the perpendicular plane
+	glm::vec3 toCenter = center - eye;
+	float distance = glm::length(toCenter);
+	if (distance <= radius)
+		return CONE_MIXED;
+	float angle = AngleBetween(coneAxis, toCenter / distance);
+	if (distance * std::cos(std::min(pi, angle + coneAngle)) > radius)
+		return CONE_BACK_FACING;
+	if (distance * std::cos(std::max(0.0f, angle - coneAngle)) < -radius)
+		return CONE_FRONT_FACING;
+	return CONE_MIXED;
+}
@@ -0,0 +1,88 @@
+#include "offscreentarget.h"
+#include <cstring>
+#include <iostream>
+#include <stb_image_write.h>
+
+OffscreenTarget::OffscreenTarget()
+{
+	framebufferID = 0;
+	colorBufferID = 0;
+	depthBufferID = 0;
+	width = 0;
+	height = 0;
+}
+OffscreenTarget::~OffscreenTarget()
+{
+	Destroy();
+}
+bool OffscreenTarget::Create(int width, int height)
+{
+	Destroy();
+	this->width = width;
+	this->height = height;
+
+	glGenRenderbuffers(1, &colorBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBufferID);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR::FRAMEBUFFER::NOT_COMPLETE: 0x" << std::hex << status << std::dec << '\n';
+		Destroy();
+		return false;
+	}
+	return true;
+}
+void OffscreenTarget::Destroy()
+{
+	if (framebufferID)
+		glDeleteFramebuffers(1, &framebufferID);
+	if (colorBufferID)
+		glDeleteRenderbuffers(1, &colorBufferID);
+	if (depthBufferID)
+		glDeleteRenderbuffers(1, &depthBufferID);
+	framebufferID = 0;
+	colorBufferID = 0;
+	depthBufferID = 0;
+}
+void OffscreenTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glViewport(0, 0, width, height);
+}
+void OffscreenTarget::Unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+void OffscreenTarget::ReadPixels(std::vector<unsigned char>& pixels)
+{
+	pixels.resize(static_cast<std::size_t>(width) * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferID);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+int OffscreenTarget::GetWidth() const { return width; }
+int OffscreenTarget::GetHeight() const { return height; }
+
+bool WritePixelsPNG(const std::string& fileName, int width, int height, const std::vector<unsigned char>& pixels)
+{
+	// glReadPixels returns the bottom row first. Flip while copying rather than through stb's flip flag, which is
+	// process wide and would race with ImageEncoderPool's threads.
+	std::size_t rowSize = static_cast<std::size_t>(width) * 3;
+	std::vector<unsigned char> rows(rowSize * height);
+	for (int y = 0; y < height; y++)
+		std::memcpy(rows.data() + rowSize * y, pixels.data() + rowSize * (height - 1 - y), rowSize);
+	return stbi_write_png(fileName.c_str(), width, height, 3, rows.data(), static_cast<int>(rowSize)) != 0;
+}
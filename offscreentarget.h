@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// Framebuffer object with an RGBA8 color and a 24 bit depth renderbuffer, for rendering without a window
+class OffscreenTarget
+{
+public:
+	OffscreenTarget();
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+	~OffscreenTarget();
+
+	bool Create(int width, int height);
+	void Destroy();
+	void Bind(); // also sets the viewport to the whole target
+	void Unbind();
+
+	// Tightly packed RGB rows, bottom row first (as glReadPixels returns them)
+	void ReadPixels(std::vector<unsigned char>& pixels);
+
+	int GetWidth() const;
+	int GetHeight() const;
+private:
+	GLuint framebufferID;
+	GLuint colorBufferID;
+	GLuint depthBufferID;
+	int width;
+	int height;
+};
+
+// Write pixels as returned by OffscreenTarget::ReadPixels to a PNG file, top row first
+bool WritePixelsPNG(const std::string& fileName, int width, int height, const std::vector<unsigned char>& pixels);
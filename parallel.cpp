@@ -0,0 +1,103 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include "threadpool.h"
+
+static unsigned int workerThreadCount = 0;
+// Set on the threads running ParallelFor ranges, so nested loops run inline instead of waiting on the pool
+static thread_local bool insideParallelFor = false;
+
+void SetWorkerThreadCount(unsigned int count)
+{
+	workerThreadCount = count;
+}
+unsigned int GetWorkerThreadCount()
+{
+	if (workerThreadCount != 0)
+		return workerThreadCount;
+
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads != 0 ? hardwareThreads : 1;
+}
+
+// Created on the first parallel loop with one thread less than the worker count (the caller is the other one),
+// and shared by every loop after it, from any thread
+static ThreadPool& GetParallelForPool()
+{
+	static ThreadPool pool(std::max(GetWorkerThreadCount(), std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+// One loop's ranges. The caller and the pool jobs claim them through nextRange; a job that starts after the
+// last range was claimed returns without touching body, which only lives as long as the caller waits.
+struct ParallelForRanges
+{
+	const std::function<void(int, int)>* body;
+	int count;
+	int rangeCount;
+	std::atomic<int> nextRange;
+	int finishedRanges;
+	std::mutex mutex;
+	std::condition_variable finished;
+
+	void Run()
+	{
+		bool wasInside = insideParallelFor;
+		insideParallelFor = true;
+		int claimed = 0;
+		for (int range = nextRange++; range < rangeCount; range = nextRange++)
+		{
+			// Contiguous ranges, so each thread walks its own slice of the arrays
+			int begin = static_cast<int>(static_cast<long long>(count) * range / rangeCount);
+			int end = static_cast<int>(static_cast<long long>(count) * (range + 1) / rangeCount);
+			(*body)(begin, end);
+			claimed++;
+		}
+		insideParallelFor = wasInside;
+		if (claimed == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finishedRanges += claimed;
+		if (finishedRanges == rangeCount)
+			finished.notify_all();
+	}
+};
+
+void ParallelFor(int count, const std::function<void(int, int)>& body, int minChunk)
+{
+	if (count <= 0)
+		return;
+
+	int threadCount = static_cast<int>(GetWorkerThreadCount());
+	if (minChunk < 1)
+		minChunk = 1;
+	int maxThreads = (count + minChunk - 1) / minChunk;
+	if (threadCount > maxThreads)
+		threadCount = maxThreads;
+
+	if (threadCount <= 1 || insideParallelFor)
+	{
+		body(0, count);
+		return;
+	}
+
+	auto ranges = std::make_shared<ParallelForRanges>();
+	ranges->body = &body;
+	ranges->count = count;
+	ranges->rangeCount = threadCount;
+	ranges->nextRange = 0;
+	ranges->finishedRanges = 0;
+
+	// The pool may be busy with other loops; whatever its threads have not claimed, the caller runs itself
+	ThreadPool& pool = GetParallelForPool();
+	for (int i = 1; i < threadCount; i++)
+		pool.Submit([ranges]() { ranges->Run(); });
+	ranges->Run();
+
+	std::unique_lock<std::mutex> lock(ranges->mutex);
+	ranges->finished.wait(lock, [&ranges]() { return ranges->finishedRanges == ranges->rangeCount; });
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by ParallelFor (0 means std::thread::hardware_concurrency())
+void SetWorkerThreadCount(unsigned int count);
+unsigned int GetWorkerThreadCount();
+
+// Split [0, count) into up to GetWorkerThreadCount() contiguous ranges of at least minChunk elements and run
+// body(begin, end) for each, on the calling thread and one persistent pool shared by every caller (so loops run
+// every frame or from several threads at once neither create threads nor oversubscribe the CPU). Inputs smaller
+// than 2 * minChunk, and loops nested in a ParallelFor body, run inline.
+void ParallelFor(int count, const std::function<void(int, int)>& body, int minChunk = 1024);
@@ -0,0 +1,182 @@
+#include "programbinarycache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+static const char programBinaryMagic[8] = { 'M', 'R', 'E', 'P', 'R', 'O', 'G', 'B' };
+static const std::uint32_t programBinaryVersion = 1;
+
+struct ProgramBinaryHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t format;
+	std::uint64_t size;
+	std::uint64_t checksum; // of the binary, to catch truncated or damaged files before the driver sees them
+};
+
+// 64 bit FNV-1a
+static std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (std::size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool GLProgramBinaryBackend::IsSupported()
+{
+	if (!GLEW_ARB_get_program_binary)
+		return false;
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+std::string GLProgramBinaryBackend::GetDriverID()
+{
+	std::string id;
+	const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (auto name : names)
+	{
+		const GLubyte* value = glGetString(name);
+		if (value)
+			id += reinterpret_cast<const char*>(value);
+		id += '\n';
+	}
+	return id;
+}
+bool GLProgramBinaryBackend::GetProgramBinary(GLuint program, GLenum& format, std::vector<char>& binary)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	binary.resize(length);
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	binary.resize(written);
+	return written > 0;
+}
+bool GLProgramBinaryBackend::ProgramBinary(GLuint program, GLenum format, const std::vector<char>& binary)
+{
+	glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory, ProgramBinaryBackend& backend)
+	: directory(directory), backend(backend), supported(-1)
+{
+}
+bool ProgramBinaryCache::IsSupported()
+{
+	if (supported < 0)
+		supported = backend.IsSupported() ? 1 : 0;
+	return supported != 0;
+}
+std::string ProgramBinaryCache::ComputeKey(const std::vector<std::string>& stageSources)
+{
+	// Lengths are hashed too, so moving text from one stage to the next changes the key
+	std::uint64_t hash = HashBytes(nullptr, 0);
+	for (const auto& source : stageSources)
+	{
+		std::uint64_t length = source.size();
+		hash = HashBytes(&length, sizeof(length), hash);
+		hash = HashBytes(source.data(), source.size(), hash);
+	}
+	std::string driverID = backend.GetDriverID();
+	hash = HashBytes(driverID.data(), driverID.size(), hash);
+
+	char key[17];
+	std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+	return key;
+}
+bool ProgramBinaryCache::Load(const std::string& key, GLuint program)
+{
+	std::ifstream file(GetFilePath(key), std::ios::binary);
+	if (!file)
+		return false;
+
+	ProgramBinaryHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		std::memcmp(header.magic, programBinaryMagic, sizeof(programBinaryMagic)) != 0 ||
+		header.version != programBinaryVersion || header.size == 0 || header.size > (1u << 30))
+		return false;
+
+	std::vector<char> binary(static_cast<std::size_t>(header.size));
+	if (!file.read(binary.data(), binary.size()) || HashBytes(binary.data(), binary.size()) != header.checksum)
+		return false;
+
+	// A driver update can reject an old binary even with an unchanged version string
+	if (!backend.ProgramBinary(program, header.format, binary))
+	{
+		std::cout << "Program binary " << key << " was rejected by the driver, recompiling\n";
+		return false;
+	}
+	return true;
+}
+bool ProgramBinaryCache::Store(const std::string& key, GLuint program)
+{
+	GLenum format = 0;
+	std::vector<char> binary;
+	if (!backend.GetProgramBinary(program, format, binary))
+		return false;
+
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	ProgramBinaryHeader header;
+	std::memcpy(header.magic, programBinaryMagic, sizeof(programBinaryMagic));
+	header.version = programBinaryVersion;
+	header.format = format;
+	header.size = binary.size();
+	header.checksum = HashBytes(binary.data(), binary.size());
+
+	std::string path = GetFilePath(key);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(binary.data(), binary.size());
+	if (!file)
+	{
+		std::cerr << "ERROR::SHADER::PROGRAM_BINARY_NOT_WRITTEN: " << path << '\n';
+		file.close();
+		std::remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+std::string ProgramBinaryCache::GetFilePath(const std::string& key) const
+{
+	return directory + '/' + key + ".bin";
+}
+
+static bool programBinaryCacheEnabled = true;
+
+void SetProgramBinaryCacheEnabled(bool enabled)
+{
+	programBinaryCacheEnabled = enabled;
+}
+bool IsProgramBinaryCacheEnabled()
+{
+	return programBinaryCacheEnabled;
+}
+ProgramBinaryCache& GetProgramBinaryCache()
+{
+	static GLProgramBinaryBackend backend;
+	static ProgramBinaryCache cache("shadercache", backend);
+	return cache;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// The GL calls used by ProgramBinaryCache. Production code uses GLProgramBinaryBackend; a fake
+// implementation lets the cache logic run without a GPU.
+class ProgramBinaryBackend
+{
+public:
+	virtual ~ProgramBinaryBackend() = default;
+
+	virtual bool IsSupported() = 0;
+	// Identifies the driver; a binary is only valid for the driver that produced it
+	virtual std::string GetDriverID() = 0;
+	virtual bool GetProgramBinary(GLuint program, GLenum& format, std::vector<char>& binary) = 0;
+	// Returns the link status of program after loading the binary
+	virtual bool ProgramBinary(GLuint program, GLenum format, const std::vector<char>& binary) = 0;
+};
+
+class GLProgramBinaryBackend : public ProgramBinaryBackend
+{
+public:
+	bool IsSupported() override;
+	std::string GetDriverID() override;
+	bool GetProgramBinary(GLuint program, GLenum& format, std::vector<char>& binary) override;
+	bool ProgramBinary(GLuint program, GLenum format, const std::vector<char>& binary) override;
+};
+
+// Linked program binaries stored as "<directory>/<key>.bin"
+class ProgramBinaryCache
+{
+public:
+	ProgramBinaryCache(const std::string& directory, ProgramBinaryBackend& backend);
+
+	bool IsSupported();
+	// Hash of every stage source (an empty string for a missing stage) and the driver ID
+	std::string ComputeKey(const std::vector<std::string>& stageSources);
+	// Loads the cached binary into program; returns false if there is none or the driver rejected it,
+	// in which case the caller compiles and links as usual
+	bool Load(const std::string& key, GLuint program);
+	// Saves the binary of a successfully linked program
+	bool Store(const std::string& key, GLuint program);
+private:
+	std::string directory;
+	ProgramBinaryBackend& backend;
+	int supported; // -1 until the backend has been asked
+
+	std::string GetFilePath(const std::string& key) const;
+};
+
+// Cache used by Shader::BuildShader ("shadercache" directory, real GL backend)
+void SetProgramBinaryCacheEnabled(bool enabled);
+bool IsProgramBinaryCacheEnabled();
+ProgramBinaryCache& GetProgramBinaryCache();
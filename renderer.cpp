@@ -1,26 +1,181 @@
 #include "renderer.h"
 
-Renderer::Renderer()
+// Time per frame spent uploading textures that finished decoding
+static const double textureUploadBudgetMilliseconds = 2.0;
+
+Renderer::Renderer(const std::string& modelPath)
 {
 	camera = new Camera(glm::vec3(0.0f, 0.0f, 3.0f));
-	object = new Model();
-	object->LoadModel("teapot/teapot.obj");
+	object = nullptr;
+	if (!modelPath.empty())
+	{
+		object = new Model();
+		object->LoadModel(modelPath);
+	}
 	currentShader = new Shader("teapot.vshader", "teapot.fshader");
 	currentShader->BuildShader();
+	surfaceHandles = ResolveSurfaceHandles(*currentShader);
+	batchShader = nullptr;
+	if (IsMeshBatchingEnabled())
+	{
+		batchShader = new Shader("batch.vshader", "teapot.fshader");
+		batchShader->BuildShader();
+		batchHandles = ResolveSurfaceHandles(*batchShader);
+	}
+	silhouetteShader = nullptr;
+	if (IsSilhouetteExtractionEnabled())
+	{
+		silhouetteShader = new Shader("silhouette.vshader", "silhouette.fshader");
+		silhouetteShader->BuildShader();
+		silhouetteProjectionHandle = silhouetteShader->GetUniformHandle<glm::mat4>("projection");
+		silhouetteViewHandle = silhouetteShader->GetUniformHandle<glm::mat4>("view");
+		silhouetteModelHandle = silhouetteShader->GetUniformHandle<glm::mat4>("model");
+		silhouetteColorHandle = silhouetteShader->GetUniformHandle<glm::vec3>("lineColor");
+	}
+	contourLineShader = nullptr;
+	contourShader = nullptr;
+	if (GetSuggestiveContourMode() != SUGGESTIVE_CONTOURS_OFF)
+	{
+		contourLineShader = new Shader("suggestivecontourlines.vshader", "suggestivecontour.fshader");
+		contourLineShader->BuildShader();
+		contourLineHandles = ResolveContourHandles(*contourLineShader);
+		contourShader = new Shader("suggestivecontour.vshader", "suggestivecontour.fshader", "suggestivecontour.gshader");
+		contourShader->BuildShader();
+		contourHandles = ResolveContourHandles(*contourShader);
+	}
+	ridgeShader = nullptr;
+	if (AreApparentRidgesEnabled())
+	{
+		ridgeShader = new Shader("apparentridge.vshader", "suggestivecontour.fshader", "apparentridge.gshader");
+		ridgeShader->BuildShader();
+		ridgeHandles = ResolveContourHandles(*ridgeShader);
+	}
 	lightDir = glm::vec3(1.0f, glm::sqrt(3.0f), -glm::sqrt(3.0f));
 }
 Renderer::~Renderer()
 {
 	delete currentShader;
+	delete batchShader;
+	delete silhouetteShader;
+	delete contourLineShader;
+	delete contourShader;
+	delete ridgeShader;
 	delete camera;
 	delete object;
 }
 Camera* Renderer::GetCamera() { return camera; }
+Model* Renderer::GetModel() { return object; }
+void Renderer::SetModel(Model* model)
+{
+	delete object;
+	object = model;
+}
+void Renderer::UploadModel()
+{
+	if (object)
+		object->Upload(*GetSurfaceShader());
+}
 void Renderer::Render(float aspect)
 {
+	GetTextureLoader().Update(textureUploadBudgetMilliseconds);
 	SetMatrix(aspect);
-	SetUniformVariables();
-	object->Draw(*currentShader);
+	Shader* surfaceShader = GetSurfaceShader();
+	SetUniformVariables(*surfaceShader, surfaceShader == batchShader ? batchHandles : surfaceHandles);
+	if (object && GetLevelOfDetailOptions().enabled)
+	{
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		object->SelectLevelsOfDetail(projection, view * model, static_cast<float>(viewport[3]));
+	}
+	if (object && (IsFrustumCullingEnabled() || IsMeshletCullingEnabled()))
+		object->Cull(projection * view * model, GetObjectSpaceEye());
+	if (object)
+		object->Draw(*surfaceShader);
+	if (object && silhouetteShader)
+		DrawSilhouettes();
+	if (object && contourShader && GetSuggestiveContourMode() != SUGGESTIVE_CONTOURS_OFF)
+		DrawSuggestiveContours();
+	if (object && ridgeShader)
+		DrawApparentRidges();
+}
+void Renderer::DrawSilhouettes()
+{
+	// The lines lie on the surface just drawn, so they must pass the depth test where they touch it
+	glm::vec3 eye = GetObjectSpaceEye();
+	silhouetteShader->Use();
+	silhouetteShader->Set(silhouetteProjectionHandle, projection);
+	silhouetteShader->Set(silhouetteViewHandle, view);
+	silhouetteShader->Set(silhouetteModelHandle, model);
+	silhouetteShader->Set(silhouetteColorHandle, glm::vec3(0.0f, 0.0f, 0.0f));
+	glDepthFunc(GL_LEQUAL);
+	object->DrawSilhouettes(*silhouetteShader, eye);
+	glDepthFunc(GL_LESS);
+}
+Renderer::ContourShaderHandles Renderer::ResolveContourHandles(const Shader& shader)
+{
+	ContourShaderHandles handles;
+	handles.projection = shader.GetUniformHandle<glm::mat4>("projection");
+	handles.view = shader.GetUniformHandle<glm::mat4>("view");
+	handles.model = shader.GetUniformHandle<glm::mat4>("model");
+	handles.lineColor = shader.GetUniformHandle<glm::vec3>("lineColor");
+	handles.eye = shader.GetUniformHandle<glm::vec3>("eye");
+	handles.threshold = shader.GetUniformHandle<float>("threshold");
+	handles.fade = shader.GetUniformHandle<float>("fade");
+	return handles;
+}
+void Renderer::DrawSuggestiveContours()
+{
+	bool gpu = GetSuggestiveContourMode() == SUGGESTIVE_CONTOURS_GPU;
+	Shader* shader = gpu ? contourShader : contourLineShader;
+	const ContourShaderHandles& handles = gpu ? contourHandles : contourLineHandles;
+	const SuggestiveContourOptions& options = GetSuggestiveContourOptions();
+	glm::vec3 eye = GetObjectSpaceEye();
+
+	shader->Use();
+	shader->Set(handles.projection, projection);
+	shader->Set(handles.view, view);
+	shader->Set(handles.model, model);
+	shader->Set(handles.lineColor, glm::vec3(0.0f, 0.0f, 0.0f));
+	shader->Set(handles.eye, eye);
+	shader->Set(handles.threshold, options.threshold);
+	shader->Set(handles.fade, options.fade);
+
+	// The lines fade in with alpha and lie on the surface just drawn
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthFunc(GL_LEQUAL);
+	if (gpu)
+		object->DrawSuggestiveContoursGpu(*shader);
+	else
+		object->DrawSuggestiveContours(eye, options);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_BLEND);
+}
+void Renderer::DrawApparentRidges()
+{
+	const ApparentRidgeOptions& options = GetApparentRidgeOptions();
+	glm::vec3 eye = GetObjectSpaceEye();
+	object->UpdateApparentRidges(eye, options.viewTolerance);
+
+	ridgeShader->Use();
+	ridgeShader->Set(ridgeHandles.projection, projection);
+	ridgeShader->Set(ridgeHandles.view, view);
+	ridgeShader->Set(ridgeHandles.model, model);
+	ridgeShader->Set(ridgeHandles.lineColor, glm::vec3(0.0f, 0.0f, 0.0f));
+	ridgeShader->Set(ridgeHandles.eye, eye);
+	ridgeShader->Set(ridgeHandles.threshold, options.threshold);
+	ridgeShader->Set(ridgeHandles.fade, options.fade);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthFunc(GL_LEQUAL);
+	object->DrawApparentRidges(*ridgeShader);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_BLEND);
+}
+glm::vec3 Renderer::GetObjectSpaceEye() const
+{
+	return glm::vec3(glm::inverse(model) * glm::vec4(camera->position, 1.0f));
 }
 void Renderer::SetMatrix(float aspect)
 {
@@ -30,16 +185,34 @@ void Renderer::SetMatrix(float aspect)
 	model = glm::mat4(1.0f);
 	model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
 }
-void Renderer::SetUniformVariables()
-{
-	currentShader->Use();
-	currentShader->SetMat4("projection", projection);
-	currentShader->SetMat4("view", view);
-	currentShader->SetMat4("model", model);
-	currentShader->SetVec3("viewPos", camera->position);
-	currentShader->SetVec3("light.direction", lightDir);
-	currentShader->SetVec3("light.ambient", glm::vec3(0.5f, 0.5f, 0.5f));
-	currentShader->SetVec3("light.diffuse", glm::vec3(1.0f, 1.0f, 1.0f));
-	currentShader->SetVec3("light.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-	currentShader->SetFloat("material.shininess", 32.0f);
+void Renderer::SetUniformVariables(Shader& shader, const SurfaceShaderHandles& handles)
+{
+	shader.Use();
+	shader.Set(handles.projection, projection);
+	shader.Set(handles.view, view);
+	shader.Set(handles.model, model);
+	shader.Set(handles.viewPos, camera->position);
+	shader.Set(handles.lightDirection, lightDir);
+	shader.Set(handles.lightAmbient, glm::vec3(0.5f, 0.5f, 0.5f));
+	shader.Set(handles.lightDiffuse, glm::vec3(1.0f, 1.0f, 1.0f));
+	shader.Set(handles.lightSpecular, glm::vec3(1.0f, 1.0f, 1.0f));
+	shader.Set(handles.shininess, 32.0f);
+}
+Renderer::SurfaceShaderHandles Renderer::ResolveSurfaceHandles(const Shader& shader)
+{
+	SurfaceShaderHandles handles;
+	handles.projection = shader.GetUniformHandle<glm::mat4>("projection");
+	handles.view = shader.GetUniformHandle<glm::mat4>("view");
+	handles.model = shader.GetUniformHandle<glm::mat4>("model");
+	handles.viewPos = shader.GetUniformHandle<glm::vec3>("viewPos");
+	handles.lightDirection = shader.GetUniformHandle<glm::vec3>("light.direction");
+	handles.lightAmbient = shader.GetUniformHandle<glm::vec3>("light.ambient");
+	handles.lightDiffuse = shader.GetUniformHandle<glm::vec3>("light.diffuse");
+	handles.lightSpecular = shader.GetUniformHandle<glm::vec3>("light.specular");
+	handles.shininess = shader.GetUniformHandle<float>("material.shininess");
+	return handles;
+}
+Shader* Renderer::GetSurfaceShader()
+{
+	return batchShader && IsMeshBatchingEnabled() ? batchShader : currentShader;
 }
\ No newline at end of file
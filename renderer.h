@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "camera.h"
@@ -8,15 +9,27 @@
 class Renderer
 {
 public:
-	Renderer();
+	// An empty modelPath creates the renderer without a model (see SetModel)
+	Renderer(const std::string& modelPath = "teapot/teapot.obj");
 	Renderer(const Renderer&) = delete;
 	~Renderer();
 
 	Camera* GetCamera();
+	Model* GetModel();
+	// Takes ownership of model and deletes the previous one; the shaders and camera are kept
+	void SetModel(Model* model);
+	// Upload the model's meshes for the current shader, so the first Render does not pay for it
+	void UploadModel();
 	void Render(float aspect);
 private:
 	// Shader 
 	Shader* currentShader;
+	Shader* batchShader; // only if mesh batching is enabled: the same lighting with batch.vshader
+	Shader* silhouetteShader; // only if silhouette extraction is enabled
+	// Only if a SuggestiveContourMode is set: the lines extracted on the CPU, and the geometry shader path
+	Shader* contourLineShader;
+	Shader* contourShader;
+	Shader* ridgeShader; // only if apparent ridges are enabled
 
 	// matrix 
 	glm::mat4 projection;
@@ -33,5 +46,50 @@ private:
 	glm::vec3 lightDir;
 
 	void SetMatrix(float aspect); // Parameter: float aspect => aspect window . => Ϲȭ??
-	void SetUniformVariables();
+
+	// Uniforms of a surface shader, resolved once after it is built
+	struct SurfaceShaderHandles
+	{
+		UniformHandle<glm::mat4> projection;
+		UniformHandle<glm::mat4> view;
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::vec3> viewPos;
+		UniformHandle<glm::vec3> lightDirection;
+		UniformHandle<glm::vec3> lightAmbient;
+		UniformHandle<glm::vec3> lightDiffuse;
+		UniformHandle<glm::vec3> lightSpecular;
+		UniformHandle<float> shininess;
+	};
+	SurfaceShaderHandles surfaceHandles;
+	SurfaceShaderHandles batchHandles;
+
+	static SurfaceShaderHandles ResolveSurfaceHandles(const Shader& shader);
+	Shader* GetSurfaceShader(); // batchShader while batching is enabled, otherwise currentShader
+	void SetUniformVariables(Shader& shader, const SurfaceShaderHandles& handles);
+
+	UniformHandle<glm::mat4> silhouetteProjectionHandle;
+	UniformHandle<glm::mat4> silhouetteViewHandle;
+	UniformHandle<glm::mat4> silhouetteModelHandle;
+	UniformHandle<glm::vec3> silhouetteColorHandle;
+
+	void DrawSilhouettes();
+
+	struct ContourShaderHandles
+	{
+		UniformHandle<glm::mat4> projection;
+		UniformHandle<glm::mat4> view;
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::vec3> lineColor;
+		UniformHandle<glm::vec3> eye; // the geometry shader paths only, like the rest
+		UniformHandle<float> threshold;
+		UniformHandle<float> fade;
+	};
+	ContourShaderHandles contourLineHandles;
+	ContourShaderHandles contourHandles;
+	ContourShaderHandles ridgeHandles;
+
+	static ContourShaderHandles ResolveContourHandles(const Shader& shader);
+	void DrawSuggestiveContours();
+	void DrawApparentRidges();
+	glm::vec3 GetObjectSpaceEye() const; // camera position in the model's space
 };
\ No newline at end of file
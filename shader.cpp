@@ -10,6 +10,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
 	this->vertex = 0;
 	this->fragment = 0;
 	this->geometry = 0;
+
+	activeAttributeMask = 0;
 }
 Shader::~Shader()
 {
@@ -19,16 +21,40 @@ Shader::~Shader()
 }
 void Shader::BuildShader()
 {
-	CompileShader(vertexPath, vertex, GL_VERTEX_SHADER);
-	CompileShader(fragmentPath, fragment, GL_FRAGMENT_SHADER);
-	CompileShader(geometryPath, geometry, GL_GEOMETRY_SHADER);
-	LinkProgram(vertex, fragment, geometry);
+	std::string vertexCode = ReadShaderFile(vertexPath);
+	std::string fragmentCode = ReadShaderFile(fragmentPath);
+	std::string geometryCode = ReadShaderFile(geometryPath);
+
+	// A cached binary skips compiling and linking entirely
+	ProgramBinaryCache* cache = nullptr;
+	std::string cacheKey;
+	if (IsProgramBinaryCacheEnabled() && GetProgramBinaryCache().IsSupported())
+	{
+		cache = &GetProgramBinaryCache();
+		cacheKey = cache->ComputeKey({ vertexCode, fragmentCode, geometryCode });
+
+		programID = glCreateProgram();
+		if (cache->Load(cacheKey, programID))
+		{
+			ReflectAttributes();
+			ReflectUniforms();
+			return;
+		}
+		glDeleteProgram(programID);
+		programID = 0;
+	}
+
+	CompileShader(vertexPath, vertexCode, vertex, GL_VERTEX_SHADER);
+	CompileShader(fragmentPath, fragmentCode, fragment, GL_FRAGMENT_SHADER);
+	CompileShader(geometryPath, geometryCode, geometry, GL_GEOMETRY_SHADER);
+	if (LinkProgram(vertex, fragment, geometry, cache != nullptr) && cache)
+		cache->Store(cacheKey, programID);
 }
-void Shader::CompileShader(const char* shaderPath, GLuint& shader, GLenum shaderType)
+std::string Shader::ReadShaderFile(const char* shaderPath)
 {
 	if (shaderPath == nullptr)
 	{
-		return;
+		return std::string();
 	}
 
 	std::string shaderCodeString;
@@ -49,6 +75,38 @@ void Shader::CompileShader(const char* shaderPath, GLuint& shader, GLenum shader
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
 
+	// GLSL has no #include, so the shared files are pasted in here
+	std::string directory = shaderPath;
+	std::size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+
+	std::string expandedCode;
+	std::istringstream lines(shaderCodeString);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		std::size_t open = line.find('"');
+		std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (line.compare(0, 8, "#include") != 0 || close == std::string::npos)
+		{
+			expandedCode += line + '\n';
+			continue;
+		}
+		std::string includePath = directory + line.substr(open + 1, close - open - 1);
+		expandedCode += ReadShaderFile(includePath.c_str());
+		expandedCode += "#line " + std::to_string(lineNumber + 1) + '\n';
+	}
+	return expandedCode;
+}
+void Shader::CompileShader(const char* shaderPath, const std::string& shaderCodeString, GLuint& shader, GLenum shaderType)
+{
+	if (shaderPath == nullptr)
+	{
+		return;
+	}
+
 	const char* shaderCode = shaderCodeString.c_str();
 
 	int success;
@@ -78,9 +136,11 @@ void Shader::CompileShader(const char* shaderPath, GLuint& shader, GLenum shader
 
 	delete[] infoLog;
 }
-void Shader::LinkProgram(GLuint vertex, GLuint fragment, GLuint geometry)
+bool Shader::LinkProgram(GLuint vertex, GLuint fragment, GLuint geometry, bool retrievableBinary)
 {
 	programID = glCreateProgram();
+	if (retrievableBinary)
+		glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(programID, vertex);
 	glAttachShader(programID, fragment);
 	if (geometry != 0)
@@ -100,53 +160,188 @@ void Shader::LinkProgram(GLuint vertex, GLuint fragment, GLuint geometry)
 	}
 
 	delete[] infoLog;
+
+	ReflectAttributes();
+	ReflectUniforms();
+	return success != 0;
+}
+void Shader::ReflectAttributes()
+{
+	activeAttributeMask = 0;
+
+	GLint attributeCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+	for (GLint i = 0; i < attributeCount; i++)
+	{
+		char name[256];
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveAttrib(programID, i, sizeof(name), &length, &size, &type, name);
+
+		GLint location = glGetAttribLocation(programID, name);
+		if (location >= 0 && location < 32)
+			activeAttributeMask |= 1u << location;
+	}
 }
+void Shader::ReflectUniforms()
+{
+	uniforms.clear();
+	uniformBlocks.clear();
 
-GLuint Shader::GetProgramID() { return programID; }
+	GLint uniformCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		char name[256];
+		GLsizei length;
+		UniformInfo info;
+		glGetActiveUniform(programID, i, sizeof(name), &length, &info.size, &info.type, name);
+
+		// Members of uniform blocks have no location
+		info.location = glGetUniformLocation(programID, name);
+		if (info.location < 0)
+			continue;
+		info.typeMismatchReported = false;
+
+		// Arrays are reported as "name[0]"; accept the bare name as well, as glGetUniformLocation does
+		std::string uniformName(name, length);
+		uniforms[uniformName] = info;
+		if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+			uniforms[uniformName.substr(0, uniformName.size() - 3)] = info;
+	}
+
+	GLint blockCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		char name[256];
+		GLsizei length;
+		glGetActiveUniformBlockName(programID, i, sizeof(name), &length, name);
+		uniformBlocks[std::string(name, length)] = static_cast<GLuint>(i);
+	}
+}
+std::unordered_map<std::string, UniformInfo>::const_iterator Shader::FindUniform(const std::string& name) const
+{
+	return uniforms.find(name);
+}
+void Shader::CheckUniformType(const std::string& name, const UniformInfo& info, GLenum expectedType) const
+{
+#ifndef NDEBUG
+	bool matches = info.type == expectedType;
+	// glUniform1i is also how samplers and bools are set
+	if (expectedType == GL_INT)
+	{
+		matches = matches || info.type == GL_BOOL || info.type == GL_SAMPLER_2D || info.type == GL_SAMPLER_3D ||
+			info.type == GL_SAMPLER_CUBE || info.type == GL_SAMPLER_BUFFER || info.type == GL_UNSIGNED_INT_SAMPLER_BUFFER ||
+			info.type == GL_INT_SAMPLER_BUFFER || info.type == GL_SAMPLER_2D_SHADOW;
+	}
+	if (expectedType == GL_BOOL)
+		matches = matches || info.type == GL_INT;
+
+	if (!matches && !info.typeMismatchReported)
+	{
+		std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << " is declared as 0x" << std::hex << info.type
+			<< " but set as 0x" << expectedType << std::dec << std::endl;
+		info.typeMismatchReported = true;
+	}
+#endif
+}
+
+GLuint Shader::GetProgramID() const { return programID; }
+unsigned int Shader::GetActiveAttributeMask() const { return activeAttributeMask; }
+GLint Shader::GetTypedUniformLocation(const std::string& name, GLenum expectedType) const
+{
+	auto it = FindUniform(name);
+	if (it == uniforms.end())
+		return GetUniformLocation(name);
+	CheckUniformType(name, it->second, expectedType);
+	return it->second.location;
+}
+GLint Shader::GetUniformLocation(const std::string& name) const
+{
+	auto it = FindUniform(name);
+	if (it != uniforms.end())
+		return it->second.location;
+	// Only "name[0]" of an array is reflected; other elements still need the driver
+	if (name.find('[') != std::string::npos)
+		return glGetUniformLocation(programID, name.c_str());
+	return -1;
+}
 
 void Shader::Use() { glUseProgram(programID); }
 
 void Shader::SetBool(const std::string& name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(programID, name.c_str()), (int)value);
+	glUniform1i(GetTypedUniformLocation(name, GL_BOOL), (int)value);
 }
 void Shader::SetInt(const std::string& name, int value) const
 {
-	glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+	glUniform1i(GetTypedUniformLocation(name, GL_INT), value);
 }
 void Shader::SetFloat(const std::string& name, float value) const
 {
-	glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+	glUniform1f(GetTypedUniformLocation(name, GL_FLOAT), value);
 }
 void Shader::SetVec2(const std::string& name, const glm::vec2& value) const
 {
-	glUniform2fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+	glUniform2fv(GetTypedUniformLocation(name, GL_FLOAT_VEC2), 1, glm::value_ptr(value));
 }
 void Shader::SetVec2(const std::string& name, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(programID, name.c_str()), x, y);
+	glUniform2f(GetTypedUniformLocation(name, GL_FLOAT_VEC2), x, y);
 }
 void Shader::SetVec3(const std::string& name, const glm::vec3& value) const
 {
-	glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+	glUniform3fv(GetTypedUniformLocation(name, GL_FLOAT_VEC3), 1, glm::value_ptr(value));
 }
 void Shader::SetVec3(const std::string& name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(programID, name.c_str()), x, y, z);
+	glUniform3f(GetTypedUniformLocation(name, GL_FLOAT_VEC3), x, y, z);
 }
 void Shader::SetVec4(const std::string& name, const glm::vec4& value) const
 {
-	glUniform4fv(glGetUniformLocation(programID, name.c_str()), 1, glm::value_ptr(value));
+	glUniform4fv(GetTypedUniformLocation(name, GL_FLOAT_VEC4), 1, glm::value_ptr(value));
 }
 void Shader::SetVec4(const std::string& name, float x, float y, float z, float w) const
 {
-	glUniform4f(glGetUniformLocation(programID, name.c_str()), x, y, z, w);
+	glUniform4f(GetTypedUniformLocation(name, GL_FLOAT_VEC4), x, y, z, w);
 }
 void Shader::SetMat4(const std::string& name, const glm::mat4& value) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(GetTypedUniformLocation(name, GL_FLOAT_MAT4), 1, GL_FALSE, glm::value_ptr(value));
+}
+void Shader::Set(UniformHandle<bool> handle, bool value) const
+{
+	glUniform1i(handle.GetLocation(), (int)value);
+}
+void Shader::Set(UniformHandle<int> handle, int value) const
+{
+	glUniform1i(handle.GetLocation(), value);
+}
+void Shader::Set(UniformHandle<float> handle, float value) const
+{
+	glUniform1f(handle.GetLocation(), value);
+}
+void Shader::Set(UniformHandle<glm::vec2> handle, const glm::vec2& value) const
+{
+	glUniform2fv(handle.GetLocation(), 1, glm::value_ptr(value));
+}
+void Shader::Set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const
+{
+	glUniform3fv(handle.GetLocation(), 1, glm::value_ptr(value));
+}
+void Shader::Set(UniformHandle<glm::vec4> handle, const glm::vec4& value) const
+{
+	glUniform4fv(handle.GetLocation(), 1, glm::value_ptr(value));
+}
+void Shader::Set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const
+{
+	glUniformMatrix4fv(handle.GetLocation(), 1, GL_FALSE, glm::value_ptr(value));
 }
 void Shader::SetUniformBlockBinding(const std::string& name, GLuint uniformBlockBinding) const
 {
-	glUniformBlockBinding(programID, glGetUniformBlockIndex(programID, name.c_str()), uniformBlockBinding);
+	auto it = uniformBlocks.find(name);
+	if (it != uniformBlocks.end())
+		glUniformBlockBinding(programID, it->second, uniformBlockBinding);
 }
\ No newline at end of file
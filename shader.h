@@ -3,10 +3,46 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "programbinarycache.h"
+
+// GL type that a uniform set through a UniformHandle<T> must be declared with
+template <class T> struct UniformGLType;
+template <> struct UniformGLType<bool> { static const GLenum value = GL_BOOL; };
+template <> struct UniformGLType<int> { static const GLenum value = GL_INT; }; // also samplers
+template <> struct UniformGLType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct UniformGLType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template <> struct UniformGLType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformGLType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct UniformGLType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+// Active uniform of a linked program
+struct UniformInfo
+{
+	GLint location;
+	GLenum type;
+	GLint size; // array length, 1 for non-arrays
+	mutable bool typeMismatchReported;
+};
+
+// Uniform location resolved once, so setting it per frame needs neither a string nor a driver query.
+// An invalid handle (uniform not active) is ignored by Shader::Set, like location -1 in GL.
+template <class T>
+class UniformHandle
+{
+public:
+	UniformHandle() : location(-1) {}
+	explicit UniformHandle(GLint location) : location(location) {}
+
+	bool IsValid() const { return location >= 0; }
+	GLint GetLocation() const { return location; }
+private:
+	GLint location;
+};
 
 class Shader
 {
@@ -15,7 +51,29 @@ public:
 	~Shader();
 
 	void BuildShader();
-	GLuint GetProgramID();
+	GLuint GetProgramID() const;
+	unsigned int GetActiveAttributeMask() const; // bit i is set if attribute location i is read by the program
+
+	// Location of an active uniform from the table reflected after link, -1 if it is not active
+	GLint GetUniformLocation(const std::string& name) const;
+	// Debug builds report a handle whose T does not match the declared type of the uniform
+	template <class T>
+	UniformHandle<T> GetUniformHandle(const std::string& name) const
+	{
+		auto it = FindUniform(name);
+		if (it == uniforms.end())
+			return UniformHandle<T>(GetUniformLocation(name));
+		CheckUniformType(name, it->second, UniformGLType<T>::value);
+		return UniformHandle<T>(it->second.location);
+	}
+	// The program must be in use
+	void Set(UniformHandle<bool> handle, bool value) const;
+	void Set(UniformHandle<int> handle, int value) const;
+	void Set(UniformHandle<float> handle, float value) const;
+	void Set(UniformHandle<glm::vec2> handle, const glm::vec2& value) const;
+	void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const;
+	void Set(UniformHandle<glm::vec4> handle, const glm::vec4& value) const;
+	void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const;
 
 	void Use();
 	void SetBool(const std::string& name, bool value) const;
@@ -40,6 +98,18 @@ private:
 	GLuint fragment;
 	GLuint geometry;
 
-	void CompileShader(const char* shaderPath, GLuint& shader, GLenum shaderType);
-	void LinkProgram(GLuint vertex, GLuint fragment, GLuint geometry);
+	unsigned int activeAttributeMask;
+	std::unordered_map<std::string, UniformInfo> uniforms; // active uniforms outside of blocks
+	std::unordered_map<std::string, GLuint> uniformBlocks; // block name -> block index
+
+	// Empty if shaderPath is nullptr. A line #include "file" is replaced by that file (relative to the shader, and
+	// expanded the same way), followed by a #line directive so the compile errors keep the shader's line numbers.
+	std::string ReadShaderFile(const char* shaderPath);
+	void CompileShader(const char* shaderPath, const std::string& shaderCodeString, GLuint& shader, GLenum shaderType);
+	bool LinkProgram(GLuint vertex, GLuint fragment, GLuint geometry, bool retrievableBinary);
+	void ReflectAttributes();
+	void ReflectUniforms();
+	std::unordered_map<std::string, UniformInfo>::const_iterator FindUniform(const std::string& name) const;
+	GLint GetTypedUniformLocation(const std::string& name, GLenum expectedType) const; // used by the Set* by name
+	void CheckUniformType(const std::string& name, const UniformInfo& info, GLenum expectedType) const;
 };
\ No newline at end of file
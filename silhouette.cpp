@@ -0,0 +1,287 @@
+#include "silhouette.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "normalcone.h"
+#include "parallel.h"
+
+static const unsigned int clusterSize = 64; // edges per leaf
+static const float pi = 3.14159265f;
+
+static bool silhouetteExtractionEnabled = false;
+
+void SetSilhouetteExtractionEnabled(bool enabled)
+{
+	silhouetteExtractionEnabled = enabled;
+}
+bool IsSilhouetteExtractionEnabled()
+{
+	return silhouetteExtractionEnabled;
+}
+
+void SilhouetteExtractor::Build(const AlignedVector<glm::vec3>& positions,
+	const std::vector<std::array<unsigned int, 3>>& faces, const EdgeTopology& topology)
+{
+	edges.clear();
+	nodes.clear();
+	boundaryIndices.clear();
+
+	int nf = static_cast<int>(faces.size());
+	std::vector<glm::vec3> faceNormals(faces.size());
+	ParallelFor(nf, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			glm::vec3 n = glm::cross(positions[faces[i][1]] - positions[faces[i][0]],
+				positions[faces[i][2]] - positions[faces[i][0]]);
+			float length = glm::length(n);
+			faceNormals[i] = length > 0.0f ? n / length : glm::vec3(0.0f);
+		}
+	});
+
+	// Boundary edges are always drawn; the rest go into the hierarchy in Morton order
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	std::vector<unsigned int> interior;
+	const std::vector<MeshEdge>& meshEdges = topology.GetEdges();
+	for (unsigned int e = 0; e < meshEdges.size(); e++)
+	{
+		const MeshEdge& edge = meshEdges[e];
+		if (edge.IsBoundary())
+		{
+			boundaryIndices.push_back(edge.vertices[0]);
+			boundaryIndices.push_back(edge.vertices[1]);
+			continue;
+		}
+		interior.push_back(e);
+		boundsMin = glm::min(boundsMin, positions[edge.vertices[0]]);
+		boundsMax = glm::max(boundsMax, positions[edge.vertices[0]]);
+	}
+	if (interior.empty())
+		return;
+
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+	std::vector<std::pair<std::uint32_t, unsigned int>> order(interior.size());
+	ParallelFor(static_cast<int>(interior.size()), [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			glm::vec3 q = (positions[meshEdges[interior[i]].vertices[0]] - boundsMin) / extent * 1023.0f;
+			order[i] = std::make_pair(GetMortonCode(static_cast<std::uint32_t>(q.x), static_cast<std::uint32_t>(q.y),
+				static_cast<std::uint32_t>(q.z)), interior[i]);
+		}
+	});
+	std::sort(order.begin(), order.end());
+
+	edges.resize(order.size());
+	ParallelFor(static_cast<int>(order.size()), [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const MeshEdge& edge = meshEdges[order[i].second];
+			Edge& output = edges[i];
+			output.point = positions[edge.vertices[0]];
+			output.normals[0] = faceNormals[edge.faces[0]];
+			output.normals[1] = faceNormals[edge.faces[1]];
+			output.vertices[0] = edge.vertices[0];
+			output.vertices[1] = edge.vertices[1];
+		}
+	});
+
+	// Leaf bounds
+	unsigned int clusterCount = static_cast<unsigned int>((edges.size() + clusterSize - 1) / clusterSize);
+	std::vector<Bounds> leaves(clusterCount);
+	ParallelFor(static_cast<int>(clusterCount), [&](int begin, int end)
+	{
+		for (int c = begin; c < end; c++)
+		{
+			std::size_t first = static_cast<std::size_t>(c) * clusterSize;
+			std::size_t last = std::min(edges.size(), first + clusterSize);
+
+			glm::vec3 lo(FLT_MAX), hi(-FLT_MAX), normalSum(0.0f);
+			for (std::size_t e = first; e < last; e++)
+			{
+				lo = glm::min(lo, edges[e].point);
+				hi = glm::max(hi, edges[e].point);
+				normalSum += edges[e].normals[0] + edges[e].normals[1];
+			}
+			Bounds& bounds = leaves[c];
+			bounds.center = 0.5f * (lo + hi);
+			bounds.radius = 0.0f;
+			for (std::size_t e = first; e < last; e++)
+				bounds.radius = std::max(bounds.radius, glm::length(edges[e].point - bounds.center));
+
+			float sumLength = glm::length(normalSum);
+			bounds.coneAxis = sumLength > 1e-6f ? normalSum / sumLength : glm::vec3(0.0f, 0.0f, 1.0f);
+			bounds.coneAngle = sumLength > 1e-6f ? 0.0f : pi;
+			for (std::size_t e = first; e < last && bounds.coneAngle < pi; e++)
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					// A degenerate face has no normal, so nothing can be proven about it
+					if (edges[e].normals[k] == glm::vec3(0.0f))
+						bounds.coneAngle = pi;
+					else
+						bounds.coneAngle = std::max(bounds.coneAngle, AngleBetween(bounds.coneAxis, edges[e].normals[k]));
+				}
+			}
+		}
+	});
+
+	nodes.reserve(2 * clusterCount);
+	BuildNode(leaves, 0, clusterCount);
+}
+unsigned int SilhouetteExtractor::BuildNode(const std::vector<Bounds>& leaves, unsigned int first, unsigned int last)
+{
+	unsigned int index = static_cast<unsigned int>(nodes.size());
+	nodes.emplace_back();
+	if (last - first == 1)
+	{
+		nodes[index].bounds = leaves[first];
+		nodes[index].children[0] = first;
+		nodes[index].children[1] = leafNode;
+		return index;
+	}
+
+	unsigned int middle = first + (last - first) / 2;
+	unsigned int left = BuildNode(leaves, first, middle);
+	unsigned int right = BuildNode(leaves, middle, last);
+	const Bounds& a = nodes[left].bounds;
+	const Bounds& b = nodes[right].bounds;
+
+	Bounds bounds;
+	// Smallest sphere around both spheres
+	glm::vec3 offset = b.center - a.center;
+	float distance = glm::length(offset);
+	if (distance + b.radius <= a.radius)
+		bounds.center = a.center, bounds.radius = a.radius;
+	else if (distance + a.radius <= b.radius)
+		bounds.center = b.center, bounds.radius = b.radius;
+	else
+	{
+		bounds.radius = 0.5f * (distance + a.radius + b.radius);
+		bounds.center = a.center + offset * ((bounds.radius - a.radius) / distance);
+	}
+
+	// Smallest cone around both cones
+	float axisAngle = AngleBetween(a.coneAxis, b.coneAxis);
+	if (a.coneAngle >= pi || b.coneAngle >= pi)
+		bounds.coneAxis = a.coneAxis, bounds.coneAngle = pi;
+	else if (axisAngle + b.coneAngle <= a.coneAngle)
+		bounds.coneAxis = a.coneAxis, bounds.coneAngle = a.coneAngle;
+	else if (axisAngle + a.coneAngle <= b.coneAngle)
+		bounds.coneAxis = b.coneAxis, bounds.coneAngle = b.coneAngle;
+	else
+	{
+		bounds.coneAngle = 0.5f * (a.coneAngle + axisAngle + b.coneAngle);
+		if (bounds.coneAngle >= pi || axisAngle >= pi - 1e-4f)
+		{
+			bounds.coneAxis = a.coneAxis;
+			bounds.coneAngle = pi;
+		}
+		else
+		{
+			// Rotate a's axis towards b's by the growth of the angle
+			float t = (bounds.coneAngle - a.coneAngle) / axisAngle;
+			float sinAngle = std::sin(axisAngle);
+			bounds.coneAxis = glm::normalize((std::sin((1.0f - t) * axisAngle) * a.coneAxis +
+				std::sin(t * axisAngle) * b.coneAxis) / sinAngle);
+			// Absorb the rounding of the rotation
+			bounds.coneAngle = std::min(pi, bounds.coneAngle + 1e-4f);
+		}
+	}
+
+	nodes[index].bounds = bounds;
+	nodes[index].children[0] = left;
+	nodes[index].children[1] = right;
+	return index;
+}
+bool SilhouetteExtractor::IsCulled(const Bounds& bounds, const glm::vec3& eye)
+{
+	// All front facing or all back facing: no edge between a front and a back face
+	return GetConeFacing(bounds.center, bounds.radius, bounds.coneAxis, bounds.coneAngle, eye) != CONE_MIXED;
+}
+void SilhouetteExtractor::Extract(const glm::vec3& eye, std::vector<unsigned int>& lineIndices,
+	SilhouetteStatistics* statistics)
+{
+	lineIndices.assign(boundaryIndices.begin(), boundaryIndices.end());
+
+	candidates.clear();
+	if (!nodes.empty())
+	{
+		unsigned int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			if (IsCulled(node.bounds, eye))
+				continue;
+			if (node.children[1] == leafNode)
+				candidates.push_back(node.children[0]);
+			else
+			{
+				// Right first, so leaves come out in order
+				stack[stackSize++] = node.children[1];
+				stack[stackSize++] = node.children[0];
+			}
+		}
+	}
+
+	int candidateCount = static_cast<int>(candidates.size());
+	clusterOutput.resize(static_cast<std::size_t>(candidateCount) * 2 * clusterSize);
+	clusterOutputCounts.resize(candidateCount);
+	ParallelFor(candidateCount, [&](int begin, int end)
+	{
+		for (int c = begin; c < end; c++)
+		{
+			std::size_t first = static_cast<std::size_t>(candidates[c]) * clusterSize;
+			std::size_t last = std::min(edges.size(), first + clusterSize);
+			unsigned int* output = &clusterOutput[static_cast<std::size_t>(c) * 2 * clusterSize];
+			unsigned int count = 0;
+			for (std::size_t e = first; e < last; e++)
+			{
+				const Edge& edge = edges[e];
+				glm::vec3 toEye = eye - edge.point;
+				if ((glm::dot(edge.normals[0], toEye) > 0.0f) != (glm::dot(edge.normals[1], toEye) > 0.0f))
+				{
+					output[count++] = edge.vertices[0];
+					output[count++] = edge.vertices[1];
+				}
+			}
+			clusterOutputCounts[c] = count;
+		}
+	}, 64);
+
+	std::size_t silhouetteBegin = lineIndices.size();
+	std::size_t total = silhouetteBegin;
+	for (auto count : clusterOutputCounts)
+		total += count;
+	lineIndices.resize(total);
+	std::size_t cursor = silhouetteBegin;
+	for (int c = 0; c < candidateCount; c++)
+	{
+		if (clusterOutputCounts[c] == 0)
+			continue;
+		std::memcpy(&lineIndices[cursor], &clusterOutput[static_cast<std::size_t>(c) * 2 * clusterSize],
+			clusterOutputCounts[c] * sizeof(unsigned int));
+		cursor += clusterOutputCounts[c];
+	}
+
+	if (statistics)
+	{
+		statistics->clusterCount = nodes.empty() ? 0 : (nodes.size() + 1) / 2;
+		statistics->clustersTested = candidates.size();
+		statistics->edgesTested = 0;
+		for (auto cluster : candidates)
+			statistics->edgesTested += std::min<std::size_t>(clusterSize, edges.size() - cluster * clusterSize);
+		statistics->silhouetteEdges = (total - silhouetteBegin) / 2;
+	}
+}
+std::size_t SilhouetteExtractor::GetMemoryUsage() const
+{
+	return edges.capacity() * sizeof(Edge) + nodes.capacity() * sizeof(Node) +
+		(boundaryIndices.capacity() + candidates.capacity() + clusterOutput.capacity() +
+		clusterOutputCounts.capacity()) * sizeof(unsigned int);
+}
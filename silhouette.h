@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "edgetopology.h"
+#include "meshgeometry.h"
+
+// Silhouette edges are drawn as lines when enabled (before the meshes are loaded)
+void SetSilhouetteExtractionEnabled(bool enabled);
+bool IsSilhouetteExtractionEnabled();
+
+struct SilhouetteStatistics
+{
+	std::size_t clusterCount; // leaves of the hierarchy
+	std::size_t clustersTested; // leaves the hierarchy could not cull
+	std::size_t edgesTested;
+	std::size_t silhouetteEdges;
+};
+
+// Finds the silhouette (and boundary) edges of a mesh for an eye position in object space.
+// Interior edges are sorted along a Morton curve and grouped into clusters; each cluster gets a bounding
+// sphere of its edges and a normal cone of its faces, and a binary hierarchy merges them. A node is skipped
+// when the cone and sphere prove that all its faces are front facing, or all back facing, from the eye,
+// so on coherent meshes only a small part of the edges is ever looked at.
+class SilhouetteExtractor
+{
+public:
+	SilhouetteExtractor() = default;
+
+	void Build(const AlignedVector<glm::vec3>& positions, const std::vector<std::array<unsigned int, 3>>& faces,
+		const EdgeTopology& topology);
+	bool IsBuilt() const { return !nodes.empty() || !boundaryIndices.empty(); }
+
+	// Replace lineIndices with GL_LINES vertex pairs: every boundary edge, and every interior edge whose two
+	// faces point to different sides of the eye. The leaves are tested on the ParallelFor workers.
+	void Extract(const glm::vec3& eye, std::vector<unsigned int>& lineIndices, SilhouetteStatistics* statistics = nullptr);
+
+	std::size_t GetMemoryUsage() const;
+private:
+	// Interior edge in cluster order; point lies on both face planes
+	struct Edge
+	{
+		glm::vec3 point;
+		glm::vec3 normals[2];
+		unsigned int vertices[2];
+	};
+	struct Bounds
+	{
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneAxis;
+		float coneAngle; // half angle in radians; pi when the normals point everywhere
+	};
+	struct Node
+	{
+		Bounds bounds;
+		unsigned int children[2]; // leaf: children[0] is the cluster, children[1] == leafNode
+	};
+	static const unsigned int leafNode = 0xFFFFFFFFu;
+
+	std::vector<Edge> edges;
+	std::vector<Node> nodes; // nodes[0] is the root
+	std::vector<unsigned int> boundaryIndices; // view independent line pairs
+	std::vector<unsigned int> candidates; // per Extract: leaves that were not culled
+	std::vector<unsigned int> clusterOutput; // per Extract: 2 * clusterSize indices per candidate
+	std::vector<unsigned int> clusterOutputCounts;
+
+	unsigned int BuildNode(const std::vector<Bounds>& leaves, unsigned int first, unsigned int last);
+	static bool IsCulled(const Bounds& bounds, const glm::vec3& eye);
+};
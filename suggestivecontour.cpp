@@ -0,0 +1,187 @@
+#include "suggestivecontour.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "parallel.h"
+#include "timer.h"
+
+static const int faceChunkSize = 4096; // faces per output chunk; fixed, so the output order is too
+
+static SuggestiveContourMode suggestiveContourMode = SUGGESTIVE_CONTOURS_OFF;
+static SuggestiveContourOptions suggestiveContourOptions;
+
+void SetSuggestiveContourMode(SuggestiveContourMode mode)
+{
+	suggestiveContourMode = mode;
+}
+SuggestiveContourMode GetSuggestiveContourMode()
+{
+	return suggestiveContourMode;
+}
+const char* GetSuggestiveContourModeName(SuggestiveContourMode mode)
+{
+	switch (mode)
+	{
+	case SUGGESTIVE_CONTOURS_CPU:
+		return "CPU";
+	case SUGGESTIVE_CONTOURS_GPU:
+		return "GPU";
+	default:
+		return "off";
+	}
+}
+void SetSuggestiveContourOptions(const SuggestiveContourOptions& options)
+{
+	suggestiveContourOptions = options;
+}
+const SuggestiveContourOptions& GetSuggestiveContourOptions()
+{
+	return suggestiveContourOptions;
+}
+
+void SuggestiveContourExtractor::Build(const MeshGeometry& geometry)
+{
+	featureSize = ComputeFeatureSize(geometry);
+}
+void SuggestiveContourExtractor::Extract(const MeshGeometry& geometry,
+	const std::vector<std::array<unsigned int, 3>>& faces, const glm::vec3& eye,
+	const SuggestiveContourOptions& options, std::vector<SuggestiveContourVertex>& segments,
+	SuggestiveContourStatistics* statistics, const std::vector<unsigned int>* candidateFaces)
+{
+	Timer extractTimer;
+	segments.clear();
+	int nv = static_cast<int>(geometry.GetVertexCount());
+	int nf = static_cast<int>(candidateFaces ? candidateFaces->size() : faces.size());
+	if (!IsBuilt() || geometry.dcurv.size() != static_cast<std::size_t>(nv))
+	{
+		if (statistics)
+			*statistics = SuggestiveContourStatistics();
+		return;
+	}
+
+	float scale = featureSize * featureSize;
+	terms.resize(nv);
+	ParallelFor(nv, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			glm::vec3 viewDir = eye - geometry.positions[i];
+			float distance = glm::length(viewDir);
+			if (distance == 0.0f)
+			{
+				terms[i] = { 0.0f, 0.0f, 0.0f };
+				continue;
+			}
+			viewDir /= distance;
+			float ndotv = glm::dot(viewDir, geometry.normals[i]);
+			float u = glm::dot(viewDir, geometry.pdir1[i]), u2 = u * u;
+			float v = glm::dot(viewDir, geometry.pdir2[i]), v2 = v * v;
+			float kr = geometry.curv1[i] * u2 + geometry.curv2[i] * v2;
+
+			// Dw kr * sin(theta) (rtsc): the cubic dcurv term along the projected view direction carries sin^3(theta),
+			// so it is divided by sin^2(theta) before the torsion term is subtracted
+			float dwkr = 0.0f;
+			float sin2Theta = u2 + v2;
+			if (sin2Theta > 1e-12f)
+			{
+				const glm::vec4& dcurv = geometry.dcurv[i];
+				dwkr = u2 * (u * dcurv[0] + 3.0f * v * dcurv[1]) + v2 * (3.0f * u * dcurv[2] + v * dcurv[3]);
+				dwkr /= sin2Theta;
+				float tr = (geometry.curv2[i] - geometry.curv1[i]) * u * v / sin2Theta;
+				dwkr -= 2.0f * ndotv * tr * tr;
+			}
+			terms[i] = { kr, dwkr * scale - options.threshold * ndotv, ndotv };
+		}
+	}, 4096);
+
+	int chunkCount = (nf + faceChunkSize - 1) / faceChunkSize;
+	chunks.resize(chunkCount);
+	ParallelFor(chunkCount, [&](int begin, int end)
+	{
+		for (int c = begin; c < end; c++)
+		{
+			ChunkOutput& chunk = chunks[c];
+			chunk.segments.clear();
+			chunk.facesTested = 0;
+			chunk.zeroCrossings = 0;
+
+			int last = std::min(nf, (c + 1) * faceChunkSize);
+			for (int f = c * faceChunkSize; f < last; f++)
+			{
+				const auto& face = faces[candidateFaces ? (*candidateFaces)[f] : f];
+				const VertexTerms* t[3] = { &terms[face[0]], &terms[face[1]], &terms[face[2]] };
+				if (t[0]->ndotv <= 0.0f && t[1]->ndotv <= 0.0f && t[2]->ndotv <= 0.0f)
+					continue;
+				chunk.facesTested++;
+
+				bool negative[3] = { t[0]->kr < 0.0f, t[1]->kr < 0.0f, t[2]->kr < 0.0f };
+				if (negative[0] == negative[1] && negative[1] == negative[2])
+					continue;
+				chunk.zeroCrossings++;
+
+				// a is the vertex on its own side of the zero; the crossings lie on its two edges
+				int a = negative[0] == negative[1] ? 2 : (negative[0] == negative[2] ? 1 : 0);
+				glm::vec3 points[2];
+				float test[2], ndotv[2];
+				for (int k = 0; k < 2; k++)
+				{
+					int b = (a + 1 + k) % 3;
+					float w = t[a]->kr / (t[a]->kr - t[b]->kr);
+					points[k] = (1.0f - w) * geometry.positions[face[a]] + w * geometry.positions[face[b]];
+					test[k] = (1.0f - w) * t[a]->test + w * t[b]->test;
+					ndotv[k] = (1.0f - w) * t[a]->ndotv + w * t[b]->ndotv;
+				}
+				if ((test[0] <= 0.0f && test[1] <= 0.0f) || ndotv[0] <= 0.0f || ndotv[1] <= 0.0f)
+					continue;
+
+				// Clip the end that fails the test to where the test changes sign
+				for (int k = 0; k < 2; k++)
+				{
+					if (test[k] > 0.0f)
+						continue;
+					float s = test[k] / (test[k] - test[1 - k]);
+					points[k] += s * (points[1 - k] - points[k]);
+					ndotv[k] += s * (ndotv[1 - k] - ndotv[k]);
+					test[k] = 0.0f;
+				}
+				for (int k = 0; k < 2; k++)
+				{
+					float alpha = options.fade > 0.0f ? std::min(1.0f, test[k] / (ndotv[k] * options.fade)) : 1.0f;
+					chunk.segments.push_back({ points[k], alpha });
+				}
+			}
+		}
+	}, 1);
+
+	std::size_t total = 0;
+	for (const auto& chunk : chunks)
+		total += chunk.segments.size();
+	segments.resize(total);
+	std::size_t cursor = 0;
+	for (const auto& chunk : chunks)
+	{
+		if (chunk.segments.empty())
+			continue;
+		std::memcpy(&segments[cursor], chunk.segments.data(), chunk.segments.size() * sizeof(SuggestiveContourVertex));
+		cursor += chunk.segments.size();
+	}
+
+	if (statistics)
+	{
+		*statistics = SuggestiveContourStatistics();
+		for (const auto& chunk : chunks)
+		{
+			statistics->facesTested += chunk.facesTested;
+			statistics->zeroCrossings += chunk.zeroCrossings;
+		}
+		statistics->segments = total / 2;
+		statistics->milliseconds = extractTimer.ElapsedMilliseconds();
+	}
+}
+std::size_t SuggestiveContourExtractor::GetMemoryUsage() const
+{
+	std::size_t bytes = terms.capacity() * sizeof(VertexTerms) + chunks.capacity() * sizeof(ChunkOutput);
+	for (const auto& chunk : chunks)
+		bytes += chunk.segments.capacity() * sizeof(SuggestiveContourVertex);
+	return bytes;
+}
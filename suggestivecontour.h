@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "meshgeometry.h"
+
+// Where suggestive contours are extracted; set before the meshes are loaded
+enum SuggestiveContourMode
+{
+	SUGGESTIVE_CONTOURS_OFF,
+	SUGGESTIVE_CONTOURS_CPU, // SuggestiveContourExtractor, drawn as GL_LINES
+	SUGGESTIVE_CONTOURS_GPU // suggestivecontour.gshader on the mesh's own triangles
+};
+void SetSuggestiveContourMode(SuggestiveContourMode mode);
+SuggestiveContourMode GetSuggestiveContourMode();
+const char* GetSuggestiveContourModeName(SuggestiveContourMode mode);
+
+// Both thresholds are in units of 1 / featureSize^2 (see SuggestiveContourExtractor::GetFeatureSize),
+// so the same values work at any model scale
+struct SuggestiveContourOptions
+{
+	float threshold = 0.05f; // minimum derivative of radial curvature (over n.v) for a contour to be drawn
+	float fade = 0.2f; // the lines fade in over this much above the threshold; 0 draws them opaque
+};
+void SetSuggestiveContourOptions(const SuggestiveContourOptions& options);
+const SuggestiveContourOptions& GetSuggestiveContourOptions();
+
+// Line vertex of an extracted contour; consecutive pairs are segments
+struct SuggestiveContourVertex
+{
+	glm::vec3 position;
+	float alpha;
+};
+
+struct SuggestiveContourStatistics
+{
+	std::size_t facesTested; // front facing faces
+	std::size_t zeroCrossings; // faces the radial curvature changes sign in
+	std::size_t segments; // crossings that passed the derivative test
+	double milliseconds;
+};
+
+// Finds suggestive contours (DeCarlo et al. 2003): the zero crossings of the radial curvature kr on front
+// facing faces where its directional derivative along the projected view direction, Dw kr, is positive.
+// kr comes from curv1, curv2 and the principal directions, and Dw kr from dcurv, per vertex; each face then
+// interpolates both linearly. Segments whose derivative test fails at one end are clipped where it changes sign.
+class SuggestiveContourExtractor
+{
+public:
+	SuggestiveContourExtractor() = default;
+
+	// Measure the feature size (ComputeFeatureSize); needs the curvature to be computed
+	void Build(const MeshGeometry& geometry);
+	bool IsBuilt() const { return featureSize > 0.0f; }
+	float GetFeatureSize() const { return featureSize; }
+
+	// Replace segments with the contours seen from eye (object space). Vertices and faces are evaluated on
+	// the ParallelFor workers; the segments come out in face order for any thread count. With candidateFaces
+	// only those faces are looked at (e.g. the meshlets that are not back facing), in that order.
+	void Extract(const MeshGeometry& geometry, const std::vector<std::array<unsigned int, 3>>& faces,
+		const glm::vec3& eye, const SuggestiveContourOptions& options, std::vector<SuggestiveContourVertex>& segments,
+		SuggestiveContourStatistics* statistics = nullptr, const std::vector<unsigned int>* candidateFaces = nullptr);
+
+	std::size_t GetMemoryUsage() const;
+private:
+	// Per vertex and view: kr * sin^2(theta), the derivative test (Dw kr * sin(theta) scaled, minus threshold * n.v)
+	// and n.v
+	struct VertexTerms
+	{
+		float kr;
+		float test;
+		float ndotv;
+	};
+	struct ChunkOutput
+	{
+		std::vector<SuggestiveContourVertex> segments;
+		std::size_t facesTested;
+		std::size_t zeroCrossings;
+	};
+
+	float featureSize = 0.0f;
+	std::vector<VertexTerms> terms;
+	std::vector<ChunkOutput> chunks;
+};
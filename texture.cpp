@@ -3,6 +3,7 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 // #include <stb_image_write.h>
 #include "texture.h"
+#include <algorithm>
 
 Texture::Texture()
 {
@@ -15,8 +16,8 @@ Texture::~Texture()
 
 }
 GLuint Texture::GetTextureID() { return textureID; }
-const std::string& Texture::GetPath() { return path; }
-const std::string& Texture::GetType() { return type; }
+const std::string& Texture::GetPath() const { return path; }
+const std::string& Texture::GetType() const { return type; }
 void Texture::LoadTexture(const std::string& path, const std::string& typeName, bool gammaCorrection)
 {
 	glGenTextures(1, &textureID);
@@ -73,22 +74,7 @@ void Texture::LoadTextureUsingDirectory(const std::string& path, const std::stri
 	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
 	if (data)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		UploadImage(data, width, height, nrComponents);
 
 		type = typeName;
 		this->path = path;
@@ -101,6 +87,44 @@ void Texture::LoadTextureUsingDirectory(const std::string& path, const std::stri
 	stbi_image_free(data);
 }
 
+void Texture::CreatePlaceholder(const std::string& path, const std::string& typeName)
+{
+	glGenTextures(1, &textureID);
+
+	// Mid grey, so untextured parts do not stand out while the real image is decoded
+	const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+	UploadImage(placeholder, 1, 1, 4);
+
+	type = typeName;
+	this->path = path;
+}
+void Texture::SetSource(const std::string& path, const std::string& typeName)
+{
+	type = typeName;
+	this->path = path;
+}
+void Texture::UploadImage(const unsigned char* data, int width, int height, int nrComponents)
+{
+	GLenum format = GL_RGBA;
+	if (nrComponents == 1)
+		format = GL_RED;
+	else if (nrComponents == 2)
+		format = GL_RG;
+	else if (nrComponents == 3)
+		format = GL_RGB;
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	// Rows of 1 and 3 component images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 void Texture::LoadCubemap(const std::vector<std::string>& faces)
 {
 	glGenTextures(1, &textureID);
@@ -124,6 +148,13 @@ void Texture::LoadCubemap(const std::vector<std::string>& faces)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
+// glReadPixels returns the bottom row first. Flipped here rather than through stb's flip flag, which is process
+// wide and would race with ImageEncoderPool's threads.
+static void FlipRows(char* data, int rowSize, int height)
+{
+	for (int y = 0; y < height / 2; y++)
+		std::swap_ranges(data + rowSize * y, data + rowSize * (y + 1), data + rowSize * (height - 1 - y));
+}
 bool SaveScreenshot(const std::string& fileName)
 {
 	GLint viewport[4];
@@ -143,8 +174,9 @@ bool SaveScreenshot(const std::string& fileName)
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
 
+	FlipRows(data, width * 3, height);
+
 	bool saved;
-	stbi_flip_vertically_on_write(true); 
 	fileCheckStream.open(fileName.c_str());
 	if (fileCheckStream.fail())
 	{
@@ -179,8 +211,9 @@ bool SaveScreenshotWithBMP(const std::string& fileName)
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
 
+	FlipRows(data, width * 3, height);
+
 	bool saved;
-	stbi_flip_vertically_on_write(true);
 	fileCheckStream.open(fileName.c_str());
 	if (fileCheckStream.fail())
 	{
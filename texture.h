@@ -15,12 +15,20 @@ public:
 	~Texture();
 
 	GLuint GetTextureID();
-	const std::string& GetPath();
-	const std::string& GetType();
+	const std::string& GetPath() const;
+	const std::string& GetType() const;
 
 	void LoadTexture(const std::string& path, const std::string& typeName, bool gammaCorrection = false);
 	void LoadTextureUsingDirectory(const std::string& path, const std::string& directory, const std::string& typeName, bool gamma = false);
 	void LoadCubemap(const std::vector<std::string>& faces);
+
+	// Create the texture object with a 1x1 placeholder image; UploadImage later replaces the contents,
+	// and every copy of this Texture sees the new image because they share the texture object
+	void CreatePlaceholder(const std::string& path, const std::string& typeName);
+	// Only name the image, without a texture object; safe off the GL thread (see Model::LoadGeometry)
+	void SetSource(const std::string& path, const std::string& typeName);
+	// Upload 8 bit pixels with 1 to 4 components and build the mipmaps. GL thread only.
+	void UploadImage(const unsigned char* data, int width, int height, int nrComponents);
 private:
 	GLuint textureID;
 	std::string type;
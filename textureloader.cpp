@@ -0,0 +1,86 @@
+#include "textureloader.h"
+#include <chrono>
+#include "parallel.h"
+#include "timer.h"
+
+TextureLoader::TextureLoader(unsigned int threadCount) : pool(threadCount)
+{
+}
+TextureLoader::~TextureLoader()
+{
+	// The GL context may already be gone, so only free the decoded images
+	for (auto& request : pending)
+	{
+		DecodedImage image = request.image.get();
+		stbi_image_free(image.data);
+	}
+}
+Texture TextureLoader::Load(const std::string& path, const std::string& directory, const std::string& typeName)
+{
+	std::string filename = directory + '/' + path;
+	auto it = textures.find(filename);
+	if (it != textures.end())
+		return it->second;
+
+	Texture texture;
+	texture.CreatePlaceholder(path, typeName);
+	textures.emplace(filename, texture);
+
+	PendingTexture request;
+	request.texture = texture;
+	request.filename = filename;
+	request.image = pool.Submit([filename]()
+	{
+		DecodedImage image;
+		image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+		return image;
+	});
+	pending.push_back(std::move(request));
+
+	return texture;
+}
+int TextureLoader::Update(double budgetMilliseconds)
+{
+	Timer budgetTimer;
+	int uploaded = 0;
+	for (auto it = pending.begin(); it != pending.end();)
+	{
+		if (uploaded > 0 && budgetTimer.ElapsedMilliseconds() >= budgetMilliseconds)
+			break;
+		if (it->image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		Upload(*it);
+		it = pending.erase(it);
+		uploaded++;
+	}
+	return uploaded;
+}
+void TextureLoader::Finish()
+{
+	for (auto& request : pending)
+		Upload(request);
+	pending.clear();
+}
+std::size_t TextureLoader::GetPendingCount() const
+{
+	return pending.size();
+}
+void TextureLoader::Upload(PendingTexture& request)
+{
+	DecodedImage image = request.image.get();
+	if (image.data)
+		request.texture.UploadImage(image.data, image.width, image.height, image.nrComponents);
+	else
+		std::cout << "Texture failed to load at path: " << request.filename << std::endl;
+	stbi_image_free(image.data);
+}
+
+TextureLoader& GetTextureLoader()
+{
+	static TextureLoader loader(GetWorkerThreadCount());
+	return loader;
+}
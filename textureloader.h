@@ -0,0 +1,50 @@
+#pragma once
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "texture.h"
+#include "threadpool.h"
+
+// Decodes material textures on worker threads and uploads them on the GL thread.
+// Load returns at once with a placeholder texture; Update swaps in the real images as they finish.
+class TextureLoader
+{
+public:
+	explicit TextureLoader(unsigned int threadCount);
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+	~TextureLoader();
+
+	// Each file is decoded once; later requests for the same path get the same texture. GL thread only.
+	Texture Load(const std::string& path, const std::string& directory, const std::string& typeName);
+	// Upload decoded images until budgetMilliseconds are spent (at least one per call). GL thread only.
+	// Returns the number of textures uploaded.
+	int Update(double budgetMilliseconds);
+	// Block until every requested texture has been uploaded. GL thread only.
+	void Finish();
+	std::size_t GetPendingCount() const;
+private:
+	struct DecodedImage
+	{
+		unsigned char* data; // stbi_image_free'd after upload
+		int width;
+		int height;
+		int nrComponents;
+	};
+	struct PendingTexture
+	{
+		Texture texture;
+		std::string filename;
+		std::future<DecodedImage> image;
+	};
+
+	ThreadPool pool;
+	std::unordered_map<std::string, Texture> textures; // keyed by directory + '/' + path
+	std::vector<PendingTexture> pending; // in request order
+
+	void Upload(PendingTexture& request);
+};
+
+// Loader shared by every Model
+TextureLoader& GetTextureLoader();
@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for long running background jobs (file decoding, encoding).
+// Use ParallelFor for data parallel loops instead; it runs on a pool of its own.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool(); // runs the jobs that are still queued, then joins the workers
+
+	template <class Func>
+	auto Submit(Func func) -> std::future<decltype(func())>
+	{
+		using Result = decltype(func());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+		std::future<Result> result = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return result;
+	}
+	unsigned int GetThreadCount() const;
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	void Enqueue(std::function<void()> job);
+	void WorkerLoop();
+};
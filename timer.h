@@ -0,0 +1,17 @@
+#pragma once
+#include <chrono>
+
+// Wall clock timer used for load time / per stage measurements
+class Timer
+{
+public:
+	Timer() { Reset(); }
+
+	void Reset() { start = std::chrono::steady_clock::now(); }
+	double ElapsedMilliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+private:
+	std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,265 @@
+#include "vertexformat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+static const float halfFloatMax = 65504.0f;
+
+static VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+
+void SetVertexFormat(VertexFormat format)
+{
+	vertexFormat = format;
+}
+VertexFormat GetVertexFormat()
+{
+	return vertexFormat;
+}
+const char* GetVertexFormatName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_FLOAT: return "float";
+	case VERTEX_FORMAT_COMPACT: return "compact";
+	default: return "unknown";
+	}
+}
+
+VertexStreamFormat GetVertexStreamFormat(VertexFormat format, VertexAttribute attribute)
+{
+	if (format == VERTEX_FORMAT_FLOAT)
+	{
+		GLint components = MeshGeometry::GetAttributeComponentCount(attribute);
+		return VertexStreamFormat{ GL_FLOAT, components, GL_FALSE, static_cast<GLsizei>(components * sizeof(float)) };
+	}
+	switch (attribute)
+	{
+	case ATTRIBUTE_POSITION:
+		// The fourth component only pads the vertex to 8 bytes; the shaders read a vec3
+		return VertexStreamFormat{ GL_UNSIGNED_SHORT, 4, GL_TRUE, 8 };
+	case ATTRIBUTE_TEXCOORDS:
+		return VertexStreamFormat{ GL_UNSIGNED_SHORT, 2, GL_TRUE, 4 };
+	case ATTRIBUTE_NORMAL:
+	case ATTRIBUTE_PDIR1:
+	case ATTRIBUTE_PDIR2:
+		return VertexStreamFormat{ GL_SHORT, 2, GL_TRUE, 4 };
+	case ATTRIBUTE_CURV1:
+	case ATTRIBUTE_CURV2:
+		return VertexStreamFormat{ GL_HALF_FLOAT, 1, GL_FALSE, 2 };
+	case ATTRIBUTE_DCURV:
+		return VertexStreamFormat{ GL_HALF_FLOAT, 4, GL_FALSE, 8 };
+	default:
+		return VertexStreamFormat{ GL_FLOAT, 0, GL_FALSE, 0 };
+	}
+}
+
+void VertexQuantization::Expand(const VertexQuantization& other)
+{
+	positions.Expand(other.positions);
+	texCoordMin = glm::vec2(std::min(texCoordMin.x, other.texCoordMin.x), std::min(texCoordMin.y, other.texCoordMin.y));
+	texCoordMax = glm::vec2(std::max(texCoordMax.x, other.texCoordMax.x), std::max(texCoordMax.y, other.texCoordMax.y));
+}
+bool VertexQuantization::operator==(const VertexQuantization& other) const
+{
+	return positions.min == other.positions.min && positions.max == other.positions.max &&
+		texCoordMin == other.texCoordMin && texCoordMax == other.texCoordMax;
+}
+VertexQuantization ComputeVertexQuantization(const MeshGeometry& geometry)
+{
+	VertexQuantization quantization;
+	for (const auto& position : geometry.positions)
+		quantization.positions.Expand(position);
+	for (const auto& texCoord : geometry.texCoords)
+	{
+		quantization.texCoordMin = glm::vec2(std::min(quantization.texCoordMin.x, texCoord.x),
+			std::min(quantization.texCoordMin.y, texCoord.y));
+		quantization.texCoordMax = glm::vec2(std::max(quantization.texCoordMax.x, texCoord.x),
+			std::max(quantization.texCoordMax.y, texCoord.y));
+	}
+	return quantization;
+}
+
+// value in [minimum, minimum + extent] to 16 bit UNORM; a range without extent stores 0
+static std::uint16_t QuantizeUnorm(float value, float minimum, float extent, float& decoded)
+{
+	float normalized = extent > 0.0f ? glm::clamp((value - minimum) / extent, 0.0f, 1.0f) : 0.0f;
+	std::uint16_t stored = static_cast<std::uint16_t>(std::lround(normalized * 65535.0f));
+	decoded = minimum + extent * (stored / 65535.0f);
+	return stored;
+}
+
+// Octahedral mapping of a direction to 2 x 16 bit SNORM (decoded by DecodeOctahedral in vertexformat.glsl).
+// A zero vector comes back as +z.
+static void EncodeOctahedral(const glm::vec3& v, std::int16_t* stored, float& errorDegrees)
+{
+	float sum = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+	glm::vec2 p = sum > 0.0f ? glm::vec2(v.x / sum, v.y / sum) : glm::vec2(0.0f, 0.0f);
+	if (v.z < 0.0f)
+	{
+		// Fold the lower hemisphere over the diagonals
+		glm::vec2 folded((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+		p = folded;
+	}
+	for (int k = 0; k < 2; k++)
+		stored[k] = static_cast<std::int16_t>(std::lround(glm::clamp(p[k], -1.0f, 1.0f) * 32767.0f));
+
+	float length = std::sqrt(glm::dot(v, v));
+	if (length == 0.0f)
+		return;
+	glm::vec3 decoded(stored[0] / 32767.0f, stored[1] / 32767.0f, 0.0f);
+	decoded.z = 1.0f - std::fabs(decoded.x) - std::fabs(decoded.y);
+	float t = std::max(-decoded.z, 0.0f);
+	decoded.x += decoded.x >= 0.0f ? -t : t;
+	decoded.y += decoded.y >= 0.0f ? -t : t;
+	float cosine = glm::dot(glm::normalize(decoded), v / length);
+	errorDegrees = std::max(errorDegrees, glm::degrees(std::acos(glm::clamp(cosine, -1.0f, 1.0f))));
+}
+
+// Half float of value, clamped to the finite range; raises the largest error and magnitude of the values that
+// fit (the clamped ones are only counted, or a single degenerate vertex would mask the error of all others)
+static std::uint16_t EncodeHalf(float value, float& maxError, float& maxMagnitude, std::size_t& clampedValues)
+{
+	float clamped = glm::clamp(value, -halfFloatMax, halfFloatMax);
+	std::uint16_t stored = glm::packHalf1x16(clamped);
+	if (clamped != value)
+	{
+		clampedValues++;
+		return stored;
+	}
+	maxError = std::max(maxError, std::fabs(glm::unpackHalf1x16(stored) - value));
+	maxMagnitude = std::max(maxMagnitude, std::fabs(value));
+	return stored;
+}
+
+void EncodeCompactAttribute(const MeshGeometry& geometry, VertexAttribute attribute,
+	const VertexQuantization& quantization, std::vector<unsigned char>& data, VertexEncodingError* error)
+{
+	std::size_t nv = geometry.GetVertexCount();
+	VertexStreamFormat format = GetVertexStreamFormat(VERTEX_FORMAT_COMPACT, attribute);
+	std::size_t offset = data.size();
+	data.resize(offset + nv * format.stride);
+	unsigned char* output = data.data() + offset;
+
+	VertexEncodingError local = VertexEncodingError();
+	float maxMagnitude = 0.0f, maxError = 0.0f;
+	switch (attribute)
+	{
+	case ATTRIBUTE_POSITION:
+	{
+		glm::vec3 extent = quantization.positions.max - quantization.positions.min;
+		for (std::size_t i = 0; i < nv; i++)
+		{
+			std::uint16_t stored[4] = { 0, 0, 0, 0 };
+			glm::vec3 decoded;
+			for (int k = 0; k < 3; k++)
+				stored[k] = QuantizeUnorm(geometry.positions[i][k], quantization.positions.min[k], extent[k], decoded[k]);
+			std::memcpy(output + i * format.stride, stored, sizeof(stored));
+			local.position = std::max(local.position, glm::length(decoded - geometry.positions[i]));
+		}
+		break;
+	}
+	case ATTRIBUTE_TEXCOORDS:
+	{
+		glm::vec2 extent = quantization.texCoordMax - quantization.texCoordMin;
+		for (std::size_t i = 0; i < nv; i++)
+		{
+			std::uint16_t stored[2];
+			glm::vec2 decoded;
+			for (int k = 0; k < 2; k++)
+				stored[k] = QuantizeUnorm(geometry.texCoords[i][k], quantization.texCoordMin[k], extent[k], decoded[k]);
+			std::memcpy(output + i * format.stride, stored, sizeof(stored));
+			local.texCoord = std::max(local.texCoord, glm::length(decoded - geometry.texCoords[i]));
+		}
+		break;
+	}
+	case ATTRIBUTE_NORMAL:
+	case ATTRIBUTE_PDIR1:
+	case ATTRIBUTE_PDIR2:
+	{
+		const AlignedVector<glm::vec3>& directions = attribute == ATTRIBUTE_NORMAL ? geometry.normals :
+			(attribute == ATTRIBUTE_PDIR1 ? geometry.pdir1 : geometry.pdir2);
+		float& errorDegrees = attribute == ATTRIBUTE_NORMAL ? local.normalDegrees : local.directionDegrees;
+		for (std::size_t i = 0; i < nv; i++)
+		{
+			std::int16_t stored[2];
+			EncodeOctahedral(directions[i], stored, errorDegrees);
+			std::memcpy(output + i * format.stride, stored, sizeof(stored));
+		}
+		break;
+	}
+	case ATTRIBUTE_CURV1:
+	case ATTRIBUTE_CURV2:
+	{
+		const AlignedVector<float>& curvatures = attribute == ATTRIBUTE_CURV1 ? geometry.curv1 : geometry.curv2;
+		for (std::size_t i = 0; i < nv; i++)
+		{
+			std::uint16_t stored = EncodeHalf(curvatures[i], maxError, maxMagnitude, local.clampedValues);
+			std::memcpy(output + i * format.stride, &stored, sizeof(stored));
+		}
+		local.curvature = maxMagnitude > 0.0f ? maxError / maxMagnitude : 0.0f;
+		break;
+	}
+	case ATTRIBUTE_DCURV:
+	{
+		for (std::size_t i = 0; i < nv; i++)
+		{
+			std::uint16_t stored[4];
+			for (int k = 0; k < 4; k++)
+				stored[k] = EncodeHalf(geometry.dcurv[i][k], maxError, maxMagnitude, local.clampedValues);
+			std::memcpy(output + i * format.stride, stored, sizeof(stored));
+		}
+		local.derivative = maxMagnitude > 0.0f ? maxError / maxMagnitude : 0.0f;
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (error)
+	{
+		error->position = std::max(error->position, local.position);
+		error->texCoord = std::max(error->texCoord, local.texCoord);
+		error->normalDegrees = std::max(error->normalDegrees, local.normalDegrees);
+		error->directionDegrees = std::max(error->directionDegrees, local.directionDegrees);
+		error->curvature = std::max(error->curvature, local.curvature);
+		error->derivative = std::max(error->derivative, local.derivative);
+		error->clampedValues += local.clampedValues;
+	}
+}
+
+void VertexFormatHandles::Resolve(const Shader& shader)
+{
+	compactVertices = shader.GetUniformHandle<bool>("compactVertices");
+	positionOffset = shader.GetUniformHandle<glm::vec3>("positionOffset");
+	positionScale = shader.GetUniformHandle<glm::vec3>("positionScale");
+	texCoordOffset = shader.GetUniformHandle<glm::vec2>("texCoordOffset");
+	texCoordScale = shader.GetUniformHandle<glm::vec2>("texCoordScale");
+}
+void VertexFormatHandles::Set(const Shader& shader, const VertexQuantization& quantization) const
+{
+	bool compact = GetVertexFormat() == VERTEX_FORMAT_COMPACT;
+	shader.Set(compactVertices, compact);
+	if (compact && !quantization.positions.IsEmpty())
+	{
+		shader.Set(positionOffset, quantization.positions.min);
+		shader.Set(positionScale, quantization.positions.max - quantization.positions.min);
+	}
+	else
+	{
+		shader.Set(positionOffset, glm::vec3(0.0f));
+		shader.Set(positionScale, glm::vec3(1.0f));
+	}
+	if (compact && quantization.texCoordMin.x <= quantization.texCoordMax.x)
+	{
+		shader.Set(texCoordOffset, quantization.texCoordMin);
+		shader.Set(texCoordScale, quantization.texCoordMax - quantization.texCoordMin);
+	}
+	else
+	{
+		shader.Set(texCoordOffset, glm::vec2(0.0f));
+		shader.Set(texCoordScale, glm::vec2(1.0f));
+	}
+}
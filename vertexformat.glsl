@@ -0,0 +1,11 @@
+// Decoding of the compact vertex format (see VertexFormat), shared by the vertex shaders that read it through
+// #include (see Shader::ReadShaderFile)
+
+// Inverse of EncodeOctahedral in vertexformat.cpp
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0);
+	v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+	return normalize(v);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "bvh.h"
+#include "meshgeometry.h"
+#include "shader.h"
+
+// How the meshes store their attribute streams on the GPU; set before the meshes are uploaded
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT, // 32 bit floats, as in MeshGeometry
+	// Positions and texture coordinates as 16 bit UNORM over their ranges (VertexQuantization), normals and
+	// principal directions octahedral in 2 x 16 bit SNORM, curvatures and their derivatives as half floats
+	VERTEX_FORMAT_COMPACT
+};
+void SetVertexFormat(VertexFormat format);
+VertexFormat GetVertexFormat();
+const char* GetVertexFormatName(VertexFormat format);
+
+// Layout of one attribute stream, as given to glVertexAttribPointer
+struct VertexStreamFormat
+{
+	GLenum type;
+	GLint components;
+	GLboolean normalized;
+	GLsizei stride; // bytes per vertex
+};
+VertexStreamFormat GetVertexStreamFormat(VertexFormat format, VertexAttribute attribute);
+
+// Ranges the compact format quantizes positions and texture coordinates over. Meshes drawn together through
+// a MeshBatch must share them, so Model expands each mesh's ranges over the whole model.
+struct VertexQuantization
+{
+	BoundingBox positions;
+	glm::vec2 texCoordMin = glm::vec2(1e30f);
+	glm::vec2 texCoordMax = glm::vec2(-1e30f);
+
+	void Expand(const VertexQuantization& other);
+	bool operator==(const VertexQuantization& other) const;
+	bool operator!=(const VertexQuantization& other) const { return !(*this == other); }
+};
+// Over every vertex of geometry, referenced or not
+VertexQuantization ComputeVertexQuantization(const MeshGeometry& geometry);
+
+// Largest differences between the float attributes and what the shaders decode from the compact streams
+struct VertexEncodingError
+{
+	float position; // object space
+	float texCoord;
+	float normalDegrees;
+	float directionDegrees; // principal directions
+	float curvature; // relative to the largest curvature magnitude
+	float derivative; // of dcurv, relative to its largest magnitude (both without the clamped values)
+	std::size_t clampedValues; // beyond the half float range
+};
+
+// Append attribute of every vertex in the compact format to data and raise error to what was lost
+void EncodeCompactAttribute(const MeshGeometry& geometry, VertexAttribute attribute,
+	const VertexQuantization& quantization, std::vector<unsigned char>& data, VertexEncodingError* error = nullptr);
+
+// Uniforms through which the shaders decode the compact format: compactVertices, positionOffset and
+// positionScale, texCoordOffset and texCoordScale. With the float format they are the identity.
+class VertexFormatHandles
+{
+public:
+	void Resolve(const Shader& shader);
+	// The shader must be in use
+	void Set(const Shader& shader, const VertexQuantization& quantization) const;
+private:
+	UniformHandle<bool> compactVertices;
+	UniformHandle<glm::vec3> positionOffset;
+	UniformHandle<glm::vec3> positionScale;
+	UniformHandle<glm::vec2> texCoordOffset;
+	UniformHandle<glm::vec2> texCoordScale;
+};
@@ -16,10 +16,20 @@ Window::Window(unsigned int width, unsigned int height, const char* windowTitle)
 	windowHandle = this;
 
 	renderer = nullptr;
+
+	screenshotEncoder = nullptr;
+	screenshotReadback = nullptr;
+	screenshotCount = 0;
+	screenshotKeyDown = false;
+	screenshotRequested = false;
+	recorder = nullptr;
 }
 Window::~Window()
 {
 	windowHandle = nullptr;
+	delete recorder;
+	delete screenshotReadback;
+	delete screenshotEncoder;
 	delete renderer;
 }
 void Window::Initialize()
@@ -40,6 +50,8 @@ void Window::Initialize()
 	}
 
 	renderer = new Renderer();
+	screenshotEncoder = new ImageEncoderPool(1, 2);
+	screenshotReadback = new FramebufferReadback(*screenshotEncoder);
 }
 void Window::Run()
 {
@@ -56,6 +68,15 @@ void Window::Run()
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		renderer->Render(aspect);
+		// The back buffer is read, so this has to happen before the swap
+		if (screenshotRequested)
+		{
+			screenshotReadback->Capture("screenshot_" + std::to_string(screenshotCount++) + ".png");
+			screenshotRequested = false;
+		}
+		screenshotReadback->Update();
+		if (recorder)
+			recorder->Frame();
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -63,8 +84,18 @@ void Window::Run()
 }
 void Window::Shutdown()
 {
+	// Pending screenshots and recorded frames need the context
+	delete recorder;
+	recorder = nullptr;
+	delete screenshotReadback;
+	screenshotReadback = nullptr;
 	glfwTerminate();
 }
+void Window::StartRecording(const FrameRecorderOptions& options)
+{
+	delete recorder;
+	recorder = new FrameRecorder(options);
+}
 unsigned int Window::GetWidth() { return width; }
 unsigned int Window::GetHeight() { return height; }
 bool Window::GLFWInitialize()
@@ -134,8 +165,11 @@ void Window::ProcessInput()
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		currentCamera->ProcessKeyboard(RIGHT, deltaTime);
 
-	/* if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
-		SaveScreenshot(fileName); */
+	// One screenshot per key press, not per frame the key is held
+	bool keyDown = glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS;
+	if (keyDown && !screenshotKeyDown)
+		screenshotRequested = true;
+	screenshotKeyDown = keyDown;
 }
 void Window::FramebufferSize(GLFWwindow* window, int width, int height)
 {
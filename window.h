@@ -2,6 +2,9 @@
 #include <GLFW/glfw3.h>
 #include <GL/glew.h>
 #include <iostream>
+#include "framebufferreadback.h"
+#include "framerecorder.h"
+#include "imageencoder.h"
 #include "renderer.h"
 #include "texture.h"
 
@@ -15,6 +18,8 @@ public:
 	void Initialize();
 	void Run();
 	void Shutdown();
+	// Record the frames of Run; call after Initialize
+	void StartRecording(const FrameRecorderOptions& options);
 
 	unsigned int GetWidth();
 	unsigned int GetHeight();
@@ -41,6 +46,15 @@ private:
 	// Renderer 
 	Renderer* renderer;
 
+	// Screenshots (X key), read back and written without stalling the frame
+	ImageEncoderPool* screenshotEncoder;
+	FramebufferReadback* screenshotReadback;
+	int screenshotCount;
+	bool screenshotKeyDown;
+	bool screenshotRequested;
+
+	FrameRecorder* recorder; // nullptr unless recording
+
 	bool GLFWInitialize();
 	bool CreateWindow();
 	bool GLEWInitialize(); // If you call this method, you must call GLFWInitialize before.
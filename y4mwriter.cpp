@@ -0,0 +1,120 @@
+#include "y4mwriter.h"
+#include <iostream>
+#include <vector>
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+// Interleaved RGB to planar Y, Cb, Cr (BT.601, limited range)
+static void ConvertRGBToYCbCr(const unsigned char* rgb, std::size_t pixelCount, unsigned char* planes)
+{
+	unsigned char* y = planes;
+	unsigned char* cb = planes + pixelCount;
+	unsigned char* cr = planes + 2 * pixelCount;
+	for (std::size_t i = 0; i < pixelCount; i++)
+	{
+		int r = rgb[3 * i], g = rgb[3 * i + 1], b = rgb[3 * i + 2];
+		y[i] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		cb[i] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		cr[i] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+}
+
+Y4MWriter::Y4MWriter()
+{
+	file = nullptr;
+	isPipe = false;
+	failed = false;
+	width = 0;
+	height = 0;
+	nextFrame = 0;
+}
+Y4MWriter::~Y4MWriter()
+{
+	Close();
+}
+bool Y4MWriter::Open(const std::string& path, int width, int height, int framesPerSecond)
+{
+	Close();
+	isPipe = !path.empty() && path[0] == '|';
+	if (isPipe)
+	{
+#ifdef _WIN32
+		file = _popen(path.c_str() + 1, "wb");
+#else
+		// An encoder that exits early must turn into a write error, not kill this process
+		std::signal(SIGPIPE, SIG_IGN);
+		file = popen(path.c_str() + 1, "w");
+#endif
+	}
+	else
+		file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cerr << "ERROR::Y4M::NOT_OPENED: " << path << '\n';
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	failed = false;
+	nextFrame = 0;
+	std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, framesPerSecond);
+	return true;
+}
+bool Y4MWriter::WriteFrame(unsigned int index, const unsigned char* rgb, int width, int height)
+{
+	bool valid = rgb != nullptr && width == this->width && height == this->height;
+	if (rgb != nullptr && !valid)
+		std::cerr << "ERROR::Y4M::FRAME_SIZE: " << width << "x" << height << " frame skipped in a " << this->width
+			<< "x" << this->height << " stream\n";
+
+	// Converted outside the lock, by whichever thread got the frame; the buffer is reused per thread
+	static thread_local std::vector<unsigned char> planes;
+	std::size_t pixelCount = static_cast<std::size_t>(width) * height;
+	if (valid)
+	{
+		planes.resize(3 * pixelCount);
+		ConvertRGBToYCbCr(rgb, pixelCount, planes.data());
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	frameWritten.wait(lock, [this, index]() { return nextFrame == index || file == nullptr; });
+	// Never opened, or already closed: the frame goes nowhere
+	bool written = valid && file != nullptr;
+	if (written)
+	{
+		std::fputs("FRAME\n", file);
+		if (std::fwrite(planes.data(), 1, planes.size(), file) != planes.size() && !failed)
+		{
+			std::cerr << "ERROR::Y4M::WRITE_FAILED at frame " << index << '\n';
+			failed = true;
+		}
+	}
+	nextFrame++;
+	bool succeeded = written && !failed;
+	lock.unlock();
+	frameWritten.notify_all();
+	return succeeded;
+}
+bool Y4MWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file)
+		return !failed;
+
+	int result;
+#ifdef _WIN32
+	result = isPipe ? _pclose(file) : std::fclose(file);
+#else
+	result = isPipe ? pclose(file) : std::fclose(file);
+#endif
+	file = nullptr;
+	if (result != 0)
+	{
+		std::cerr << "ERROR::Y4M::CLOSE_FAILED (" << (isPipe ? "encoder exit status " : "fclose ") << result << ")\n";
+		failed = true;
+	}
+	frameWritten.notify_all();
+	return !failed;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// Uncompressed YUV4MPEG2 video (4:4:4, BT.601 limited range) written to a file or to the standard input
+// of an encoder process. Frames can be converted on any number of threads; they are written strictly
+// in frame order, so a writer thread that is ahead waits for the earlier frames.
+class Y4MWriter
+{
+public:
+	Y4MWriter();
+	Y4MWriter(const Y4MWriter&) = delete;
+	Y4MWriter& operator=(const Y4MWriter&) = delete;
+	~Y4MWriter();
+
+	// A path starting with '|' runs the rest as a shell command (e.g. "|ffmpeg -i - out.mp4")
+	bool Open(const std::string& path, int width, int height, int framesPerSecond);
+	// Write frame number index (0, 1, 2, ...) from RGB rows, top row first. rgb may be nullptr for a frame
+	// that was lost; it is skipped so that later frames do not wait for it forever. Returns false if the frame was
+	// not written, also when the stream is not open.
+	bool WriteFrame(unsigned int index, const unsigned char* rgb, int width, int height);
+	// Returns false if any write failed or the encoder process reported an error
+	bool Close();
+private:
+	std::FILE* file;
+	bool isPipe;
+	bool failed;
+	int width;
+	int height;
+	unsigned int nextFrame;
+	std::mutex mutex;
+	std::condition_variable frameWritten;
+};